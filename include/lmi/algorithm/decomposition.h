@@ -2,6 +2,9 @@
 #define LMI_DECOMPOSITION_H
 
 #include "../detail/matrix.h"
+#include "../detail/vector.h"
+#include <cmath>
+#include <limits>
 #include <utility>
 
 namespace lmi
@@ -35,6 +38,144 @@ namespace lmi
 			}
 			return LU;
 		}
+
+		// Eigen decomposition of a symmetric matrix with cyclic Jacobi rotations, m = vectors * diag(values) *
+		// transpose(vectors). The columns of vectors are the unit eigenvectors, in no particular order. Converges
+		// quadratically, so small matrices need only a few sweeps.
+		template <size_t DIM, typename T>
+		void symmetricEigen(Matrix<DIM, DIM, T> a,
+							Matrix<DIM, DIM, T> &vectors,
+							Vector<DIM, T> &values,
+							size_t maxSweeps = 32)
+		{
+			vectors = Matrix<DIM, DIM, T>(T{1});
+			for(size_t sweep = 0; sweep < maxSweeps; ++sweep)
+			{
+				bool rotated = false;
+				for(size_t p = 0; p < DIM; ++p)
+				{
+					for(size_t q = p + 1; q < DIM; ++q)
+					{
+						// Negligible next to the diagonal: adding it to either diagonal entry would not change it.
+						const T apq = a[q][p];
+						const T diagonal = std::abs(a[p][p]) + std::abs(a[q][q]);
+						if(std::abs(apq) <= std::numeric_limits<T>::epsilon() * diagonal / T{4})
+						{
+							a[q][p] = a[p][q] = T{0};
+							continue;
+						}
+						rotated = true;
+
+						const T theta = (a[q][q] - a[p][p]) / (2 * apq);
+						const T t = (theta < T{0} ? T{-1} : T{1}) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+						const T c = 1 / std::sqrt(t * t + 1), s = t * c;
+						for(size_t k = 0; k < DIM; ++k)
+						{
+							const T akp = a[p][k], akq = a[q][k];
+							a[p][k] = c * akp - s * akq;
+							a[q][k] = s * akp + c * akq;
+						}
+						for(size_t k = 0; k < DIM; ++k)
+						{
+							const T apk = a[k][p], aqk = a[k][q];
+							a[k][p] = c * apk - s * aqk;
+							a[k][q] = s * apk + c * aqk;
+							const T vkp = vectors[p][k], vkq = vectors[q][k];
+							vectors[p][k] = c * vkp - s * vkq;
+							vectors[q][k] = s * vkp + c * vkq;
+						}
+						a[q][p] = a[p][q] = T{0};
+					}
+				}
+				if(!rotated)
+					break;
+			}
+			for(size_t i = 0; i < DIM; ++i)
+				values[i] = a[i][i];
+		}
+
+		// Cholesky factor l (lower triangular, m = l * transpose(l)) of a symmetric matrix, reading only its lower
+		// triangle. Returns false if m is not positive definite.
+		template <size_t DIM, typename T>
+		bool choleskyDecompose(const Matrix<DIM, DIM, T> &m, Matrix<DIM, DIM, T> &l)
+		{
+			l = Matrix<DIM, DIM, T>();
+			for(size_t j = 0; j < DIM; ++j)
+			{
+				T d = m[j][j];
+				for(size_t k = 0; k < j; ++k)
+					d -= l[k][j] * l[k][j];
+				if(!(d > T{0}))
+					return false;
+				l[j][j] = std::sqrt(d);
+				for(size_t i = j + 1; i < DIM; ++i)
+				{
+					T sum = m[j][i];
+					for(size_t k = 0; k < j; ++k)
+						sum -= l[k][i] * l[k][j];
+					l[j][i] = sum / l[j][j];
+				}
+			}
+			return true;
+		}
+
+		// Solves l * transpose(l) * x = b for a factor from choleskyDecompose.
+		template <size_t DIM, typename T>
+		Vector<DIM, T> choleskySolve(const Matrix<DIM, DIM, T> &l, const Vector<DIM, T> &b)
+		{
+			Vector<DIM, T> x;
+			for(size_t i = 0; i < DIM; ++i)
+			{
+				T sum = b[i];
+				for(size_t k = 0; k < i; ++k)
+					sum -= l[k][i] * x[k];
+				x[i] = sum / l[i][i];
+			}
+			for(size_t i = DIM; i-- > 0;)
+			{
+				T sum = x[i];
+				for(size_t k = i + 1; k < DIM; ++k)
+					sum -= l[i][k] * x[k];
+				x[i] = sum / l[i][i];
+			}
+			return x;
+		}
+
+		// Solves a * x = b by Gaussian elimination with partial pivoting. Returns false if a is singular.
+		template <size_t DIM, typename T>
+		bool solveLinear(Matrix<DIM, DIM, T> a, Vector<DIM, T> b, Vector<DIM, T> &x)
+		{
+			for(size_t c = 0; c < DIM; ++c)
+			{
+				size_t pivot = c;
+				for(size_t r = c + 1; r < DIM; ++r)
+					if(std::abs(a[c][r]) > std::abs(a[c][pivot]))
+						pivot = r;
+				if(a[c][pivot] == T{0})
+					return false;
+				if(pivot != c)
+				{
+					for(size_t k = c; k < DIM; ++k)
+						std::swap(a[k][c], a[k][pivot]);
+					std::swap(b[c], b[pivot]);
+				}
+				for(size_t r = c + 1; r < DIM; ++r)
+				{
+					const T factor = a[c][r] / a[c][c];
+					for(size_t k = c; k < DIM; ++k)
+						a[k][r] -= factor * a[k][c];
+					b[r] -= factor * b[c];
+				}
+			}
+			for(size_t i = DIM; i-- > 0;)
+			{
+				T sum = b[i];
+				for(size_t k = i + 1; k < DIM; ++k)
+					sum -= a[k][i] * x[k];
+				x[i] = sum / a[i][i];
+			}
+			return true;
+		}
 	}
 }
 
@@ -1,5 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
 namespace lmi
 {
 	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
@@ -19,4 +28,102 @@ namespace lmi
 	{
 		return (f(x + h / T{2}) - f(x - h / T{2})) / h;
 	}
-}
\ No newline at end of file
+
+	// ==================== Jacobians and Hessians ====================
+	// Central differences with one Richardson extrapolation step, which cancels the h^2 error term and leaves an
+	// O(h^4) truncation error. Steps are chosen per coordinate to balance truncation against rounding,
+	// h = eps^(1/5) * max(|x_k|, 1) for first and h = eps^(1/6) * max(|x_k|, 1) for second derivatives, and rounded
+	// so that x + h is exactly representable. Columns (or Hessian entries) are evaluated on `threads` threads, f
+	// must then be safe to call concurrently.
+
+	namespace detail
+	{
+		template<typename T>
+		T differenceStep(T x, T power)
+		{
+			const T h = std::pow(std::numeric_limits<T>::epsilon(), power) * std::max(std::abs(x), T{1});
+			volatile T shifted = x + h;	// Keeps the compiler from folding (x + h) - x back into h.
+			return shifted - x;
+		}
+
+		// (4 D(h / 2) - D(h)) / 3, the extrapolated value of a difference quotient with error c h^2 + O(h^4).
+		template<typename V>
+		V richardson(const V &coarse, const V &fine)
+		{
+			return (fine * 4 - coarse) / 3;
+		}
+	}
+
+	// Jacobian of f: Vector<N, T> -> Vector<M, T> at x, column k holding the partial derivatives with respect to x[k].
+	// Costs 4N evaluations of f.
+	template<size_t N,
+			 typename T,
+			 typename Function,
+			 typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	auto jacobian(Function f, const Vector<N, T> &x, size_t threads = 1)
+	{
+		using Result = decltype(f(x));
+		Matrix<N, Result::length(), T> j;
+		detail::parallelFor(N, threads, [&](size_t begin, size_t end) {
+			for(size_t k = begin; k < end; ++k)
+			{
+				const T h = detail::differenceStep(x[k], T{1} / 5);
+				auto quotient = [&](T step) {
+					Vector<N, T> plus = x, minus = x;
+					plus[k] += step;
+					minus[k] -= step;
+					return (f(plus) - f(minus)) / (2 * step);
+				};
+				j[k] = detail::richardson(quotient(h), quotient(h / 2));
+			}
+		});
+		return j;
+	}
+
+	// Hessian of f: Vector<N, T> -> T at x, symmetric by construction. Diagonal entries use the three point second
+	// difference, off diagonal ones the four point mixed difference; 8 evaluations per entry of the upper triangle
+	// and 4N + 1 for the diagonal.
+	template<size_t N,
+			 typename T,
+			 typename Function,
+			 typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	Matrix<N, N, T> hessian(Function f, const Vector<N, T> &x, size_t threads = 1)
+	{
+		const T center = f(x);
+		Vector<N, T> steps;
+		for(size_t k = 0; k < N; ++k)
+			steps[k] = detail::differenceStep(x[k], T{1} / 6);
+
+		Matrix<N, N, T> h;
+		constexpr size_t entries = N * (N + 1) / 2;
+		detail::parallelFor(entries, threads, [&](size_t begin, size_t end) {
+			for(size_t e = begin; e < end; ++e)
+			{
+				// Entry e of the upper triangle in column order: (row i, column j) with i <= j.
+				size_t j = 0;
+				while((j + 1) * (j + 2) / 2 <= e)
+					++j;
+				const size_t i = e - j * (j + 1) / 2;
+
+				auto quotient = [&](T scale) {
+					const T hi = steps[i] * scale, hj = steps[j] * scale;
+					Vector<N, T> p = x, m = x;
+					if(i == j)
+					{
+						p[i] += hi;
+						m[i] -= hi;
+						return (f(p) - 2 * center + f(m)) / (hi * hi);
+					}
+					Vector<N, T> pm = x, mp = x;
+					p[i] += hi, p[j] += hj;
+					m[i] -= hi, m[j] -= hj;
+					pm[i] += hi, pm[j] -= hj;
+					mp[i] -= hi, mp[j] += hj;
+					return (f(p) - f(pm) - f(mp) + f(m)) / (4 * hi * hj);
+				};
+				h[j][i] = h[i][j] = detail::richardson(quotient(T{1}), quotient(T{1} / 2));
+			}
+		});
+		return h;
+	}
+}
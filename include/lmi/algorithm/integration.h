@@ -1,5 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../detail/constexpr_math.h"
+#include "../detail/parallel.h"
+
 namespace lmi
 {
 	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
@@ -14,4 +24,297 @@ namespace lmi
 	{
 		return (b - a) * (f(a) + T{4} * f((a + b) / T{2}) + f(b)) / T{6};
 	}
-}
\ No newline at end of file
+
+	// ==================== Quadrature rules ====================
+	// The integrators below take an integrand either as f(x) -> T or, wrapped with batchIntegrand(), as
+	// f(const T *x, size_t count, T *y) that fills y[i] = f(x[i]) for a whole batch of abscissae at once, so a
+	// vectorized integrand runs over many points per call. With threads != 1 the integrand is called concurrently
+	// from several threads. Sums are always formed in the same order, so results do not depend on the thread count.
+
+	template<typename Function>
+	struct BatchIntegrand
+	{
+		Function f;
+	};
+
+	template<typename Function>
+	BatchIntegrand<std::decay_t<Function>> batchIntegrand(Function &&f)
+	{
+		return {std::forward<Function>(f)};
+	}
+
+	template<typename T>
+	struct QuadratureResult
+	{
+		T value = 0;
+		T error = 0;	// Estimated absolute error.
+		size_t evaluations = 0;
+	};
+
+	template<typename T, size_t N>
+	struct QuadratureRule
+	{
+		T nodes[N];		// Ascending, in [-1, 1].
+		T weights[N];
+	};
+
+	namespace detail
+	{
+		template<typename T, typename Function>
+		void sampleIntegrand(Function &f, const T *x, size_t count, T *y)
+		{
+			for(size_t i = 0; i < count; ++i)
+				y[i] = T(f(x[i]));
+		}
+
+		template<typename T, typename Function>
+		void sampleIntegrand(BatchIntegrand<Function> &f, const T *x, size_t count, T *y)
+		{
+			f.f(x, count, y);
+		}
+
+		// sum(weight(i) * f(node(i))) over i < count, in blocks of fixed size whose partial sums are added in order.
+		template<typename T, typename Function, typename Node, typename Weight>
+		T weightedSum(Function &f, size_t count, size_t threads, Node node, Weight weight)
+		{
+			constexpr size_t blockSize = 64;
+			auto block = [&](size_t k) {
+				T x[blockSize]{}, y[blockSize];
+				const size_t first = k * blockSize, n = std::min(blockSize, count - first);
+				for(size_t i = 0; i < n; ++i)
+					x[i] = node(first + i);
+				sampleIntegrand(f, x, n, y);
+				T sum = 0;
+				for(size_t i = 0; i < n; ++i)
+					sum += weight(first + i) * y[i];
+				return sum;
+			};
+
+			const size_t blocks = (count + blockSize - 1) / blockSize;
+			T sum = 0;
+			if(resolveThreadCount(threads) == 1)
+			{
+				for(size_t k = 0; k < blocks; ++k)
+					sum += block(k);
+				return sum;
+			}
+			std::vector<T> partial(blocks);
+			parallelFor(blocks, threads, [&](size_t begin, size_t end) {
+				for(size_t k = begin; k < end; ++k)
+					partial[k] = block(k);
+			});
+			for(T p : partial)
+				sum += p;
+			return sum;
+		}
+
+		// Roots of the Legendre polynomial P_N by Newton's method from Tricomi's initial guesses, weights
+		// 2 / ((1 - x^2) P_N'(x)^2). Evaluated in double precision.
+		template<typename T, size_t N>
+		constexpr QuadratureRule<T, N> makeGaussLegendreRule()
+		{
+			QuadratureRule<T, N> rule{};
+			for(size_t i = 0; i < (N + 1) / 2; ++i)
+			{
+				double x = lmi::cos(3.14159265358979323846 * (double(i) + 0.75) / (double(N) + 0.5));
+				double derivative = 1;
+				for(int iteration = 0; iteration < 100; ++iteration)
+				{
+					double p0 = 1, p1 = x;
+					for(size_t k = 2; k <= N; ++k)
+					{
+						const double p2 = ((2 * double(k) - 1) * x * p1 - (double(k) - 1) * p0) / double(k);
+						p0 = p1;
+						p1 = p2;
+					}
+					derivative = N == 1 ? 1 : double(N) * (x * p1 - p0) / (x * x - 1);
+					const double step = p1 / derivative;
+					x -= step;
+					if((step < 0 ? -step : step) < 1e-16)
+						break;
+				}
+				const double weight = 2 / ((1 - x * x) * derivative * derivative);
+				rule.nodes[i] = T(-x);
+				rule.nodes[N - 1 - i] = T(x);
+				rule.weights[i] = rule.weights[N - 1 - i] = T(weight);
+			}
+			return rule;
+		}
+
+		// 15 point Kronrod extension of the 7 point Gauss rule, nodes ascending. Every odd node is a Gauss node.
+		template<typename T>
+		struct GaussKronrod15
+		{
+			static constexpr size_t size = 15;
+
+			static constexpr T node(size_t j)
+			{
+				constexpr double x[8] = {0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+										 0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+										 0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+										 0.207784955007898467600689403773245, 0.0};
+				return j < 7 ? T(-x[j]) : T(x[14 - j]);
+			}
+
+			static constexpr T kronrodWeight(size_t j)
+			{
+				constexpr double w[8] = {0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+										 0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+										 0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+										 0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+				return T(w[j < 7 ? j : 14 - j]);
+			}
+
+			static constexpr T gaussWeight(size_t j)
+			{
+				constexpr double w[4] = {0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+										 0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+				return j % 2 == 1 ? T(w[(j < 7 ? j : 14 - j) / 2]) : T{0};
+			}
+		};
+
+		template<typename T, typename Function>
+		T adaptiveSimpsonStep(Function &f, T a, T b, T fa, T fm, T fb, T whole, T tolerance, size_t depth,
+							  QuadratureResult<T> &result)
+		{
+			const T m = (a + b) / 2;
+			T x[2] = {(a + m) / 2, (m + b) / 2}, y[2];
+			sampleIntegrand(f, x, 2, y);
+			result.evaluations += 2;
+			const T left = (m - a) * (fa + 4 * y[0] + fm) / 6, right = (b - m) * (fm + 4 * y[1] + fb) / 6;
+			const T delta = left + right - whole;
+			if(depth == 0 || std::abs(delta) <= 15 * tolerance)
+			{
+				result.error += std::abs(delta) / 15;
+				return left + right + delta / 15;
+			}
+			return adaptiveSimpsonStep(f, a, m, fa, y[0], fm, left, tolerance / 2, depth - 1, result) +
+				   adaptiveSimpsonStep(f, m, b, fm, y[1], fb, right, tolerance / 2, depth - 1, result);
+		}
+	}
+
+	// Nodes and weights of the N point Gauss-Legendre rule on [-1, 1], exact for polynomials of degree 2N - 1.
+	// Computed at compile time when used in a constant expression.
+	template<typename T, size_t N>
+	constexpr QuadratureRule<T, N> gaussLegendreRule = detail::makeGaussLegendreRule<T, N>();
+
+	// ==================== Composite rules ====================
+	// Fixed number of equal subintervals, no error estimate.
+
+	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	T compositeTrapezoidIntegrate(const T &a, const T &b, size_t intervals, Function f, size_t threads = 1)
+	{
+		const T h = (b - a) / T(intervals);
+		return detail::weightedSum<T>(
+			f, intervals + 1, threads, [&](size_t i) { return i == intervals ? b : a + T(i) * h; },
+			[&](size_t i) { return i == 0 || i == intervals ? h / 2 : h; });
+	}
+
+	// intervals is rounded up to an even number.
+	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	T compositeSimpsonIntegrate(const T &a, const T &b, size_t intervals, Function f, size_t threads = 1)
+	{
+		intervals += intervals % 2;
+		const T h = (b - a) / T(intervals);
+		return detail::weightedSum<T>(
+			f, intervals + 1, threads, [&](size_t i) { return i == intervals ? b : a + T(i) * h; },
+			[&](size_t i) { return (i == 0 || i == intervals ? 1 : i % 2 == 1 ? 4 : 2) * h / 3; });
+	}
+
+	// N point Gauss-Legendre rule on each of `intervals` equal subintervals.
+	template<size_t N,
+			 typename T,
+			 typename Function,
+			 typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	T gaussLegendreIntegrate(const T &a, const T &b, Function f, size_t intervals = 1, size_t threads = 1)
+	{
+		static constexpr QuadratureRule<T, N> rule = gaussLegendreRule<T, N>;
+		const T h = (b - a) / T(intervals);
+		return detail::weightedSum<T>(
+			f, N * intervals, threads,
+			[&](size_t i) { return a + (T(i / N) + (rule.nodes[i % N] + 1) / 2) * h; },
+			[&](size_t i) { return rule.weights[i % N] * h / 2; });
+	}
+
+	// ==================== Adaptive rules ====================
+
+	// Recursive Simpson with Richardson correction. Serial; a batch integrand receives two abscissae per call.
+	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	QuadratureResult<T> adaptiveSimpsonIntegrate(const T &a, const T &b, Function f, T tolerance, size_t maxDepth = 48)
+	{
+		QuadratureResult<T> result;
+		T x[3] = {a, (a + b) / 2, b}, y[3];
+		detail::sampleIntegrand(f, x, 3, y);
+		result.evaluations = 3;
+		const T whole = (b - a) * (y[0] + 4 * y[1] + y[2]) / 6;
+		result.value = detail::adaptiveSimpsonStep(f, a, b, y[0], y[1], y[2], whole, tolerance, maxDepth, result);
+		return result;
+	}
+
+	// Adaptive 7-15 point Gauss-Kronrod quadrature. Works in rounds: all open subintervals are integrated together,
+	// their abscissae handed to the integrand as one batch (split over threads), and every subinterval whose error
+	// estimate |K15 - G7| exceeds its share of the tolerance is bisected for the next round. Stops splitting once
+	// maxIntervals subintervals exist; the reported error then exceeds the tolerance.
+	template<typename T, typename Function, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	QuadratureResult<T> gaussKronrodIntegrate(const T &a,
+											  const T &b,
+											  Function f,
+											  T tolerance,
+											  size_t maxIntervals = 1024,
+											  size_t threads = 1)
+	{
+		using Rule = detail::GaussKronrod15<T>;
+		struct Interval
+		{
+			T a, b;
+		};
+
+		QuadratureResult<T> result;
+		std::vector<Interval> open{{a, b}}, next;
+		std::vector<T> x, y;
+		size_t intervals = 1;
+		while(!open.empty())
+		{
+			x.resize(open.size() * Rule::size);
+			y.resize(x.size());
+			for(size_t i = 0; i < open.size(); ++i)
+			{
+				const T half = (open[i].b - open[i].a) / 2, mid = open[i].a + half;
+				for(size_t j = 0; j < Rule::size; ++j)
+					x[i * Rule::size + j] = mid + half * Rule::node(j);
+			}
+			detail::parallelFor(x.size(), threads, [&](size_t begin, size_t end) {
+				detail::sampleIntegrand(f, x.data() + begin, end - begin, y.data() + begin);
+			});
+			result.evaluations += x.size();
+
+			next.clear();
+			for(size_t i = 0; i < open.size(); ++i)
+			{
+				const Interval &interval = open[i];
+				T kronrod = 0, gauss = 0;
+				for(size_t j = 0; j < Rule::size; ++j)
+				{
+					kronrod += Rule::kronrodWeight(j) * y[i * Rule::size + j];
+					gauss += Rule::gaussWeight(j) * y[i * Rule::size + j];
+				}
+				const T half = (interval.b - interval.a) / 2, mid = interval.a + half;
+				const T error = std::abs(kronrod - gauss) * std::abs(half);
+				const bool divisible = mid != interval.a && mid != interval.b;
+				if(error > tolerance * std::abs(2 * half / (b - a)) && divisible && intervals < maxIntervals)
+				{
+					next.push_back({interval.a, mid});
+					next.push_back({mid, interval.b});
+					++intervals;
+				}
+				else
+				{
+					result.value += kronrod * half;
+					result.error += error;
+				}
+			}
+			std::swap(open, next);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,248 @@
+#ifndef LMI_LEAST_SQUARES_H
+#define LMI_LEAST_SQUARES_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "decomposition.h"
+#include "differentiation.h"
+
+namespace lmi
+{
+	// Nonlinear least squares, min 0.5 * |r(x)|^2 for P parameters and R residuals known at compile time. Everything
+	// lives in fixed size Vectors and Matrices on the stack, so a solve never allocates and thousands of small
+	// problems can be solved side by side. Jacobians are Matrix<P, R, T> with column k holding dr / dx_k, as returned
+	// by jacobian() and dualJacobian().
+
+	enum class LeastSquaresMethod
+	{
+		GaussNewton,		// Full Gauss-Newton steps, halved until the cost decreases.
+		LevenbergMarquardt	// Damped steps with Marquardt's diagonal scaling, robust far from the minimum.
+	};
+
+	enum class LeastSquaresStatus
+	{
+		GradientConverged,
+		StepConverged,
+		CostConverged,
+		MaxIterations,
+		Failed	// No step decreased the cost, e.g. a singular Jacobian or a non finite residual.
+	};
+
+	template <typename T>
+	struct LeastSquaresOptions
+	{
+		LeastSquaresMethod method = LeastSquaresMethod::LevenbergMarquardt;
+		size_t maxIterations = 50;
+		T gradientTolerance = std::sqrt(std::numeric_limits<T>::epsilon()) * T(1e-3);	// On max |J^T r|.
+		T stepTolerance = std::sqrt(std::numeric_limits<T>::epsilon());					// Relative to |x|.
+		T costTolerance = std::numeric_limits<T>::epsilon() * 16;						// Relative cost decrease.
+		T initialDamping = T(1e-3);
+	};
+
+	template <typename T>
+	struct LeastSquaresSummary
+	{
+		LeastSquaresStatus status = LeastSquaresStatus::MaxIterations;
+		size_t iterations = 0;
+		T initialCost = 0, finalCost = 0;
+	};
+
+	namespace detail
+	{
+		template <typename T, size_t R>
+		T halfSquaredNorm(const Vector<R, T> &r)
+		{
+			return dot(r, r) / 2;
+		}
+
+		// Forward differences reusing r(x), P evaluations per Jacobian.
+		template <size_t P, size_t R, typename T, typename Residual>
+		Matrix<P, R, T> forwardJacobian(Residual &residual, const Vector<P, T> &x, const Vector<R, T> &r)
+		{
+			Matrix<P, R, T> j;
+			for(size_t k = 0; k < P; ++k)
+			{
+				const T h = differenceStep(x[k], T{1} / 2);
+				Vector<P, T> shifted = x;
+				shifted[k] += h;
+				j[k] = (residual(shifted) - r) / h;
+			}
+			return j;
+		}
+
+		template <size_t P, size_t R, typename T, typename Residual, typename Jacobian>
+		LeastSquaresSummary<T> solveLeastSquares(Residual &residual,
+												 Jacobian &&jacobian,
+												 Vector<P, T> &x,
+												 const LeastSquaresOptions<T> &options)
+		{
+			const bool marquardt = options.method == LeastSquaresMethod::LevenbergMarquardt;
+			LeastSquaresSummary<T> summary;
+			Vector<R, T> r = residual(x);
+			T cost = halfSquaredNorm(r);
+			summary.initialCost = summary.finalCost = cost;
+			T damping = options.initialDamping;
+
+			while(summary.iterations < options.maxIterations)
+			{
+				++summary.iterations;
+
+				// Normal equations J^T J dx = -J^T r.
+				const Matrix<P, R, T> j = jacobian(x, r);
+				Matrix<P, P, T> a;
+				Vector<P, T> g;	// Negated gradient, -J^T r.
+				for(size_t c = 0; c < P; ++c)
+				{
+					g[c] = -dot(j[c], r);
+					for(size_t k = c; k < P; ++k)
+						a[c][k] = a[k][c] = dot(j[c], j[k]);
+				}
+				T gradient = 0;
+				for(size_t c = 0; c < P; ++c)
+					gradient = std::max(gradient, std::abs(g[c]));
+				if(!(gradient > options.gradientTolerance))
+				{
+					summary.status = LeastSquaresStatus::GradientConverged;
+					break;
+				}
+
+				// Try steps until one decreases the cost: more damping for Levenberg-Marquardt, shorter steps for
+				// Gauss-Newton.
+				bool accepted = false;
+				T scale = 1;
+				Vector<P, T> step, candidate;
+				Vector<R, T> rCandidate;
+				T candidateCost = cost;
+				for(int attempt = 0; attempt < 32 && !accepted; ++attempt)
+				{
+					Matrix<P, P, T> damped = a, l;
+					if(marquardt)
+						for(size_t c = 0; c < P; ++c)
+							damped[c][c] += damping * std::max(a[c][c], std::numeric_limits<T>::min());
+					bool solved = algorithm::choleskyDecompose(damped, l);
+					if(solved)
+						step = algorithm::choleskySolve(l, g);
+					else if(!marquardt)
+						solved = algorithm::solveLinear(a, g, step);
+					if(!solved)
+					{
+						damping *= 10;
+						continue;
+					}
+
+					candidate = x + step * scale;
+					rCandidate = residual(candidate);
+					candidateCost = halfSquaredNorm(rCandidate);
+					accepted = candidateCost < cost;
+					if(!accepted)
+					{
+						if(marquardt)
+							damping *= 10;
+						else
+							scale /= 2;
+					}
+				}
+				if(!accepted)
+				{
+					summary.status = LeastSquaresStatus::Failed;
+					break;
+				}
+
+				const T decrease = cost - candidateCost;
+				const T stepLength = length(step * scale);
+				x = candidate;
+				r = rCandidate;
+				cost = candidateCost;
+				summary.finalCost = cost;
+				damping = std::max(damping / 10, std::numeric_limits<T>::epsilon());
+
+				if(stepLength <= options.stepTolerance * (length(x) + options.stepTolerance))
+				{
+					summary.status = LeastSquaresStatus::StepConverged;
+					break;
+				}
+				if(decrease <= options.costTolerance * cost)
+				{
+					summary.status = LeastSquaresStatus::CostConverged;
+					break;
+				}
+			}
+			return summary;
+		}
+	}
+
+	// Minimizes 0.5 * |residual(x)|^2 starting from x, with residual: Vector<P, T> -> Vector<R, T> and a forward
+	// difference Jacobian.
+	template <size_t P, typename T, typename Residual>
+	LeastSquaresSummary<T> solveLeastSquares(Residual residual,
+											 Vector<P, T> &x,
+											 const LeastSquaresOptions<T> &options = LeastSquaresOptions<T>())
+	{
+		using Result = decltype(residual(x));
+		return detail::solveLeastSquares<P, Result::length(), T>(
+			residual, [&](const Vector<P, T> &at, const Result &r) { return detail::forwardJacobian(residual, at, r); },
+			x, options);
+	}
+
+	// As above with a user Jacobian: Vector<P, T> -> Matrix<P, R, T>.
+	template <size_t P, typename T, typename Residual, typename Jacobian>
+	LeastSquaresSummary<T> solveLeastSquares(Residual residual,
+											 Jacobian jacobian,
+											 Vector<P, T> &x,
+											 const LeastSquaresOptions<T> &options = LeastSquaresOptions<T>())
+	{
+		using Result = decltype(residual(x));
+		return detail::solveLeastSquares<P, Result::length(), T>(
+			residual, [&](const Vector<P, T> &at, const Result &) { return jacobian(at); }, x, options);
+	}
+
+	// Solves `count` independent problems in parallel, problem i with residual(i, x) and starting point x[i].
+	// summaries may be null. The results do not depend on the thread count.
+	template <size_t P, typename T, typename Residual>
+	void solveLeastSquaresBatch(Residual residual,
+								Vector<P, T> *x,
+								size_t count,
+								LeastSquaresSummary<T> *summaries = nullptr,
+								const LeastSquaresOptions<T> &options = LeastSquaresOptions<T>(),
+								size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+			{
+				const LeastSquaresSummary<T> summary =
+					solveLeastSquares([&](const Vector<P, T> &at) { return residual(i, at); }, x[i], options);
+				if(summaries)
+					summaries[i] = summary;
+			}
+		});
+	}
+
+	// As above with a user Jacobian jacobian(i, x) of problem i.
+	template <size_t P, typename T, typename Residual, typename Jacobian>
+	void solveLeastSquaresBatch(Residual residual,
+								Jacobian jacobian,
+								Vector<P, T> *x,
+								size_t count,
+								LeastSquaresSummary<T> *summaries = nullptr,
+								const LeastSquaresOptions<T> &options = LeastSquaresOptions<T>(),
+								size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+			{
+				const LeastSquaresSummary<T> summary =
+					solveLeastSquares([&](const Vector<P, T> &at) { return residual(i, at); },
+									  [&](const Vector<P, T> &at) { return jacobian(i, at); }, x[i], options);
+				if(summaries)
+					summaries[i] = summary;
+			}
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef LMI_MONTE_CARLO_H
+#define LMI_MONTE_CARLO_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "integration.h"
+
+namespace lmi
+{
+	// ==================== Random and low discrepancy sequences ====================
+
+	// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"). Counter based: the output is a
+	// pure function of counter and key, so any sample of any stream can be generated independently and in any
+	// order, and a loop over consecutive counters vectorizes.
+	struct Philox4x32
+	{
+		uint32_t key[2];
+
+		explicit constexpr Philox4x32(uint64_t seed = 0) : key{uint32_t(seed), uint32_t(seed >> 32)}
+		{
+		}
+
+		struct Block
+		{
+			uint32_t word[4];
+		};
+
+		constexpr Block operator()(uint32_t c0, uint32_t c1 = 0, uint32_t c2 = 0, uint32_t c3 = 0) const
+		{
+			uint32_t k0 = key[0], k1 = key[1];
+			for(int round = 0; round < 10; ++round)
+			{
+				const uint64_t p0 = uint64_t(0xD2511F53u) * c0, p1 = uint64_t(0xCD9E8D57u) * c2;
+				const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0, n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+				c1 = uint32_t(p1);
+				c3 = uint32_t(p0);
+				c0 = n0;
+				c2 = n2;
+				k0 += 0x9E3779B9u;
+				k1 += 0xBB67AE85u;
+			}
+			return {{c0, c1, c2, c3}};
+		}
+	};
+
+	enum class SampleSequence
+	{
+		Random,	// Philox, error falls as 1 / sqrt(n).
+		Sobol,	// 16 dimensions, best with power of two sample counts.
+		Halton	// 16 dimensions.
+	};
+
+	namespace detail
+	{
+		// Uniform in [0, 1) from the top bits of x, never rounds up to 1.
+		template <typename T>
+		constexpr T unitInterval(uint32_t x)
+		{
+			constexpr int bits = std::numeric_limits<T>::digits < 32 ? std::numeric_limits<T>::digits : 32;
+			return T(x >> (32 - bits)) * (T{1} / T(uint64_t{1} << bits));
+		}
+
+		// Dimensions covered by the Sobol and Halton tables.
+		constexpr size_t lowDiscrepancyDimensions = 16;
+
+		// Sobol direction numbers from Joe and Kuo (new-joe-kuo-6.21201), dimension 0 being the van der Corput
+		// sequence.
+		struct SobolTable
+		{
+			static constexpr size_t dimensions = lowDiscrepancyDimensions;
+			uint32_t direction[dimensions][32];
+
+			constexpr SobolTable() : direction{}
+			{
+				// Degree s, coefficients a and initial m_1..m_s of the primitive polynomials of dimensions 1 to 15.
+				constexpr uint32_t degree[dimensions] = {0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5, 6, 6, 6};
+				constexpr uint32_t coefficients[dimensions] = {0, 0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14, 1, 13, 16};
+				constexpr uint32_t initial[dimensions][6] = {
+					{},				   {1},				  {1, 3},			 {1, 3, 1},			{1, 1, 1},
+					{1, 1, 3, 3},	   {1, 3, 5, 13},	  {1, 1, 5, 5, 17},	 {1, 1, 5, 5, 5},	{1, 1, 7, 11, 19},
+					{1, 1, 5, 1, 1},   {1, 1, 1, 3, 11},  {1, 3, 5, 5, 31},	 {1, 3, 3, 9, 7, 49},
+					{1, 1, 1, 15, 21, 21}, {1, 3, 1, 13, 27, 49}};
+				for(uint32_t k = 0; k < 32; ++k)
+					direction[0][k] = 1u << (31 - k);
+				for(size_t d = 1; d < dimensions; ++d)
+				{
+					const uint32_t s = degree[d];
+					for(uint32_t k = 0; k < s; ++k)
+						direction[d][k] = initial[d][k] << (31 - k);
+					for(uint32_t k = s; k < 32; ++k)
+					{
+						uint32_t v = direction[d][k - s] ^ (direction[d][k - s] >> s);
+						for(uint32_t j = 1; j < s; ++j)
+							v ^= ((coefficients[d] >> (s - 1 - j)) & 1) * direction[d][k - j];
+						direction[d][k] = v;
+					}
+				}
+			}
+		};
+
+		// Point `index` of dimension d, in gray code order so consecutive points differ in one direction number.
+		inline uint32_t sobol(uint32_t index, size_t d)
+		{
+			static constexpr SobolTable table;
+			assert(d < lowDiscrepancyDimensions);
+			uint32_t x = 0;
+			for(uint32_t gray = index ^ (index >> 1), k = 0; gray != 0; gray >>= 1, ++k)
+				x ^= (gray & 1) * table.direction[d][k];
+			return x;
+		}
+
+		template <typename T>
+		T halton(uint64_t index, size_t d)
+		{
+			static constexpr uint32_t primes[lowDiscrepancyDimensions] = {
+				2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+			assert(d < lowDiscrepancyDimensions);
+			const uint32_t base = primes[d];
+			double result = 0, scale = 1.0 / base;
+			for(; index != 0; index /= base, scale /= base)
+				result += double(index % base) * scale;
+			return T(result);
+		}
+
+		// Orthonormal basis with n as the third axis (Duff et al., "Building an Orthonormal Basis, Revisited").
+		template <typename T>
+		void orthonormalBasis(const Vector<3, T> &n, Vector<3, T> &t, Vector<3, T> &b)
+		{
+			const T sign = std::copysign(T{1}, n[2]);
+			const T a = T{-1} / (sign + n[2]), c = n[0] * n[1] * a;
+			t = Vector<3, T>(1 + sign * n[0] * n[0] * a, sign * c, -sign * n[0]);
+			b = Vector<3, T>(c, sign + n[1] * n[1] * a, -n[1]);
+		}
+
+		template <typename Point, typename T, typename Function>
+		void evaluatePoints(Function &f, const Point *x, size_t count, T *y)
+		{
+			for(size_t i = 0; i < count; ++i)
+				y[i] = T(f(x[i]));
+		}
+
+		template <typename Point, typename T, typename Function>
+		void evaluatePoints(BatchIntegrand<Function> &f, const Point *x, size_t count, T *y)
+		{
+			f.f(x, count, y);
+		}
+
+		// Count, mean and sum of squared deviations of a block of samples, merged with Chan's formula.
+		template <typename T>
+		struct Moments
+		{
+			size_t count = 0;
+			T mean = 0, m2 = 0;
+
+			void merge(const Moments &other)
+			{
+				if(other.count == 0)
+					return;
+				const T n = T(count), m = T(other.count), total = n + m, delta = other.mean - mean;
+				mean += delta * (m / total);
+				m2 += other.m2 + delta * delta * (n * m / total);
+				count += other.count;
+			}
+		};
+	}
+
+	// ==================== Domains ====================
+	// A domain maps `dimensions` uniform numbers in [0, 1) to a point and the weight 1 / pdf of that point, so the
+	// integral is estimated by the mean of f(point) * weight.
+
+	template <size_t DIM, typename T = float>
+	struct BoxDomain
+	{
+		static constexpr size_t dimensions = DIM;
+		using Point = Vector<DIM, T>;
+
+		Vector<DIM, T> min, max;
+
+		Point map(const T *u, T &weight) const
+		{
+			Point p;
+			weight = 1;
+			for(size_t d = 0; d < DIM; ++d)
+			{
+				p[d] = min[d] + (max[d] - min[d]) * u[d];
+				weight *= max[d] - min[d];
+			}
+			return p;
+		}
+	};
+
+	// Surface of a sphere, uniform by area.
+	template <typename T = float>
+	struct SphereDomain
+	{
+		static constexpr size_t dimensions = 2;
+		using Point = Vector<3, T>;
+
+		Vector<3, T> center;
+		T radius = 1;
+
+		Point map(const T *u, T &weight) const
+		{
+			const T z = 1 - 2 * u[0], r = std::sqrt(std::max(T{0}, 1 - z * z));
+			const T phi = T(6.283185307179586) * u[1];
+			weight = T(12.566370614359172) * radius * radius;
+			return center + Vector<3, T>(r * std::cos(phi), r * std::sin(phi), z) * radius;
+		}
+	};
+
+	// Solid ball, uniform by volume.
+	template <typename T = float>
+	struct BallDomain
+	{
+		static constexpr size_t dimensions = 3;
+		using Point = Vector<3, T>;
+
+		Vector<3, T> center;
+		T radius = 1;
+
+		Point map(const T *u, T &weight) const
+		{
+			const T z = 1 - 2 * u[1], r = std::sqrt(std::max(T{0}, 1 - z * z));
+			const T phi = T(6.283185307179586) * u[2];
+			weight = T(4.1887902047863905) * radius * radius * radius;
+			return center + Vector<3, T>(r * std::cos(phi), r * std::sin(phi), z) * (radius * std::cbrt(u[0]));
+		}
+	};
+
+	// Unit directions in the hemisphere around a unit normal, for integrals over solid angle. Cosine weighted
+	// sampling places samples by the projected solid angle, which removes the variance the cosine factor of
+	// irradiance style integrands would otherwise add.
+	template <typename T = float>
+	struct HemisphereDomain
+	{
+		static constexpr size_t dimensions = 2;
+		using Point = Vector<3, T>;
+
+		Vector<3, T> normal = Vector<3, T>(0, 0, 1);
+		bool cosineWeighted = false;
+
+		Point map(const T *u, T &weight) const
+		{
+			T z, r;
+			if(cosineWeighted)
+			{
+				r = std::sqrt(u[0]);
+				z = std::sqrt(1 - u[0]);
+				weight = T(3.141592653589793) / z;
+			}
+			else
+			{
+				z = 1 - u[0];
+				r = std::sqrt(std::max(T{0}, 1 - z * z));
+				weight = T(6.283185307179586);
+			}
+			const T phi = T(6.283185307179586) * u[1];
+			Vector<3, T> t, b;
+			detail::orthonormalBasis(normal, t, b);
+			return t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + normal * z;
+		}
+	};
+
+	template <size_t DIM, typename T>
+	constexpr size_t BoxDomain<DIM, T>::dimensions;
+
+	template <typename T>
+	constexpr size_t SphereDomain<T>::dimensions;
+
+	template <typename T>
+	constexpr size_t BallDomain<T>::dimensions;
+
+	template <typename T>
+	constexpr size_t HemisphereDomain<T>::dimensions;
+
+	// ==================== Integration ====================
+
+	template <typename T>
+	struct MonteCarloResult
+	{
+		T value = 0;
+		T variance = 0;	// Of the estimate; its square root is the standard error.
+		size_t samples = 0;
+	};
+
+	struct MonteCarloOptions
+	{
+		SampleSequence sequence = SampleSequence::Random;
+		uint64_t seed = 0;
+		// Independent randomizations of a low discrepancy sequence (random digital shifts for Sobol, random
+		// shifts modulo 1 for Halton). The variance is estimated from the spread of their means.
+		size_t replicates = 8;
+		size_t threads = 1;
+	};
+
+	// Integral of f over the domain from `samples` points. f takes a Domain::Point and returns T, or is wrapped
+	// with batchIntegrand() to take (const Point *points, size_t count, T *values). Samples are processed in fixed
+	// blocks of uniforms generated in structure of arrays form, and the block moments are merged in block order, so
+	// the result is bit identical for every thread count. Sobol and Halton sampling cover the first 16 dimensions,
+	// any further ones are padded with random numbers.
+	template <typename T, typename Domain, typename Function>
+	MonteCarloResult<T> monteCarloIntegrate(const Domain &domain,
+											Function f,
+											size_t samples,
+											const MonteCarloOptions &options = MonteCarloOptions())
+	{
+		constexpr size_t D = Domain::dimensions, blockSize = 256;
+		using Point = typename Domain::Point;
+		const bool random = options.sequence == SampleSequence::Random;
+		const Philox4x32 rng(options.seed);
+
+		// Random sampling is one replicate, low discrepancy points are split into equal replicates.
+		const size_t replicates = random ? 1 : std::max<size_t>(std::min(options.replicates, samples), 1);
+		const size_t perReplicate = samples / replicates;
+		const size_t blocksPerReplicate = (perReplicate + blockSize - 1) / blockSize;
+		std::vector<detail::Moments<T>> moments(replicates * blocksPerReplicate);
+
+		detail::parallelFor(moments.size(), options.threads, [&](size_t begin, size_t end) {
+			T u[D][blockSize], uniforms[D], values[blockSize];
+			Point points[blockSize];
+			T weights[blockSize];
+			for(size_t block = begin; block < end; ++block)
+			{
+				const size_t replicate = block / blocksPerReplicate;
+				const size_t first = (block % blocksPerReplicate) * blockSize;
+				const size_t n = std::min(blockSize, perReplicate - first);
+
+				if(random)
+				{
+					for(size_t g = 0; g < D; g += 4)
+						for(size_t i = 0; i < n; ++i)
+						{
+							const uint64_t index = first + i;
+							const Philox4x32::Block r = rng(uint32_t(index), uint32_t(index >> 32), uint32_t(g / 4));
+							for(size_t k = 0; k < 4 && g + k < D; ++k)
+								u[g + k][i] = detail::unitInterval<T>(r.word[k]);
+						}
+				}
+				else
+				{
+					for(size_t d = 0; d < D; ++d)
+					{
+						const uint32_t shift = rng(uint32_t(replicate), uint32_t(d), 0, 1).word[0];
+						if(d >= detail::lowDiscrepancyDimensions)
+						{
+							// Beyond the tables, independent per replicate and apart from the counters above.
+							for(size_t i = 0; i < n; ++i)
+							{
+								const uint64_t index = first + i;
+								const uint32_t c3 = uint32_t(replicate) + 2;
+								u[d][i] = detail::unitInterval<T>(
+									rng(uint32_t(index), uint32_t(index >> 32), uint32_t(d), c3).word[0]);
+							}
+						}
+						else if(options.sequence == SampleSequence::Sobol)
+							for(size_t i = 0; i < n; ++i)
+								u[d][i] = detail::unitInterval<T>(detail::sobol(uint32_t(first + i), d) ^ shift);
+						else
+						{
+							const T offset = detail::unitInterval<T>(shift);
+							for(size_t i = 0; i < n; ++i)
+							{
+								const T x = detail::halton<T>(first + i, d) + offset;
+								u[d][i] = x >= T{1} ? x - T{1} : x;
+							}
+						}
+					}
+				}
+
+				for(size_t i = 0; i < n; ++i)
+				{
+					for(size_t d = 0; d < D; ++d)
+						uniforms[d] = u[d][i];
+					points[i] = domain.map(uniforms, weights[i]);
+				}
+				detail::evaluatePoints(f, points, n, values);
+
+				detail::Moments<T> m;
+				m.count = n;
+				for(size_t i = 0; i < n; ++i)
+					m.mean += values[i] * weights[i];
+				m.mean /= T(n);
+				for(size_t i = 0; i < n; ++i)
+				{
+					const T delta = values[i] * weights[i] - m.mean;
+					m.m2 += delta * delta;
+				}
+				moments[block] = m;
+			}
+		});
+
+		MonteCarloResult<T> result;
+		result.samples = replicates * perReplicate;
+		if(result.samples == 0)
+			return result;
+		detail::Moments<T> total, replicateMeans;
+		for(size_t r = 0; r < replicates; ++r)
+		{
+			detail::Moments<T> replicate;
+			for(size_t b = 0; b < blocksPerReplicate; ++b)
+				replicate.merge(moments[r * blocksPerReplicate + b]);
+			total.merge(replicate);
+			detail::Moments<T> mean;
+			mean.count = 1;
+			mean.mean = replicate.mean;
+			replicateMeans.merge(mean);
+		}
+		result.value = total.mean;
+		if(random)
+			result.variance = total.count > 1 ? total.m2 / T(total.count - 1) / T(total.count) : T{0};
+		else
+			result.variance = replicates > 1 ? replicateMeans.m2 / T(replicates - 1) / T(replicates) : T{0};
+		return result;
+	}
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef LMI_PARTICLES_H
+#define LMI_PARTICLES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "../detail/parallel.h"
+#include "../detail/quaternion.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	enum class ParticleMethod
+	{
+		SemiImplicitEuler,	// First order and symplectic, one force evaluation per step.
+		VelocityVerlet,		// Second order and symplectic, one evaluation per step when accelerations are kept.
+		RungeKutta4			// Fourth order, four evaluations per step. Not symplectic, energy drifts slowly.
+	};
+
+	// A particle system in structure of arrays form: one array per attribute, all `count` long. Orientations and
+	// angular velocities are optional and advanced together when both are set, accelerations are an optional cache
+	// for velocity Verlet (see integrateParticles).
+	template <typename T = float>
+	struct ParticleState
+	{
+		Vector<3, T> *positions = nullptr;
+		Vector<3, T> *velocities = nullptr;
+		Quaternion<T> *orientations = nullptr;
+		Vector<3, T> *angularVelocities = nullptr;	// World space, radians per unit of time.
+		Vector<3, T> *accelerations = nullptr;
+		size_t count = 0;
+	};
+
+	namespace detail
+	{
+		constexpr size_t particleBlockSize = 256;
+
+		// The update kernels below run over the components of whole blocks instead of calling Vector operators per
+		// particle, which keeps the loops simple enough for the compiler to vectorize.
+
+		// y = x + s * d
+		template <typename T>
+		void particleAxpy(Vector<3, T> *y, const Vector<3, T> *x, T s, const Vector<3, T> *d, size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+				for(size_t c = 0; c < 3; ++c)
+					y[i][c] = x[i][c] + s * d[i][c];
+		}
+
+		// y += s * d
+		template <typename T>
+		void particleAccumulate(Vector<3, T> *y, T s, const Vector<3, T> *d, size_t n)
+		{
+			for(size_t i = 0; i < n; ++i)
+				for(size_t c = 0; c < 3; ++c)
+					y[i][c] += s * d[i][c];
+		}
+
+		// q = normalize(q + dt / 2 * (0, w) * q): rotates about the exact axis of w by 2 atan(|w| dt / 2), which
+		// agrees with |w| dt to third order and needs no trigonometry.
+		template <typename T>
+		void rotateParticles(Quaternion<T> *q, const Vector<3, T> *w, T dt, size_t n)
+		{
+			const T h = dt / 2;
+			for(size_t i = 0; i < n; ++i)
+			{
+				const T a = q[i][0], b = q[i][1], c = q[i][2], d = q[i][3];
+				const T x = w[i][0] * h, y = w[i][1] * h, z = w[i][2] * h;
+				const T r0 = a - x * b - y * c - z * d;
+				const T r1 = b + x * a + y * d - z * c;
+				const T r2 = c - x * d + y * a + z * b;
+				const T r3 = d + x * c - y * b + z * a;
+				const T inv = T{1} / std::sqrt(r0 * r0 + r1 * r1 + r2 * r2 + r3 * r3);
+				q[i] = Quaternion<T>(r0 * inv, r1 * inv, r2 * inv, r3 * inv);
+			}
+		}
+
+		template <typename T, typename Accelerations>
+		void integrateParticleBlock(const ParticleState<T> &state,
+									ParticleMethod method,
+									T time,
+									T dt,
+									Accelerations &accelerations,
+									size_t first,
+									size_t n)
+		{
+			Vector<3, T> *x = state.positions + first, *v = state.velocities + first;
+			Vector<3, T> a[particleBlockSize];
+
+			switch(method)
+			{
+				case ParticleMethod::SemiImplicitEuler:
+					accelerations(time, x, v, a, first, n);
+					particleAccumulate(v, dt, a, n);
+					particleAccumulate(x, dt, v, n);
+					break;
+
+				case ParticleMethod::VelocityVerlet:
+				{
+					// x(t + dt) = x + v dt + a dt^2 / 2, v(t + dt) = v + (a(t) + a(t + dt)) dt / 2, with the forces at
+					// t + dt seeing the velocity v + a dt so velocity dependent forces stay second order accurate.
+					Vector<3, T> predicted[particleBlockSize];
+					Vector<3, T> *current = state.accelerations ? state.accelerations + first : a;
+					if(!state.accelerations)
+						accelerations(time, x, v, a, first, n);
+					for(size_t i = 0; i < n; ++i)
+						for(size_t c = 0; c < 3; ++c)
+						{
+							x[i][c] += (v[i][c] + current[i][c] * (dt / 2)) * dt;
+							predicted[i][c] = v[i][c] + current[i][c] * dt;
+						}
+					Vector<3, T> next[particleBlockSize];
+					accelerations(time + dt, x, predicted, next, first, n);
+					for(size_t i = 0; i < n; ++i)
+						for(size_t c = 0; c < 3; ++c)
+						{
+							v[i][c] += (current[i][c] + next[i][c]) * (dt / 2);
+							current[i][c] = next[i][c];
+						}
+					break;
+				}
+
+				case ParticleMethod::RungeKutta4:
+				{
+					// x' = v, v' = a(t, x, v). sumX and sumV collect the stage slopes with weights 1, 2, 2, 1.
+					Vector<3, T> sx[particleBlockSize], sv[particleBlockSize];
+					Vector<3, T> sumX[particleBlockSize], sumV[particleBlockSize];
+					accelerations(time, x, v, a, first, n);
+					std::copy(v, v + n, sumX);
+					std::copy(a, a + n, sumV);
+
+					particleAxpy(sx, x, dt / 2, v, n);
+					particleAxpy(sv, v, dt / 2, a, n);
+					accelerations(time + dt / 2, sx, sv, a, first, n);
+					particleAccumulate(sumX, T{2}, sv, n);
+					particleAccumulate(sumV, T{2}, a, n);
+
+					particleAxpy(sx, x, dt / 2, sv, n);
+					particleAxpy(sv, v, dt / 2, a, n);
+					accelerations(time + dt / 2, sx, sv, a, first, n);
+					particleAccumulate(sumX, T{2}, sv, n);
+					particleAccumulate(sumV, T{2}, a, n);
+
+					particleAxpy(sx, x, dt, sv, n);
+					particleAxpy(sv, v, dt, a, n);
+					accelerations(time + dt, sx, sv, a, first, n);
+					particleAccumulate(sumX, T{1}, sv, n);
+					particleAccumulate(sumV, T{1}, a, n);
+
+					particleAccumulate(x, dt / 6, sumX, n);
+					particleAccumulate(v, dt / 6, sumV, n);
+					break;
+				}
+			}
+
+			if(state.orientations && state.angularVelocities)
+				rotateParticles(state.orientations + first, state.angularVelocities + first, dt, n);
+		}
+	}
+
+	// Advances every particle from `time` by dt. The accelerations callback is called with whole blocks of up to 256
+	// particles,
+	//
+	//     accelerations(T time, const Vector<3, T> *positions, const Vector<3, T> *velocities,
+	//                   Vector<3, T> *result, size_t first, size_t count)
+	//
+	// and writes the acceleration of particle first + i to result[i]. The positions and velocities passed in are
+	// those of the same particles, but for the intermediate stages of velocity Verlet and Runge-Kutta they are
+	// scratch copies, so the callback must only read the state of the particles it is given (gravity, drag, fields,
+	// springs to fixed anchors). With threads != 1 it is called concurrently for different blocks.
+	//
+	// Velocity Verlet needs a(t) at the start of each step. If state.accelerations is set it must hold a(t) on entry
+	// (e.g. filled by one call to the callback before the first step) and holds a(t + dt) on return, so a step costs
+	// one evaluation; otherwise a(t) is evaluated every step. The other methods ignore state.accelerations.
+	//
+	// Orientations are rotated by the angular velocity, which is held constant over the step.
+	template <typename T, typename Accelerations>
+	void integrateParticles(const ParticleState<T> &state,
+							ParticleMethod method,
+							T time,
+							T dt,
+							Accelerations accelerations,
+							size_t threads = 1)
+	{
+		detail::parallelFor(state.count, threads, [&](size_t begin, size_t end) {
+			for(size_t b = begin; b < end; b += detail::particleBlockSize)
+				detail::integrateParticleBlock(state, method, time, dt, accelerations, b,
+											   std::min(end - b, detail::particleBlockSize));
+		});
+	}
+
+	// Decouples the simulation rate from the frame rate: frame times are accumulated and consumed in steps of a
+	// fixed size, the remainder carries over to the next frame. alpha() is the fraction of a step left over, for
+	// interpolating between the last two simulated states when rendering.
+	template <typename T = float>
+	class FixedTimestep
+	{
+		public:
+		// At most maxSteps are taken per frame and time beyond that is dropped, so a slow frame can not make the
+		// next one slower still.
+		explicit FixedTimestep(T step, size_t maxSteps = 8, T startTime = T{0})
+			: dt(step), maxSteps(maxSteps), now(startTime)
+		{
+		}
+
+		// Adds frameTime and calls stepFunction(time, step) once per whole step that fits. Returns the number of
+		// steps taken.
+		template <typename Step>
+		size_t advance(T frameTime, Step &&stepFunction)
+		{
+			accumulator += frameTime;
+			size_t steps = 0;
+			while(accumulator >= dt && steps < maxSteps)
+			{
+				stepFunction(now, dt);
+				now += dt;
+				accumulator -= dt;
+				++steps;
+			}
+			if(steps == maxSteps)
+				accumulator = std::min(accumulator, dt);
+			return steps;
+		}
+
+		T step() const
+		{
+			return dt;
+		}
+
+		// Simulated time after the last step taken.
+		T time() const
+		{
+			return now;
+		}
+
+		T alpha() const
+		{
+			return std::min(accumulator / dt, T{1});
+		}
+
+		private:
+		T dt;
+		size_t maxSteps;
+		T now;
+		T accumulator = T{0};
+	};
+}
+
+#endif
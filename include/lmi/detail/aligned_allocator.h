@@ -0,0 +1,78 @@
+#ifndef LMI_ALIGNED_ALLOCATOR_H
+#define LMI_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace lmi
+{
+	namespace detail
+	{
+		// Allocator honouring alignof(U). With SIMD enabled Vector, Matrix and everything containing them can be
+		// aligned to more than std::allocator guarantees before C++17 (e.g. 32 bytes for Vector<3, double>), so
+		// every container of lmi value types goes through this one. Over aligned blocks are carved out of a larger
+		// ::operator new allocation with the original pointer stored right in front of them.
+		template <typename U>
+		struct AlignedAllocator
+		{
+			using value_type = U;
+
+			AlignedAllocator() = default;
+
+			template <typename V>
+			constexpr AlignedAllocator(const AlignedAllocator<V> &) noexcept
+			{
+			}
+
+			U *allocate(size_t n)
+			{
+				if(n > (std::numeric_limits<size_t>::max() - extra) / sizeof(U))
+					throw std::bad_alloc();
+				if(!overAligned)
+					return static_cast<U *>(::operator new(n * sizeof(U)));
+
+				void *raw = ::operator new(n * sizeof(U) + extra);
+				const uintptr_t mask = alignof(U) - 1;
+				const uintptr_t aligned = (uintptr_t(raw) + sizeof(void *) + mask) & ~mask;
+				reinterpret_cast<void **>(aligned)[-1] = raw;
+				return reinterpret_cast<U *>(aligned);
+			}
+
+			void deallocate(U *p, size_t) noexcept
+			{
+				if(!overAligned)
+					::operator delete(p);
+				else if(p)
+					::operator delete(reinterpret_cast<void **>(p)[-1]);
+			}
+
+			friend bool operator==(const AlignedAllocator &, const AlignedAllocator &)
+			{
+				return true;
+			}
+
+			friend bool operator!=(const AlignedAllocator &, const AlignedAllocator &)
+			{
+				return false;
+			}
+
+			private:
+			static constexpr bool overAligned = alignof(U) > alignof(std::max_align_t);
+			static constexpr size_t extra = overAligned ? alignof(U) - 1 + sizeof(void *) : 0;
+		};
+
+		template <typename U>
+		constexpr bool AlignedAllocator<U>::overAligned;
+
+		template <typename U>
+		constexpr size_t AlignedAllocator<U>::extra;
+
+		template <typename U>
+		using AlignedVector = std::vector<U, AlignedAllocator<U>>;
+	}
+}
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef LMI_CONSTEXPR_MATH_H
+#define LMI_CONSTEXPR_MATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define LMI_HAS_CONSTANT_EVALUATED
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define LMI_HAS_CONSTANT_EVALUATED
+#endif
+
+namespace lmi
+{
+	namespace detail
+	{
+		namespace cmath
+		{
+			// True while the call is part of a constant expression. Without compiler support the constexpr kernels
+			// below are also used at runtime, which gives the same results but is slower than libm.
+			constexpr bool constantEvaluated()
+			{
+#if defined(LMI_HAS_CONSTANT_EVALUATED)
+				return __builtin_is_constant_evaluated();
+#else
+				return true;
+#endif
+			}
+
+			// hi + lo with |lo| <= ulp(hi) / 2, about 106 significant bits. Built from error free transformations
+			// only, so it can be evaluated by the compiler. hi is always the double nearest to hi + lo.
+			struct DoubleDouble
+			{
+				double hi, lo;
+			};
+
+			constexpr DoubleDouble quickTwoSum(double a, double b)
+			{
+				const double s = a + b;
+				return {s, b - (s - a)};
+			}
+
+			constexpr DoubleDouble twoSum(double a, double b)
+			{
+				const double s = a + b;
+				const double v = s - a;
+				return {s, (a - (s - v)) + (b - v)};
+			}
+
+			// Dekker's product, exact as long as neither factor comes close to overflowing.
+			constexpr DoubleDouble twoProduct(double a, double b)
+			{
+				const double split = 134217729.0;
+				const double ca = split * a, cb = split * b;
+				const double aHi = ca - (ca - a), aLo = a - aHi;
+				const double bHi = cb - (cb - b), bLo = b - bHi;
+				const double p = a * b;
+				return {p, ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo};
+			}
+
+			constexpr DoubleDouble operator-(const DoubleDouble &a)
+			{
+				return {-a.hi, -a.lo};
+			}
+
+			constexpr DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b)
+			{
+				DoubleDouble s = twoSum(a.hi, b.hi);
+				const DoubleDouble t = twoSum(a.lo, b.lo);
+				s = quickTwoSum(s.hi, s.lo + t.hi);
+				return quickTwoSum(s.hi, s.lo + t.lo);
+			}
+
+			constexpr DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b)
+			{
+				return a + -b;
+			}
+
+			constexpr DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b)
+			{
+				const DoubleDouble p = twoProduct(a.hi, b.hi);
+				return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+			}
+
+			constexpr DoubleDouble operator/(const DoubleDouble &a, const DoubleDouble &b)
+			{
+				const double q1 = a.hi / b.hi;
+				DoubleDouble r = a - b * DoubleDouble{q1, 0.0};
+				const double q2 = r.hi / b.hi;
+				r = r - b * DoubleDouble{q2, 0.0};
+				const double q3 = r.hi / b.hi;
+				return quickTwoSum(q1, q2) + DoubleDouble{q3, 0.0};
+			}
+
+			constexpr double abs(double x)
+			{
+				return x < 0.0 ? -x : x;
+			}
+
+			constexpr bool isFinite(double x)
+			{
+				return x - x == 0.0;
+			}
+
+			constexpr DoubleDouble pi = {3.141592653589793116, 1.2246467991473532e-16};
+			constexpr DoubleDouble halfPi = {1.5707963267948966192, 6.123233995736766e-17};
+
+			// ==================== Rounding ====================
+
+			// hi is already hi + lo rounded to double.
+			constexpr double round(const DoubleDouble &x, double)
+			{
+				return x.hi;
+			}
+
+			// Rounding hi to float is only wrong if hi lies exactly halfway between two floats, then the sign of lo
+			// decides.
+			constexpr float round(const DoubleDouble &x, float)
+			{
+				const float f = static_cast<float>(x.hi);
+				const double d = x.hi - static_cast<double>(f);
+				const double other = static_cast<double>(f) + 2.0 * d;
+				const bool halfway = d != 0.0 && static_cast<double>(static_cast<float>(other)) == other;
+				return halfway && x.lo != 0.0 && (d > 0.0) == (x.lo > 0.0) ? static_cast<float>(other) : f;
+			}
+
+			// ==================== sqrt ====================
+
+			// Newton's method on the argument scaled into [1, 4), finished by one step with the exact residual.
+			constexpr double sqrt(double x)
+			{
+				if(!(x > 0.0) || x == std::numeric_limits<double>::infinity())
+					return x < 0.0 ? std::numeric_limits<double>::quiet_NaN() : x;
+
+				double m = x, scale = 1.0;
+				while(m >= 18446744073709551616.0)
+				{
+					m *= 1.0 / 18446744073709551616.0;
+					scale *= 4294967296.0;
+				}
+				while(m >= 4.0)
+				{
+					m *= 0.25;
+					scale *= 2.0;
+				}
+				while(m < 1.0 / 18446744073709551616.0)
+				{
+					m *= 18446744073709551616.0;
+					scale *= 1.0 / 4294967296.0;
+				}
+				while(m < 1.0)
+				{
+					m *= 4.0;
+					scale *= 0.5;
+				}
+
+				double y = (m + 1.0) / 2.0;
+				for(int i = 0; i < 6; ++i)
+					y = (y + m / y) / 2.0;
+				const DoubleDouble residual = DoubleDouble{m, 0.0} - twoProduct(y, y);
+				return (y + residual.hi / (2.0 * y)) * scale;
+			}
+
+			constexpr DoubleDouble sqrt(const DoubleDouble &x)
+			{
+				if(x.hi == 0.0)
+					return x;
+				const double y = sqrt(x.hi);
+				const DoubleDouble residual = x - twoProduct(y, y);
+				return twoSum(y, residual.hi / (2.0 * y));
+			}
+
+			// ==================== sin, cos, tan ====================
+
+			// x - k * pi / 2 with pi / 2 split into four doubles. The remainder keeps about 100 bits for |x| < 2^50,
+			// larger arguments lose accuracy.
+			constexpr DoubleDouble reduce(double x, int &quadrant)
+			{
+				const double magic = 6755399441055744.0;
+				const double v = x * 0.6366197723675814;
+				const bool small = abs(v) < 2251799813685248.0;
+				const double k = small ? (v + magic) - magic : v;
+				quadrant = small ? static_cast<int>(static_cast<int64_t>(k) & 3) : 0;
+
+				DoubleDouble r = DoubleDouble{x, 0.0} - twoProduct(k, 1.5707963267948966);
+				r = r - twoProduct(k, 6.123233995736766e-17);
+				r = r - twoProduct(k, -1.4973849048591698e-33);
+				return r - DoubleDouble{k * 5.562271104316826e-50, 0.0};
+			}
+
+			// Taylor series for |r| <= pi / 4, summed until the terms drop below the double-double precision.
+			constexpr DoubleDouble sinSeries(const DoubleDouble &r)
+			{
+				const DoubleDouble r2 = r * r;
+				DoubleDouble term = r, sum = r;
+				for(int n = 1; n < 30 && abs(term.hi) > 1e-34 * abs(sum.hi); ++n)
+				{
+					term = -(term * r2) / DoubleDouble{double((2 * n) * (2 * n + 1)), 0.0};
+					sum = sum + term;
+				}
+				return sum;
+			}
+
+			constexpr DoubleDouble cosSeries(const DoubleDouble &r)
+			{
+				const DoubleDouble r2 = r * r;
+				DoubleDouble term = {1.0, 0.0}, sum = {1.0, 0.0};
+				for(int n = 1; n < 30 && abs(term.hi) > 1e-34; ++n)
+				{
+					term = -(term * r2) / DoubleDouble{double((2 * n - 1) * (2 * n)), 0.0};
+					sum = sum + term;
+				}
+				return sum;
+			}
+
+			// Below 2^-27 the first omitted term is less than half an ulp, so sin(x) and tan(x) round to x and cos(x)
+			// to 1.
+			constexpr DoubleDouble sin(double x)
+			{
+				if(!isFinite(x) || abs(x) < 7.450580596923828e-9)
+					return {isFinite(x) ? x : x - x, 0.0};
+				int quadrant = 0;
+				const DoubleDouble r = reduce(x, quadrant);
+				const DoubleDouble res = quadrant % 2 == 0 ? sinSeries(r) : cosSeries(r);
+				return quadrant >= 2 ? -res : res;
+			}
+
+			constexpr DoubleDouble cos(double x)
+			{
+				if(!isFinite(x) || abs(x) < 7.450580596923828e-9)
+					return {isFinite(x) ? 1.0 : x - x, 0.0};
+				int quadrant = 0;
+				const DoubleDouble r = reduce(x, quadrant);
+				const DoubleDouble res = quadrant % 2 == 0 ? cosSeries(r) : sinSeries(r);
+				return quadrant == 1 || quadrant == 2 ? -res : res;
+			}
+
+			constexpr DoubleDouble tan(double x)
+			{
+				if(!isFinite(x) || abs(x) < 7.450580596923828e-9)
+					return {isFinite(x) ? x : x - x, 0.0};
+				int quadrant = 0;
+				const DoubleDouble r = reduce(x, quadrant);
+				const DoubleDouble s = sinSeries(r), c = cosSeries(r);
+				return quadrant % 2 == 0 ? s / c : -(c / s);
+			}
+
+			// ==================== atan, acos ====================
+
+			// For a >= 0. Arguments above 1 are inverted, then three halvings of the angle with
+			// atan(a) = 2 atan(a / (1 + sqrt(1 + a^2))) bring a below tan(pi / 32) where the series converges fast.
+			constexpr DoubleDouble atan(DoubleDouble a)
+			{
+				const bool invert = a.hi > 1.0;
+				if(invert)
+					a = a.hi > 18446744073709551616.0 ? DoubleDouble{1.0 / a.hi, 0.0} : DoubleDouble{1.0, 0.0} / a;
+
+				const DoubleDouble one = {1.0, 0.0};
+				for(int i = 0; i < 3; ++i)
+					a = a / (one + sqrt(one + a * a));
+
+				const DoubleDouble a2 = a * a;
+				DoubleDouble power = a, sum = a;
+				for(int n = 1; n < 40 && abs(power.hi) > 1e-34 * abs(sum.hi); ++n)
+				{
+					power = -(power * a2);
+					sum = sum + power / DoubleDouble{double(2 * n + 1), 0.0};
+				}
+
+				sum = sum * DoubleDouble{8.0, 0.0};
+				return invert ? halfPi - sum : sum;
+			}
+
+			constexpr DoubleDouble atan(double x)
+			{
+				if(x != x || abs(x) < 7.450580596923828e-9)
+					return {x, 0.0};
+				const DoubleDouble res = isFinite(x) ? atan(DoubleDouble{abs(x), 0.0}) : halfPi;
+				return x < 0.0 ? -res : res;
+			}
+
+			// atan(sqrt(1 - x^2) / |x|) mirrored for negative x. 1 - x^2 is formed exactly, so the result stays
+			// accurate close to +-1.
+			constexpr DoubleDouble acos(double x)
+			{
+				if(!(abs(x) <= 1.0))
+					return {std::numeric_limits<double>::quiet_NaN(), 0.0};
+				if(abs(x) < 8.6736173798840355e-19)
+					return halfPi - DoubleDouble{x, 0.0};
+
+				const DoubleDouble s = sqrt(twoSum(1.0, -x) * twoSum(1.0, x));
+				const DoubleDouble res = atan(s / DoubleDouble{abs(x), 0.0});
+				return x < 0.0 ? pi - res : res;
+			}
+
+			// ==================== Dispatch ====================
+
+			// float and double use the constexpr kernels during constant evaluation and libm otherwise; other
+			// types always use libm. Integers are promoted to double like in <cmath>.
+			template <typename T>
+			using Real = std::conditional_t<std::is_integral<T>::value, double, T>;
+
+			template <typename T,
+					  bool = std::is_same<T, float>::value || std::is_same<T, double>::value>
+			struct Scalar
+			{
+				static T sqrt(T x)
+				{
+					return std::sqrt(x);
+				}
+
+				static T sin(T x)
+				{
+					return std::sin(x);
+				}
+
+				static T cos(T x)
+				{
+					return std::cos(x);
+				}
+
+				static T tan(T x)
+				{
+					return std::tan(x);
+				}
+
+				static T atan(T x)
+				{
+					return std::atan(x);
+				}
+
+				static T acos(T x)
+				{
+					return std::acos(x);
+				}
+			};
+
+			template <typename T>
+			struct Scalar<T, true>
+			{
+				static constexpr T sqrt(T x)
+				{
+					return constantEvaluated() ? T(cmath::sqrt(double(x))) : std::sqrt(x);
+				}
+
+				static constexpr T sin(T x)
+				{
+					return constantEvaluated() ? round(cmath::sin(double(x)), T{}) : std::sin(x);
+				}
+
+				static constexpr T cos(T x)
+				{
+					return constantEvaluated() ? round(cmath::cos(double(x)), T{}) : std::cos(x);
+				}
+
+				static constexpr T tan(T x)
+				{
+					return constantEvaluated() ? round(cmath::tan(double(x)), T{}) : std::tan(x);
+				}
+
+				static constexpr T atan(T x)
+				{
+					return constantEvaluated() ? round(cmath::atan(double(x)), T{}) : std::atan(x);
+				}
+
+				static constexpr T acos(T x)
+				{
+					return constantEvaluated() ? round(cmath::acos(double(x)), T{}) : std::acos(x);
+				}
+			};
+		}
+	}
+
+	// ==================== constexpr scalar functions ====================
+	// Usable in constant expressions, so rotations, projections and lookup tables built from them can be computed at
+	// compile time. For float and double the compile time results are correctly rounded (sin, cos and tan for
+	// |x| < 2^50); at runtime these forward to the <cmath> functions.
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> sqrt(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::sqrt(x);
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> sin(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::sin(x);
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> cos(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::cos(x);
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> tan(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::tan(x);
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> atan(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::atan(x);
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+	constexpr detail::cmath::Real<T> acos(T x)
+	{
+		return detail::cmath::Scalar<detail::cmath::Real<T>>::acos(x);
+	}
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef LMI_DUAL_H
+#define LMI_DUAL_H
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#include "matrix.h"
+#include "vector.h"
+
+namespace lmi
+{
+	// Forward mode automatic differentiation. A Dual holds a value and its partial derivatives with respect to N
+	// inputs; seeding input k with Dual::variable(x, k) makes every result of an expression carry its whole gradient,
+	// computed alongside the value in a single evaluation and exact up to rounding. The N tangent lanes are
+	// contiguous and every operation is a loop over them, so for larger N the derivative work runs in SIMD.
+	//
+	// Dual is trivially constructible and copyable and converts implicitly from T, so it works as the scalar type of
+	// Vector, Matrix and Quaternion. Comparisons only look at the value.
+	template <typename T, size_t N = 1>
+	struct Dual
+	{
+		static_assert(std::is_floating_point<T>::value, "Dual numbers need a floating point type");
+
+		using value_type = T;
+
+		T value;
+		T tangent[N];
+
+		Dual() = default;
+
+		constexpr Dual(T value) : value(value), tangent{}
+		{
+		}
+
+		static constexpr Dual variable(T value, size_t index)
+		{
+			Dual d(value);
+			d.tangent[index] = T{1};
+			return d;
+		}
+
+		// f(value) with the derivative f'(value), by the chain rule.
+		constexpr Dual chain(T f, T derivative) const
+		{
+			Dual d(f);
+			for(size_t i = 0; i < N; ++i)
+				d.tangent[i] = tangent[i] * derivative;
+			return d;
+		}
+
+		// ==================== Arithmetic operators ====================
+
+		constexpr Dual operator-() const
+		{
+			return chain(-value, T{-1});
+		}
+
+		constexpr Dual operator+() const
+		{
+			return *this;
+		}
+
+		constexpr Dual &operator+=(const Dual &rhs)
+		{
+			value += rhs.value;
+			for(size_t i = 0; i < N; ++i)
+				tangent[i] += rhs.tangent[i];
+			return *this;
+		}
+
+		constexpr Dual &operator-=(const Dual &rhs)
+		{
+			value -= rhs.value;
+			for(size_t i = 0; i < N; ++i)
+				tangent[i] -= rhs.tangent[i];
+			return *this;
+		}
+
+		constexpr Dual &operator*=(const Dual &rhs)
+		{
+			for(size_t i = 0; i < N; ++i)
+				tangent[i] = tangent[i] * rhs.value + value * rhs.tangent[i];
+			value *= rhs.value;
+			return *this;
+		}
+
+		constexpr Dual &operator/=(const Dual &rhs)
+		{
+			const T inv = T{1} / rhs.value, quotient = value * inv;
+			for(size_t i = 0; i < N; ++i)
+				tangent[i] = (tangent[i] - quotient * rhs.tangent[i]) * inv;
+			value = quotient;
+			return *this;
+		}
+
+		constexpr Dual &operator+=(T rhs)
+		{
+			value += rhs;
+			return *this;
+		}
+
+		constexpr Dual &operator-=(T rhs)
+		{
+			value -= rhs;
+			return *this;
+		}
+
+		constexpr Dual &operator*=(T rhs)
+		{
+			value *= rhs;
+			for(size_t i = 0; i < N; ++i)
+				tangent[i] *= rhs;
+			return *this;
+		}
+
+		constexpr Dual &operator/=(T rhs)
+		{
+			return *this *= T{1} / rhs;
+		}
+
+		// Friends, so that mixed expressions with T and integer constants convert implicitly.
+
+		constexpr friend Dual operator+(Dual lhs, const Dual &rhs)
+		{
+			return lhs += rhs;
+		}
+
+		constexpr friend Dual operator+(Dual lhs, T rhs)
+		{
+			return lhs += rhs;
+		}
+
+		constexpr friend Dual operator+(T lhs, Dual rhs)
+		{
+			return rhs += lhs;
+		}
+
+		constexpr friend Dual operator-(Dual lhs, const Dual &rhs)
+		{
+			return lhs -= rhs;
+		}
+
+		constexpr friend Dual operator-(Dual lhs, T rhs)
+		{
+			return lhs -= rhs;
+		}
+
+		constexpr friend Dual operator-(T lhs, const Dual &rhs)
+		{
+			return -rhs + lhs;
+		}
+
+		constexpr friend Dual operator*(Dual lhs, const Dual &rhs)
+		{
+			return lhs *= rhs;
+		}
+
+		constexpr friend Dual operator*(Dual lhs, T rhs)
+		{
+			return lhs *= rhs;
+		}
+
+		constexpr friend Dual operator*(T lhs, Dual rhs)
+		{
+			return rhs *= lhs;
+		}
+
+		constexpr friend Dual operator/(Dual lhs, const Dual &rhs)
+		{
+			return lhs /= rhs;
+		}
+
+		constexpr friend Dual operator/(Dual lhs, T rhs)
+		{
+			return lhs /= rhs;
+		}
+
+		constexpr friend Dual operator/(T lhs, const Dual &rhs)
+		{
+			return rhs.chain(lhs / rhs.value, -lhs / (rhs.value * rhs.value));
+		}
+
+		// ==================== Comparison operators ====================
+
+		constexpr friend bool operator==(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value == rhs.value;
+		}
+
+		constexpr friend bool operator!=(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value != rhs.value;
+		}
+
+		constexpr friend bool operator<(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value < rhs.value;
+		}
+
+		constexpr friend bool operator<=(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value <= rhs.value;
+		}
+
+		constexpr friend bool operator>(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value > rhs.value;
+		}
+
+		constexpr friend bool operator>=(const Dual &lhs, const Dual &rhs)
+		{
+			return lhs.value >= rhs.value;
+		}
+	};
+
+	namespace detail
+	{
+		// Scalar types accepted by Quaternion: arithmetic types and dual numbers over them.
+		template <typename T>
+		struct IsScalar : std::is_arithmetic<T>
+		{
+		};
+
+		template <typename T, size_t N>
+		struct IsScalar<Dual<T, N>> : std::true_type
+		{
+		};
+	}
+
+	// ==================== Elementary functions ====================
+
+	template <typename T, size_t N>
+	Dual<T, N> sqrt(const Dual<T, N> &x)
+	{
+		const T root = std::sqrt(x.value);
+		return x.chain(root, T{1} / (2 * root));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> cbrt(const Dual<T, N> &x)
+	{
+		const T root = std::cbrt(x.value);
+		return x.chain(root, T{1} / (3 * root * root));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> exp(const Dual<T, N> &x)
+	{
+		const T e = std::exp(x.value);
+		return x.chain(e, e);
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> log(const Dual<T, N> &x)
+	{
+		return x.chain(std::log(x.value), T{1} / x.value);
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> pow(const Dual<T, N> &x, typename Dual<T, N>::value_type exponent)
+	{
+		return x.chain(std::pow(x.value, exponent), exponent * std::pow(x.value, exponent - 1));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> pow(const Dual<T, N> &x, const Dual<T, N> &exponent)
+	{
+		return exp(exponent * log(x));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> sin(const Dual<T, N> &x)
+	{
+		return x.chain(std::sin(x.value), std::cos(x.value));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> cos(const Dual<T, N> &x)
+	{
+		return x.chain(std::cos(x.value), -std::sin(x.value));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> tan(const Dual<T, N> &x)
+	{
+		const T t = std::tan(x.value);
+		return x.chain(t, 1 + t * t);
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> asin(const Dual<T, N> &x)
+	{
+		return x.chain(std::asin(x.value), T{1} / std::sqrt(1 - x.value * x.value));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> acos(const Dual<T, N> &x)
+	{
+		return x.chain(std::acos(x.value), T{-1} / std::sqrt(1 - x.value * x.value));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> atan(const Dual<T, N> &x)
+	{
+		return x.chain(std::atan(x.value), T{1} / (1 + x.value * x.value));
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> atan2(const Dual<T, N> &y, const Dual<T, N> &x)
+	{
+		const T inv = T{1} / (x.value * x.value + y.value * y.value);
+		Dual<T, N> d(std::atan2(y.value, x.value));
+		for(size_t i = 0; i < N; ++i)
+			d.tangent[i] = (x.value * y.tangent[i] - y.value * x.tangent[i]) * inv;
+		return d;
+	}
+
+	template <typename T, size_t N>
+	Dual<T, N> abs(const Dual<T, N> &x)
+	{
+		return x.value < 0 ? -x : x;
+	}
+
+	// ==================== Derivatives of vector functions ====================
+
+	// x with tangent lanes seeded to the identity, component k being variable k.
+	template <size_t DIM, typename T>
+	constexpr Vector<DIM, Dual<T, DIM>> dualVariables(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, Dual<T, DIM>> v;
+		for(size_t k = 0; k < DIM; ++k)
+			v[k] = Dual<T, DIM>::variable(x[k], k);
+		return v;
+	}
+
+	// Gradient of a scalar function f(Vector<DIM, Dual<T, DIM>>) -> Dual<T, DIM> at x, from one evaluation.
+	template <size_t DIM, typename T, typename Function>
+	Vector<DIM, T> dualGradient(Function f, const Vector<DIM, T> &x)
+	{
+		const Dual<T, DIM> y = f(dualVariables(x));
+		Vector<DIM, T> g;
+		for(size_t k = 0; k < DIM; ++k)
+			g[k] = y.tangent[k];
+		return g;
+	}
+
+	namespace detail
+	{
+		template <size_t DIM, size_t ROWS, typename T>
+		Matrix<DIM, ROWS, T> tangentMatrix(const Vector<ROWS, Dual<T, DIM>> &y)
+		{
+			Matrix<DIM, ROWS, T> jacobian;
+			for(size_t k = 0; k < DIM; ++k)
+				for(size_t r = 0; r < ROWS; ++r)
+					jacobian[k][r] = y[r].tangent[k];
+			return jacobian;
+		}
+	}
+
+	// Jacobian of f(Vector<DIM, Dual<T, DIM>>) -> Vector<ROWS, Dual<T, DIM>> at x from one evaluation. Column k
+	// holds the partial derivatives with respect to x[k].
+	template <size_t DIM, typename T, typename Function>
+	auto dualJacobian(Function f, const Vector<DIM, T> &x)
+	{
+		return detail::tangentMatrix(f(dualVariables(x)));
+	}
+}
+
+#endif
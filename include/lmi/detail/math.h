@@ -0,0 +1,790 @@
+#ifndef LMI_MATH_H
+#define LMI_MATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "vector.h"
+
+namespace lmi
+{
+	// Accuracy of the transcendental functions below, measured against a higher precision reference. double and
+	// Accurate float run the double kernels, which stay within 1 ulp (below 0.9 ulp in testing), so Accurate float
+	// rounds correctly almost everywhere. Fast evaluates float kernels in single precision: exp and log within 1 ulp,
+	// atan2 and acos within 4, sin and cos within 2 ulp for |x| < 100 and 1e-7 absolute up to 2^13; the error of its
+	// pow grows with |y * log(x)|. sin, cos and tan of arguments beyond the range of the argument reduction
+	// (2^19 * pi / 2, or 2^13 for Fast) fall back to <cmath>.
+	enum class Precision
+	{
+		Accurate,
+		Fast
+	};
+
+	namespace detail
+	{
+		namespace math
+		{
+			// Every kernel is straight-line code with selects instead of branches, so a loop over the components
+			// of a Vector (or over an array) turns into packed SIMD instructions. The double kernels follow fdlibm,
+			// the single precision ones for Fast use the Cephes minimax polynomials.
+
+			inline uint64_t bits(double x)
+			{
+				uint64_t b;
+				std::memcpy(&b, &x, sizeof(b));
+				return b;
+			}
+
+			inline uint32_t bits(float x)
+			{
+				uint32_t b;
+				std::memcpy(&b, &x, sizeof(b));
+				return b;
+			}
+
+			inline double fromBits(uint64_t b)
+			{
+				double x;
+				std::memcpy(&x, &b, sizeof(x));
+				return x;
+			}
+
+			inline float fromBits(uint32_t b)
+			{
+				float x;
+				std::memcpy(&x, &b, sizeof(x));
+				return x;
+			}
+
+			// x with the low 32 bits cleared, leaving 21 significant bits so that products of two such values are
+			// exact.
+			inline double highHalf(double x)
+			{
+				return fromBits(bits(x) & ~uint64_t{0xffffffff});
+			}
+
+			// c ? a : b as a bitwise blend. With the default -ftrapping-math GCC does not if-convert ternaries on
+			// floating point comparisons, which keeps the loops around these kernels from vectorizing. Conditions are
+			// combined with & and | for the same reason.
+			template <typename T>
+			inline T select(bool c, T a, T b)
+			{
+				using Bits = decltype(bits(a));
+				const Bits mask = Bits{0} - Bits(c);
+				return fromBits(Bits((bits(a) & mask) | (bits(b) & ~mask)));
+			}
+
+			// Adding 1.5 * 2^52 (1.5 * 2^23) rounds to the nearest integer and leaves that integer in the low
+			// mantissa bits, without a libm call or a float to int conversion.
+			const double roundMagic = 6755399441055744.0;
+			const float roundMagicF = 12582912.0f;
+
+			const double pi = 3.14159265358979323846;
+			const double piLo = 1.2246467991473531772e-16;
+
+			// ==================== sin, cos ====================
+
+			// Argument reduction by multiples of pi/2 as in fdlibm's __ieee754_rem_pio2 for medium arguments: pi/2 is
+			// split into three 33 bit parts so every j * part is exact. fdlibm only takes the third round when the
+			// second one cancels; here all rounds run, so the rounding error of the second one is carried into the
+			// third. The reduced argument is returned as hi + lo, with |hi| <= pi / 4 and the quadrant j in the low
+			// bits of q. Accurate for |x| < sincosLimit, the Vector functions hand larger arguments to <cmath>.
+			const double sincosLimit = 823549.6653119254;	// 2^19 * pi / 2
+
+			inline double reducePiOver2(double x, double &lo, uint64_t &q)
+			{
+				const double t = x * 0.63661977236758134308 + roundMagic;
+				q = bits(t);
+				const double j = t - roundMagic;
+				double r = x - j * 1.57079632673412561417e+00;
+				double w = j * 6.07710050630396597660e-11;
+				double u = r;
+				r = u - w;
+				const double e = (u - r) - w;
+				u = r;
+				w = j * 2.02226624871116645580e-21;
+				r = u - w;
+				w = j * 8.47842766036889956997e-32 - (((u - r) - w) + e);
+				const double hi = r - w;
+				lo = (r - hi) - w;
+				return hi;
+			}
+
+			// fdlibm's __kernel_sin and __kernel_cos on the reduced argument, which sum the small terms first.
+			inline void sincos(double x, double &s, double &c)
+			{
+				double rLo;
+				uint64_t q;
+				const double rHi = reducePiOver2(x, rLo, q);
+				const double z = rHi * rHi, v = z * rHi;
+
+				const double sp = (((1.58969099521155010221e-10 * z - 2.50507602534068634195e-8) * z +
+									2.75573137070700676789e-6) * z - 1.98412698298579493134e-4) * z +
+								  8.33333333332248946124e-3;
+				const double sr = rHi - ((z * (0.5 * rLo - v * sp) - rLo) - v * -1.66666666666666324348e-1);
+				const double cp = ((((-1.13596475577881948265e-11 * z + 2.08757232129817482790e-9) * z -
+									 2.75573143513906633035e-7) * z + 2.48015872894767294178e-5) * z -
+								   1.38888888888741095749e-3) * z + 4.16666666666666019037e-2;
+				const double hz = 0.5 * z, h = 1.0 - hz;
+				const double cr = h + (((1.0 - h) - hz) + (z * z * cp - rHi * rLo));
+
+				const bool swap = (q & 1) != 0;
+				const bool negateSin = (q & 2) != 0;
+				const bool negateCos = ((q + 1) & 2) != 0;
+				s = select(swap, cr, sr);
+				c = select(swap, sr, cr);
+				s = select(negateSin, -s, s);
+				c = select(negateCos, -c, c);
+			}
+
+			// fdlibm's __kernel_tan. Beyond 0.6744 the argument is mirrored at pi / 4, and in odd quadrants -1 / tan is
+			// formed with a correction step instead of a plain division.
+			inline double tan(double x)
+			{
+				double y;
+				uint64_t q;
+				const double r = reducePiOver2(x, y, q);
+				const bool negative = r < 0.0;
+				const bool big = std::abs(r) >= 0.6743354797363281;
+				const double odd = select((q & 1) != 0, -1.0, 1.0);
+				const double mx = select(negative, -r, r), my = select(negative, -y, y);
+				const double t = select(big, (7.85398163397448278999e-01 - mx) + (3.06161699786838301793e-17 - my), r);
+				const double tLo = select(big, 0.0, y);
+
+				const double z = t * t, w = z * z;
+				const double odds = 1.33333333333201242699e-01 +
+									w * (2.18694882948595424599e-02 +
+										 w * (3.59207910759131235356e-03 +
+											  w * (5.88041240820264096874e-04 +
+												   w * (7.81794442939557092300e-05 +
+														w * -1.85586374855275456654e-05))));
+				const double evens = z * (5.39682539762260521377e-02 +
+										  w * (8.86323982359930005737e-03 +
+											   w * (1.45620945432529025516e-03 +
+													w * (2.46463134818469906812e-04 +
+														 w * (7.14072491382608190305e-05 +
+															  w * 2.59073051863633712884e-05)))));
+				const double cube = z * t;
+				const double tail = tLo + z * (cube * (odds + evens) + tLo) + 3.33333333333334091986e-01 * cube;
+				const double sum = t + tail;
+
+				const double mirrored = odd - 2.0 * (t - (sum * sum / (sum + odd) - tail));
+				const double sumHi = highHalf(sum);
+				const double sumLo = tail - (sumHi - t);
+				const double inverse = -1.0 / sum;
+				const double inverseHi = highHalf(inverse);
+				const double cotangent = inverseHi + inverse * ((1.0 + inverseHi * sumHi) + inverseHi * sumLo);
+				const double res =
+					select(big, select(negative, -mirrored, mirrored), select(odd < 0.0, cotangent, sum));
+				return select(x == 0.0, x, res);
+			}
+
+			// Single precision reduction and polynomials, accurate for |x| < 2^13.
+			const float sincosFastLimit = 8192.0f;
+
+			inline void sincosFast(float x, float &s, float &c)
+			{
+				const float t = x * 0.636619772367581343f + roundMagicF;
+				const uint32_t q = bits(t);
+				const float j = t - roundMagicF;
+				const float r = ((x - j * 1.5703125f) - j * 4.837512969970703125e-4f) - j * 7.54978995489188216e-8f;
+				const float z = r * r;
+
+				const float sr = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+				const float cp = (2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f;
+				const float cr = cp * z * z - 0.5f * z + 1.0f;
+
+				const bool swap = (q & 1) != 0;
+				const bool negateSin = (q & 2) != 0;
+				const bool negateCos = ((q + 1) & 2) != 0;
+				s = select(swap, cr, sr);
+				c = select(swap, sr, cr);
+				s = select(negateSin, -s, s);
+				c = select(negateCos, -c, c);
+			}
+
+			// ==================== exp ====================
+
+			// Scaling by 2^n happens in two steps so that neither factor overflows and results in the subnormal
+			// range are rounded only once.
+			inline double exp(double x)
+			{
+				const double hi = 709.782712893383973096, lo = -745.133219101941108420;
+				const double xc = select(x > hi, hi, select(x < lo, lo, x));
+				const double t = xc * 1.4426950408889634074 + roundMagic;
+				const double n = t - roundMagic;
+				const int32_t ni = static_cast<int32_t>(static_cast<uint32_t>(bits(t)));
+
+				// fdlibm's rational form, with r = rHi - rLo kept in two parts: 1 + r + r^2 / 2 + ... =
+				// 1 - ((rLo - r c / (2 - c)) - rHi) where c = r - r^2 P(r^2).
+				const double rHi = xc - n * 6.93147180369123816490e-01;
+				const double rLo = n * 1.90821492927058770002e-10;
+				const double r = rHi - rLo;
+				const double z = r * r;
+				const double c = r - z * ((((4.13813679705723846039e-08 * z - 1.65339022054652515390e-06) * z +
+											6.61375632143793436117e-05) * z - 2.77777777770155933842e-03) * z +
+										  1.66666666666666019037e-01);
+				const double e = 1.0 - ((rLo - (r * c) / (2.0 - c)) - rHi);
+
+				const int32_t n1 = ni / 2, n2 = ni - n1;
+				const double res = e * fromBits(static_cast<uint64_t>(n1 + 1023) << 52) *
+								   fromBits(static_cast<uint64_t>(n2 + 1023) << 52);
+				return select(x > hi, std::numeric_limits<double>::infinity(), select(x < lo, 0.0, res));
+			}
+
+			inline float expFast(float x)
+			{
+				const float hi = 88.7228391117f, lo = -103.972076f;
+				const float xc = select(x > hi, hi, select(x < lo, lo, x));
+				const float t = xc * 1.44269504088896341f + roundMagicF;
+				const float n = t - roundMagicF;
+				const int32_t ni = static_cast<int32_t>(bits(t) & 0x7fffff) - 0x400000;
+				const float r = (xc - n * 0.693359375f) + n * 2.12194440e-4f;
+				const float z = r * r;
+
+				const float e = (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r +
+								   4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f) * z + r + 1.0f;
+
+				const int32_t n1 = ni / 2, n2 = ni - n1;
+				const float res = e * fromBits(static_cast<uint32_t>(n1 + 127) << 23) *
+								  fromBits(static_cast<uint32_t>(n2 + 127) << 23);
+				return select(x > hi, std::numeric_limits<float>::infinity(), select(x < lo, 0.0f, res));
+			}
+
+			// ==================== log ====================
+
+			inline double log(double x)
+			{
+				// Subnormals are scaled into the normal range first.
+				const bool subnormal = x < std::numeric_limits<double>::min();
+				const uint64_t b = bits(select(subnormal, x * 18014398509481984.0, x));
+				const int32_t exponent = static_cast<int32_t>((b >> 52) & 0x7ff) - 1022;
+				double e = static_cast<double>(exponent) - select(subnormal, 54.0, 0.0);
+				double m = fromBits(uint64_t{(b & 0x000fffffffffffffull) | 0x3fe0000000000000ull});
+
+				const bool small = m < 0.70710678118654752440;
+				m = select(small, m + m - 1.0, m - 1.0);
+				e = select(small, e - 1.0, e);
+
+				const double z = m * m;
+				const double p = ((((1.01875663804580931796e-4 * m + 4.97494994976747001425e-1) * m +
+									4.70579119878881725854e0) * m + 1.44989225341610930846e1) * m +
+								  1.79368678507819816313e1) * m + 7.70838733755885391666e0;
+				const double q = ((((m + 1.12873587189167450590e1) * m + 4.52279145837532221105e1) * m +
+								   8.29875266912776603211e1) * m + 7.11544750618563894466e1) * m +
+								 2.31251620126765340583e1;
+				const double y = m * (z * p / q) - e * 2.121944400546905827679e-4 - 0.5 * z;
+				const double res = m + y + e * 0.693359375;
+
+				double special = select(x == std::numeric_limits<double>::infinity(), x, res);
+				special = select(x == 0.0, -std::numeric_limits<double>::infinity(), special);
+				special = select(x < 0.0, std::numeric_limits<double>::quiet_NaN(), special);
+				return select(x != x, x, special);
+			}
+
+			inline float logFast(float x)
+			{
+				const bool subnormal = x < std::numeric_limits<float>::min();
+				const uint32_t b = bits(select(subnormal, x * 33554432.0f, x));
+				const int32_t exponent = static_cast<int32_t>((b >> 23) & 0xff) - 126;
+				float e = static_cast<float>(exponent) - select(subnormal, 25.0f, 0.0f);
+				float m = fromBits((b & 0x7fffffu) | 0x3f000000u);
+
+				const bool small = m < 0.707106781186547524f;
+				m = select(small, m + m - 1.0f, m - 1.0f);
+				e = select(small, e - 1.0f, e);
+
+				const float z = m * m;
+				const float y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m + 1.1676998740e-1f) * m -
+									  1.2420140846e-1f) * m + 1.4249322787e-1f) * m - 1.6668057665e-1f) * m +
+								   2.0000714765e-1f) * m - 2.4999993993e-1f) * m + 3.3333331174e-1f) * m * z -
+								e * 2.12194440e-4f - 0.5f * z;
+				const float res = m + y + e * 0.693359375f;
+
+				float special = select(x == std::numeric_limits<float>::infinity(), x, res);
+				special = select(x == 0.0f, -std::numeric_limits<float>::infinity(), special);
+				special = select(x < 0.0f, std::numeric_limits<float>::quiet_NaN(), special);
+				return select(x != x, x, special);
+			}
+
+			// ==================== atan, atan2, acos ====================
+
+			// fdlibm's atan of a >= 0: a is moved next to 0, 0.5, 1, 1.5 or infinity, whose atan is stored in two
+			// parts. The result is that of a + aLo, the small aLo entering to first order as aLo / (1 + a^2). With
+			// reflect set it is pi minus that, formed before the single final rounding.
+			inline double atanKernel(double a, double aLo, bool reflect)
+			{
+				const double correction = aLo / (1.0 + a * a);
+				const bool i0 = a < 0.4375, i1 = a < 0.6875, i2 = a < 1.1875, i3 = a < 2.4375;
+				const double t = select(i0, a, select(i1, (2.0 * a - 1.0) / (2.0 + a),
+													  select(i2, (a - 1.0) / (a + 1.0),
+															 select(i3, (a - 1.5) / (1.0 + 1.5 * a), -1.0 / a))));
+				const double hi = select(i0, 0.0, select(i1, 4.63647609000806093515e-01,
+														 select(i2, 7.85398163397448278999e-01,
+																select(i3, 9.82793723247329054082e-01,
+																	   1.57079632679489655800e+00))));
+				const double lo = select(i0, 0.0, select(i1, 2.26987774529616870924e-17,
+														 select(i2, 3.06161699786838301793e-17,
+																select(i3, 1.39033110312309984516e-17,
+																	   6.12323399573676603587e-17))));
+
+				const double z = t * t, w = z * z;
+				const double s1 = z * (3.33333333333329318027e-01 +
+									   w * (1.42857142725034663711e-01 +
+											w * (9.09088713343650656196e-02 +
+												 w * (6.66107313738753120669e-02 +
+													  w * (4.97687799461593236017e-02 +
+														   w * 1.62858201153657823623e-02)))));
+				const double s2 = w * (-1.99999999998764832476e-01 +
+									   w * (-1.11111104054623557880e-01 +
+											w * (-7.69187620504482999495e-02 +
+												 w * (-5.83357013379057348645e-02 + w * -3.65315727442169155270e-02))));
+				const double poly = t * (s1 + s2);
+
+				// atan(a) = hi + lo + t - poly + correction, and pi - hi = reflected + reflectedLo exactly.
+				const double reflected = pi - hi;
+				const double reflectedLo = ((pi - reflected) - hi) + (piLo - lo);
+				return select(reflect, reflected - ((t - (poly - correction)) - reflectedLo),
+							  hi - ((poly - (lo + correction)) - t));
+			}
+
+			inline double atan(double x)
+			{
+				return std::copysign(atanKernel(std::abs(x), 0.0, false), x);
+			}
+
+			// atan(|y / x|) with the rounding error of the quotient, y - q x, taken into account, reflected for
+			// negative x. y and x are scaled by a power of two that brings x near 1, then q x is formed from halves
+			// of 21 and 32 bits whose products are exact. For quotients so large or small that the error does not
+			// matter the correction is dropped. Zeros and infinities follow libm, except that both infinite gives NaN.
+			inline double atan2(double y, double x)
+			{
+				const double q = y / x;
+				const uint64_t exponent = (bits(x) >> 52) & 0x7ff;
+				const double scale = fromBits(((2046 - exponent) & 0x7ff) << 52);
+				const double xs = x * scale, ys = y * scale;
+				const double qHi = highHalf(q), qLo = q - qHi, xHi = highHalf(xs), xLo = xs - xHi;
+				const double residual = (((ys - qHi * xHi) - qHi * xLo) - qLo * xHi) - qLo * xLo;
+				const double aq = std::abs(q);
+				const bool safe = (exponent < 2046) & (aq > 1e-290) & (aq < 1e290);
+				const double qCorrection = select(safe, residual / xs, 0.0);
+
+				const bool zero = (x == 0.0) & (y == 0.0);
+				const double a = select(zero, 0.0, aq);
+				const double aLo = select(zero | (q < 0.0), -qCorrection, qCorrection);
+				const bool negativeX = (bits(x) >> 63) != 0;
+				return std::copysign(atanKernel(a, select(zero, 0.0, aLo), negativeX), y);
+			}
+
+			inline float atanFast(float x)
+			{
+				const float a = std::abs(x);
+				const bool big = a > 2.414213562373095f;
+				const bool mid = !big & (a > 0.4142135623730950f);
+				const float t = select(big, -1.0f / a, select(mid, (a - 1.0f) / (a + 1.0f), a));
+				const float y0 = select(big, 1.570796326794896619f, select(mid, 0.7853981633974483096f, 0.0f));
+
+				const float z = t * t;
+				const float p =
+					((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f;
+				const float res = y0 + (p * z * t + t);
+				return std::copysign(res, x);
+			}
+
+			// atan(y / x) moved into the right quadrant. Both zero gives +-0 or +-pi depending on the sign of x like
+			// libm; both infinite gives NaN.
+			template <typename T, typename Atan>
+			inline T atan2(T y, T x, Atan atan)
+			{
+				const T piHi = T(pi);
+				const T piLow = T(piLo);
+				const bool negativeX = (bits(x) >> (sizeof(T) * 8 - 1)) != 0;
+				const bool negativeY = (bits(y) >> (sizeof(T) * 8 - 1)) != 0;
+
+				const T r = select((x == T{0}) & (y == T{0}), y, atan(y / x));
+				const T shifted = select(negativeY, (r - piLow) - piHi, (r + piLow) + piHi);
+				return select(negativeX, shifted, r);
+			}
+
+			// std::sqrt may set errno, so unless -fno-math-errno is given GCC keeps a branch here and loops over acos
+			// stay scalar.
+			template <typename T, typename Atan2>
+			inline T acos(T x, Atan2 atan2)
+			{
+				return atan2(std::sqrt((T{1} - x) * (T{1} + x)), x);
+			}
+
+			// fdlibm's acos, a rational approximation of asin around 0 and the half angle formula towards +-1.
+			inline double acos(double x)
+			{
+				const double a = std::abs(x);
+				const bool center = a < 0.5;
+				const double z = select(center, x * x, (1.0 - a) * 0.5);
+				const double p = z * (1.66666666666666657415e-01 +
+									  z * (-3.25565818622400915405e-01 +
+										   z * (2.01212532134862925881e-01 +
+												z * (-4.00555345006794114027e-02 +
+													 z * (7.91534994289814532176e-04 +
+														  z * 3.47933107596021167570e-05)))));
+				const double q = 1.0 + z * (-2.40339491173441421878e+00 +
+											z * (2.02094576023350569471e+00 +
+												 z * (-6.88283971605453293030e-01 + z * 7.70381505559019352791e-02)));
+				const double r = p / q;
+				const double s = std::sqrt(z);
+				const double pio2Hi = 1.57079632679489655800e+00, pio2Lo = 6.12323399573676603587e-17;
+
+				// Towards 1 the square root is split so that 2 * (sHi + w) adds its rounding error back.
+				const double sHi = highHalf(s);
+				const double correction = (z - sHi * sHi) / (s + sHi);
+				const double positive = 2.0 * (sHi + (r * s + correction));
+				const double negative = 2.0 * pio2Hi - 2.0 * (s + (r * s - pio2Lo));
+				const double res = select(center, pio2Hi - (x - (pio2Lo - x * r)), select(x < 0.0, negative, positive));
+				return select(x == 1.0, 0.0, res);
+			}
+
+			// ==================== pow ====================
+
+			// |x|^y plus the sign and special case rules of std::pow, with magnitude(|x|, y) computing the former.
+			template <typename T, typename Magnitude>
+			inline T pow(T x, T y, Magnitude magnitude)
+			{
+				const T ax = std::abs(x);
+				const T ay = std::abs(y);
+				const T res = magnitude(ax, y);
+
+				// Below 2^(digits - 1) adding that power of two rounds y to an integer and leaves its parity in the
+				// lowest mantissa bit. From there up to 2^digits every value is an integer with the parity in its own
+				// lowest mantissa bit, beyond that every value is even.
+				const T half = T(uint64_t{1} << (std::numeric_limits<T>::digits - 1));
+				const T rounded = ay + half;
+				const bool integer = (ay >= half) | (rounded - half == ay);
+
+				// The lowest bit of an odd integer moved into the sign bit.
+				using Bits = decltype(bits(x));
+				const Bits parity = bits(select(ay < half, rounded, ay)) << (sizeof(T) * 8 - 1);
+				const Bits oddSign = parity & (Bits{0} - Bits(integer & (ay < half * 2)));
+
+				// A negative base (including -0 and -inf) takes the sign of odd integer powers. Only finite nonzero
+				// bases with a non-integer exponent have no real result.
+				const T nan = std::numeric_limits<T>::quiet_NaN(), inf = std::numeric_limits<T>::infinity();
+				const bool real = integer | (ax == T{0}) | (ax == inf);
+				const T signedRes = select(real, fromBits(Bits(bits(res) ^ oddSign)), nan);
+				const bool negative = (bits(x) >> (sizeof(T) * 8 - 1)) != 0;
+				const bool one = (y == T{0}) | (x == T{1}) | ((ax == T{1}) & (ay == inf));
+				return select(one, T{1}, select(negative, signedRes, res));
+			}
+
+			// fdlibm's pow: log2(x) as t1 + t2 and its product with y as pHi + pLo, each carried in double-double
+			// with 21 bit high parts so that the products are exact, then 2^(pHi + pLo) like exp. Within 1 ulp.
+			inline double powMagnitude(double ax, double y)
+			{
+				const double inf = std::numeric_limits<double>::infinity();
+				const bool subnormal = ax < std::numeric_limits<double>::min();
+				const uint64_t b = bits(select(subnormal, ax * 9007199254740992.0, ax));
+				const uint32_t high = static_cast<uint32_t>(b >> 32), j = high & 0xfffff;
+				const bool mid = (j > 0x3988e) & (j < 0xbb67a), upper = j >= 0xbb67a;
+
+				// The mantissa m is brought into [sqrt(3) / 2, sqrt(3 / 2)) around bp = 1 or [sqrt(3 / 2), sqrt(3))
+				// around bp = 1.5, and log2(m) = log2(bp) + 2 / (3 ln 2) * (3 s + s^3 + ...) with
+				// s = (m - bp) / (m + bp).
+				const uint32_t mHigh = (j | 0x3ff00000) - (upper ? 0x00100000 : 0);
+				const double m = fromBits((uint64_t{mHigh} << 32) | (b & 0xffffffff));
+				const double n = static_cast<double>(static_cast<int32_t>(high >> 20) - 1023) -
+								 select(subnormal, 53.0, 0.0) + select(upper, 1.0, 0.0);
+				const double bp = select(mid, 1.5, 1.0);
+				const double dpHi = select(mid, 5.84962487220764160156e-01, 0.0);
+				const double dpLo = select(mid, 1.35003920212974897128e-08, 0.0);
+
+				const double u = m - bp, v = 1.0 / (m + bp);
+				const double ss = u * v, sHi = highHalf(ss);
+				const uint32_t tHigh = ((mHigh >> 1) | 0x20000000) + 0x00080000 + (mid ? 0x00040000 : 0);
+				const double tHi = fromBits(uint64_t{tHigh} << 32), tLo = m - (tHi - bp);
+				const double sLo = v * ((u - sHi * tHi) - sHi * tLo);
+
+				double s2 = ss * ss;
+				double r = s2 * s2 * (5.99999999999994648725e-01 +
+									  s2 * (4.28571428578550184252e-01 +
+											s2 * (3.33333329818377432918e-01 +
+												  s2 * (2.72728123808534006489e-01 +
+														s2 * (2.30660745775561754067e-01 +
+															  s2 * 2.06975017800338417784e-01)))));
+				r += sLo * (sHi + ss);
+				s2 = sHi * sHi;
+				const double t3Hi = highHalf(3.0 + s2 + r), t3Lo = r - ((t3Hi - 3.0) - s2);
+				const double uu = sHi * t3Hi, vv = sLo * t3Hi + t3Lo * ss;
+				const double pHi = highHalf(uu + vv), pLo = vv - (pHi - uu);
+				const double zHi = 9.61796700954437255859e-01 * pHi;
+				const double zLo = -7.02846165095275826516e-09 * pHi + pLo * 9.61796693925975554329e-01 + dpLo;
+				const double t1 = highHalf(((zHi + zLo) + dpHi) + n), t2 = zLo - (((t1 - n) - dpHi) - zHi);
+
+				// y * log2(x), or its limit when x is zero or not finite or y is infinite.
+				const bool special = !(ax < inf) | (ax == 0.0) | !(std::abs(y) < inf);
+				const double log2x = select(ax == 0.0, -inf, select(ax < inf, t1 + t2, ax));
+				const double y1 = highHalf(y);
+				const double eHi = select(special, y * log2x, y1 * t1);
+				const double eLo = select(special, 0.0, (y - y1) * t1 + y * t2);
+				const double e = eHi + eLo;
+
+				// Beyond the range of double the exponent is clamped to values that still overflow or underflow.
+				const bool clamped = !((e < 1030.0) & (e > -1080.0));
+				const double hi = select(clamped, select(e > 0.0, 1030.0, -1080.0), eHi);
+				const double lo = select(clamped, 0.0, eLo);
+				const double rt = (hi + lo) + roundMagic;
+				const double k = rt - roundMagic;
+				const int32_t ki = static_cast<int32_t>(static_cast<uint32_t>(bits(rt)));
+				const double h = hi - k;
+
+				const double t = highHalf(lo + h);
+				const double tu = t * 6.93147182464599609375e-01;
+				const double tv = (lo - (t - h)) * 6.93147180559945286227e-01 + t * -1.90465429995776804525e-09;
+				const double z = tu + tv, w = tv - (z - tu);
+				const double zz = z * z;
+				const double c = z - zz * (1.66666666666666019037e-01 +
+										   zz * (-2.77777777770155933842e-03 +
+												 zz * (6.61375632143793436117e-05 +
+													   zz * (-1.65339022054652515390e-06 +
+															 zz * 4.13813679705723846039e-08))));
+				const double ez = 1.0 - (((z * c) / (c - 2.0) - (w + z * w)) - z);
+
+				const int32_t k1 = ki / 2, k2 = ki - k1;
+				const double res = ez * fromBits(static_cast<uint64_t>(k1 + 1023) << 52) *
+								   fromBits(static_cast<uint64_t>(k2 + 1023) << 52);
+				return select(e != e, e, res);
+			}
+
+			// ==================== Precision dispatch ====================
+
+			template <Precision P>
+			inline void sincos(float x, float &s, float &c)
+			{
+				if(P == Precision::Fast)
+				{
+					sincosFast(x, s, c);
+					return;
+				}
+				double sd, cd;
+				sincos(static_cast<double>(x), sd, cd);
+				s = static_cast<float>(sd);
+				c = static_cast<float>(cd);
+			}
+
+			template <Precision P>
+			inline void sincos(double x, double &s, double &c)
+			{
+				sincos(x, s, c);
+			}
+
+			template <Precision P>
+			inline float tan(float x)
+			{
+				if(P == Precision::Fast)
+				{
+					float s, c;
+					sincosFast(x, s, c);
+					return s / c;
+				}
+				return static_cast<float>(tan(static_cast<double>(x)));
+			}
+
+			template <Precision P>
+			inline double tan(double x)
+			{
+				return tan(x);
+			}
+
+			template <Precision P>
+			inline float exp(float x)
+			{
+				return P == Precision::Fast ? expFast(x) : static_cast<float>(exp(static_cast<double>(x)));
+			}
+
+			template <Precision P>
+			inline double exp(double x)
+			{
+				return exp(x);
+			}
+
+			template <Precision P>
+			inline float log(float x)
+			{
+				return P == Precision::Fast ? logFast(x) : static_cast<float>(log(static_cast<double>(x)));
+			}
+
+			template <Precision P>
+			inline double log(double x)
+			{
+				return log(x);
+			}
+
+			template <Precision P>
+			inline float atan2(float y, float x)
+			{
+				if(P == Precision::Fast)
+					return atan2(y, x, [](float v) { return atanFast(v); });
+				return static_cast<float>(atan2(static_cast<double>(y), static_cast<double>(x)));
+			}
+
+			template <Precision P>
+			inline double atan2(double y, double x)
+			{
+				return atan2(y, x);
+			}
+
+			template <Precision P>
+			inline float acos(float x)
+			{
+				if(P == Precision::Fast)
+					return acos(x, [](float a, float b) { return atan2<P>(a, b); });
+				return static_cast<float>(acos(static_cast<double>(x)));
+			}
+
+			template <Precision P>
+			inline double acos(double x)
+			{
+				return acos(x);
+			}
+
+			template <Precision P>
+			inline float pow(float x, float y)
+			{
+				if(P == Precision::Fast)
+					return pow(x, y, [](float a, float b) { return expFast(b * logFast(a)); });
+				return static_cast<float>(pow(static_cast<double>(x), static_cast<double>(y), powMagnitude));
+			}
+
+			template <Precision P>
+			inline double pow(double x, double y)
+			{
+				return pow(x, y, powMagnitude);
+			}
+		}
+	}
+
+	// ==================== Component wise functions on Vector ====================
+	// Work for any dimension, so besides vec4 and vec4d the wider Vector<8, float> and Vector<16, float> serve as
+	// AVX and AVX-512 sized packets.
+
+	namespace detail
+	{
+		namespace math
+		{
+			// Runs kernel(i) on every component when all of x lies within the range of the argument reduction,
+			// otherwise those beyond it (and NaN, which are rare) go to fallback(i) one by one.
+			template <Precision P, size_t DIM, typename T, typename Kernel, typename Fallback>
+			void reduced(const Vector<DIM, T> &x, Kernel kernel, Fallback fallback)
+			{
+				const T limit = P == Precision::Fast && std::is_same<T, float>::value ? T(sincosFastLimit)
+																					   : T(sincosLimit);
+				bool outside = false;
+				for(size_t i = 0; i < DIM; ++i)
+					outside |= !(std::abs(x[i]) < limit);
+
+				if(!outside)
+				{
+					for(size_t i = 0; i < DIM; ++i)
+						kernel(i);
+					return;
+				}
+				for(size_t i = 0; i < DIM; ++i)
+				{
+					if(std::abs(x[i]) < limit)
+						kernel(i);
+					else
+						fallback(i);
+				}
+			}
+		}
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	void sincos(const Vector<DIM, T> &x, Vector<DIM, T> &s, Vector<DIM, T> &c)
+	{
+		detail::math::reduced<P>(
+			x, [&](size_t i) { detail::math::sincos<P>(x[i], s[i], c[i]); },
+			[&](size_t i) {
+				s[i] = std::sin(x[i]);
+				c[i] = std::cos(x[i]);
+			});
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> sin(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> s, c;
+		sincos<P>(x, s, c);
+		return s;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> cos(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> s, c;
+		sincos<P>(x, s, c);
+		return c;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> tan(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> res;
+		detail::math::reduced<P>(
+			x, [&](size_t i) { res[i] = detail::math::tan<P>(x[i]); }, [&](size_t i) { res[i] = std::tan(x[i]); });
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> atan2(const Vector<DIM, T> &y, const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> res;
+		for(size_t i = 0; i < DIM; ++i)
+			res[i] = detail::math::atan2<P>(y[i], x[i]);
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> acos(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> res;
+		for(size_t i = 0; i < DIM; ++i)
+			res[i] = detail::math::acos<P>(x[i]);
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> exp(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> res;
+		for(size_t i = 0; i < DIM; ++i)
+			res[i] = detail::math::exp<P>(x[i]);
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> log(const Vector<DIM, T> &x)
+	{
+		Vector<DIM, T> res;
+		for(size_t i = 0; i < DIM; ++i)
+			res[i] = detail::math::log<P>(x[i]);
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> pow(const Vector<DIM, T> &x, const Vector<DIM, T> &y)
+	{
+		Vector<DIM, T> res;
+		for(size_t i = 0; i < DIM; ++i)
+			res[i] = detail::math::pow<P>(x[i], y[i]);
+		return res;
+	}
+
+	template <Precision P = Precision::Accurate, size_t DIM, typename T>
+	Vector<DIM, T> pow(const Vector<DIM, T> &x, T y)
+	{
+		return pow<P>(x, Vector<DIM, T>(y));
+	}
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef LMI_PARALLEL_H
+#define LMI_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace lmi
+{
+	namespace detail
+	{
+		inline size_t resolveThreadCount(size_t threads)
+		{
+			if(threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			return threads;
+		}
+
+		// Size of the chunks parallelChunks() splits `count` items into for the given thread count.
+		inline size_t chunkSize(size_t count, size_t threads)
+		{
+			threads = std::min(resolveThreadCount(threads), count);
+			return threads != 0 ? (count + threads - 1) / threads : 0;
+		}
+
+		inline size_t chunkCount(size_t count, size_t threads)
+		{
+			const size_t chunk = chunkSize(count, threads);
+			return chunk != 0 ? (count + chunk - 1) / chunk : 0;
+		}
+
+		// Splits [0, count) into chunkCount(count, threads) contiguous chunks and calls f(chunk, begin, end) for each
+		// of them on its own thread. The chunk index lets callers keep per-chunk partial results for a reduction in a
+		// fixed order afterwards. threads == 0 uses every hardware thread, threads == 1 runs inline without spawning
+		// (and allocating) anything, so the serial path stays usable in freestanding code.
+		template <typename Function>
+		void parallelChunks(size_t count, size_t threads, Function &&f)
+		{
+			const size_t chunk = chunkSize(count, threads);
+			const size_t chunks = chunkCount(count, threads);
+			if(chunks <= 1)
+			{
+				if(count != 0)
+					f(size_t{0}, size_t{0}, count);
+				return;
+			}
+
+			std::vector<std::thread> pool;
+			pool.reserve(chunks - 1);
+			for(size_t i = 1; i < chunks; ++i)
+			{
+				const size_t begin = i * chunk;
+				const size_t end = std::min(begin + chunk, count);
+				pool.emplace_back([&f, i, begin, end] { f(i, begin, end); });
+			}
+			f(size_t{0}, size_t{0}, chunk);
+			for(auto &t : pool)
+				t.join();
+		}
+
+		// Like parallelChunks() for callers that only need the range.
+		template <typename Function>
+		void parallelFor(size_t count, size_t threads, Function &&f)
+		{
+			parallelChunks(count, threads, [&f](size_t, size_t begin, size_t end) { f(begin, end); });
+		}
+	}
+}
+
+#endif
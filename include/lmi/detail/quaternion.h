@@ -1,12 +1,16 @@
 #ifndef LMI_QUATERNION_H
 #define LMI_QUATERNION_H
 
+#include <cmath>
+
+#include "constexpr_math.h"
+#include "dual.h"
 #include "matrix.h"
 #include "vector.h"
 
 namespace lmi
 {
-	template <typename T, typename = typename std::enable_if_t<std::is_arithmetic<T>::value>>
+	template <typename T, typename = typename std::enable_if_t<detail::IsScalar<T>::value>>
 	class Quaternion
 	{
 		public:
@@ -25,27 +29,35 @@ namespace lmi
 		}
 
 		constexpr explicit Quaternion(T real, const Vector<3, T> &vec)
+			: q0(real)
+			, q1(vec[0])
+			, q2(vec[1])
+			, q3(vec[2])
 		{
-			q0 = real;
-			q1 = vec[0];
-			q2 = vec[1];
-			q3 = vec[2];
 		}
 
 		constexpr explicit Quaternion(const Vector<3, T> &vec)
 			: q0(T{})
+			, q1(vec[0])
+			, q2(vec[1])
+			, q3(vec[2])
 		{
-			q1 = vec[0];
-			q2 = vec[1];
-			q3 = vec[2];
 		}
 
+		// Rotation matrix to quaternion, reads only the upper 3x3 so it accepts mat3, affine 3x4 and mat4.
 		constexpr explicit Quaternion(const lmi::Matrix<4, 4, T> &m)
+			: Quaternion(fromRotationMatrix(m))
+		{
+		}
+
+		constexpr explicit Quaternion(const lmi::Matrix<4, 3, T> &m)
+			: Quaternion(fromRotationMatrix(m))
+		{
+		}
+
+		constexpr explicit Quaternion(const lmi::Matrix<3, 3, T> &m)
+			: Quaternion(fromRotationMatrix(m))
 		{
-			q0 = m[0][0];
-			q1 = m[1][0];
-			q2 = m[2][0];
-			q3 = m[3][0];
 		}
 
 		constexpr Quaternion(T a, T b, T c, T d)
@@ -145,12 +157,17 @@ namespace lmi
 
 		constexpr explicit operator Matrix<4, 4, T>() const
 		{
-			// clang-format off
-			return {1 -  2 * q2 * q2 - 2 * q3 * q3, 2 * q1 * q2 - 2 * q0 * q3,     2 * q1 * q3 + 2 * q0 * q2,     0,
-					2 * q1 * q2 + 2 * q0 * q3,      1 - 2 * q1 * q1 - 2 * q3 * q3, 2 * q2 * q3 - 2 * q0 * q1,     0,
-					2 * q1 * q3 - 2 * q0 * q2,      2 * q1 * q3 + 2 * q0 * q1,     1 - 2 * q1 * q1 - 2 * q2 * q2, 0,
-					0,                              0,                             0,                             1};
-			// clang-format off
+			return toRotationMatrix<4, 4>();
+		}
+
+		constexpr explicit operator Matrix<4, 3, T>() const
+		{
+			return toRotationMatrix<4, 3>();
+		}
+
+		constexpr explicit operator Matrix<3, 3, T>() const
+		{
+			return toRotationMatrix<3, 3>();
 		}
 
 		//===========================================================================
@@ -166,6 +183,60 @@ namespace lmi
 		}
 
 		private:
+		template <size_t COLS, size_t ROWS>
+		constexpr Matrix<COLS, ROWS, T> toRotationMatrix() const
+		{
+			Matrix<COLS, ROWS, T> m(T{1});
+			const T xx = q1 * q1, yy = q2 * q2, zz = q3 * q3;
+			const T xy = q1 * q2, xz = q1 * q3, yz = q2 * q3;
+			const T wx = q0 * q1, wy = q0 * q2, wz = q0 * q3;
+
+			m[0][0] = 1 - 2 * (yy + zz);
+			m[0][1] = 2 * (xy + wz);
+			m[0][2] = 2 * (xz - wy);
+			m[1][0] = 2 * (xy - wz);
+			m[1][1] = 1 - 2 * (xx + zz);
+			m[1][2] = 2 * (yz + wx);
+			m[2][0] = 2 * (xz + wy);
+			m[2][1] = 2 * (yz - wx);
+			m[2][2] = 1 - 2 * (xx + yy);
+			return m;
+		}
+
+		// Shepperd's method: solve for the component with the largest magnitude first so the division never
+		// happens by a tiny number. The case is picked with selects instead of branches, which keeps batch
+		// conversion loops vectorizable.
+		template <size_t COLS, size_t ROWS>
+		static constexpr Quaternion fromRotationMatrix(const Matrix<COLS, ROWS, T> &m)
+		{
+			static_assert(COLS >= 3 && ROWS >= 3, "A rotation matrix needs at least 3 rows and columns");
+
+			const T tw = 1 + m[0][0] + m[1][1] + m[2][2];
+			const T tx = 1 + m[0][0] - m[1][1] - m[2][2];
+			const T ty = 1 - m[0][0] + m[1][1] - m[2][2];
+			const T tz = 1 - m[0][0] - m[1][1] + m[2][2];
+
+			const T a = m[1][2] - m[2][1];
+			const T b = m[2][0] - m[0][2];
+			const T c = m[0][1] - m[1][0];
+			const T d = m[0][1] + m[1][0];
+			const T e = m[2][0] + m[0][2];
+			const T f = m[1][2] + m[2][1];
+
+			const bool useW = tw >= tx && tw >= ty && tw >= tz;
+			const bool useX = !useW && tx >= ty && tx >= tz;
+			const bool useY = !useW && !useX && ty >= tz;
+
+			const T t = useW ? tw : useX ? tx : useY ? ty : tz;
+			const T s = T{1} / (T{2} * lmi::sqrt(t));
+
+			const T w = useW ? t : useX ? a : useY ? b : c;
+			const T x = useW ? a : useX ? t : useY ? d : e;
+			const T y = useW ? b : useX ? d : useY ? t : f;
+			const T z = useW ? c : useX ? e : useY ? f : t;
+			return Quaternion(w * s, x * s, y * s, z * s);
+		}
+
 		T q0, q1, q2, q3;
 	};
 
@@ -236,7 +307,7 @@ namespace lmi
 	template <typename T>
 	constexpr T norm(const Quaternion<T> &q)
 	{
-		return sqrt(normsq(q));
+		return lmi::sqrt(normsq(q));
 	}
 
 	template <typename T>
@@ -287,9 +358,9 @@ namespace lmi
 	// Dot and cross product
 
 	template <typename T>
-	constexpr T dot(const Quaternion<T> &a, Quaternion<T> b)
+	constexpr T dot(const Quaternion<T> &a, const Quaternion<T> &b)
 	{
-		return Quaternion<T>(a[0] * b[0], a[1] * b[1], a[2] * b[2], a[3] * b[3]);
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
 	}
 
 	template <typename T>
@@ -303,6 +374,10 @@ namespace lmi
 	template <typename T>
 	constexpr Quaternion<T> exp(const Quaternion<T> &q)
 	{
+		using std::cos;
+		using std::exp;
+		using std::sin;
+		using std::sqrt;
 		T vn = sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
 
 		return exp(q[0]) * (Quaternion<T>(cos(vn)) + imaginaryPart(q) * sin(vn) / vn);
@@ -311,6 +386,8 @@ namespace lmi
 	template <typename T>
 	constexpr Quaternion<T> log(const Quaternion<T> &q)
 	{
+		using std::acos;
+		using std::log;
 		T nq = norm(q);
 		Quaternion<T> v = imaginaryPart(q);
 		T nv = norm(v);
@@ -333,10 +410,13 @@ namespace lmi
 	template <typename T>
 	constexpr Quaternion<T> pow(const Quaternion<T> &q, T exponent)
 	{
+		using std::acos;
+		using std::cos;
+		using std::pow;
+		using std::sin;
 		T nq = norm(q);
-		T phi = std::acos(realPart(q) / nq);
-		return std::pow(nq, exponent) *
-			   (Quaternion<T>(std::cos(exponent * phi)) + normalize(q) * std::sin(exponent * phi));
+		T phi = acos(realPart(q) / nq);
+		return pow(nq, exponent) * (Quaternion<T>(cos(exponent * phi)) + normalize(q) * sin(exponent * phi));
 	}
 
 	// ==================== General functions ====================
@@ -366,7 +446,7 @@ namespace lmi
 	template <typename T>
 	constexpr Quaternion<T> createRotationQuaternion(Vector<3, T> axis, T angle)
 	{
-		return Quaternion<T>(cos(angle / 2), axis * sin(angle / 2));
+		return Quaternion<T>(lmi::cos(angle / 2), axis * lmi::sin(angle / 2));
 	}
 
 	template <typename T>
@@ -389,10 +469,24 @@ namespace lmi
 		return t0 * (1 - t) + t1 * t;
 	}
 
+	// Takes the shortest arc and falls back to a normalized lerp when the quaternions are almost parallel, where
+	// sin(theta) would be too small to divide by.
 	template <typename T>
 	constexpr Quaternion<T> slerp(Quaternion<T> t0, Quaternion<T> t1, T t)
 	{
-		return pow(t1 * inverse(t0), t) * t0;
+		T cosTheta = dot(t0, t1);
+		if(cosTheta < 0)
+		{
+			t1 = -t1;
+			cosTheta = -cosTheta;
+		}
+		if(cosTheta > T(0.9995))
+			return normalize(lerp(t0, t1, t));
+
+		using std::acos;
+		using std::sin;
+		const T theta = acos(cosTheta);
+		return (t0 * sin((1 - t) * theta) + t1 * sin(t * theta)) / sin(theta);
 	}
 
 	// Typedefs
@@ -9,6 +9,7 @@
 #include <ostream>
 #include <tuple>
 
+#include "constexpr_math.h"
 #include "defines.h"
 #include "vector/vector_base.h"
 
@@ -216,6 +217,7 @@ namespace lmi
 	template <typename V>
 	constexpr V abs(const V &x)
 	{
+		using std::abs;
 		V res{};
 		for(size_t i = 0; i < V::length(); ++i)
 		{
@@ -256,7 +258,7 @@ namespace lmi
 	template <size_t DIM, typename T>
 	constexpr T angle(const Vector<DIM, T> &x, const Vector<DIM, T> &y)
 	{
-		return 1.0 / std::cos(dot(x, y) / (length(x) * length(y)));
+		return acos(dot(x, y) / (length(x) * length(y)));
 	}
 
 	template <size_t DIM, typename T>
@@ -42,7 +42,7 @@ namespace lmi
 	template <typename T>
 	inline std::ostream &operator<<(std::ostream &os, const Quaternion<T> &rhs)
 	{
-		os << rhs.q0 << " + " << rhs.q1 << "i + " << rhs.q2 << "j + " << rhs.q3 << "k";
+		os << rhs[0] << " + " << rhs[1] << "i + " << rhs[2] << "j + " << rhs[3] << "k";
 		return os;
 	}
 }
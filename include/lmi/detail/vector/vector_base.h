@@ -23,8 +23,15 @@ namespace lmi
 			return simd_alignment ? roundToNextPower(v) : 1;
 		}
 
+		// Only arithmetic vectors are padded for SIMD, other scalar types (e.g. Dual) keep their natural alignment.
+		template <typename T>
+		constexpr size_t vectorAlignment(size_t v)
+		{
+			return std::is_arithmetic<T>::value ? alignIfSIMD(v) * sizeof(T) : alignof(T);
+		}
+
 		template <size_t DIM, typename T>
-		struct alignas(alignIfSIMD(DIM) * sizeof(T)) VectorBase
+		struct alignas(vectorAlignment<T>(DIM)) VectorBase
 		{
 			union {
 				T vals[roundToNextPower(DIM)];
@@ -37,7 +44,7 @@ namespace lmi
 		};
 
 		template <typename T>
-		struct alignas(alignIfSIMD(2) * sizeof(T)) VectorBase<2, T>
+		struct alignas(vectorAlignment<T>(2)) VectorBase<2, T>
 		{
 			union {
 				T vals[2];
@@ -62,7 +69,7 @@ namespace lmi
 		};
 
 		template <typename T>
-		struct alignas(alignIfSIMD(3) * sizeof(T)) VectorBase<3, T>
+		struct alignas(vectorAlignment<T>(3)) VectorBase<3, T>
 		{
 			union {
 				T vals[3] {};
@@ -83,7 +90,7 @@ namespace lmi
 		};
 
 		template <typename T>
-		struct alignas(alignIfSIMD(4) * sizeof(T)) VectorBase<4, T>
+		struct alignas(vectorAlignment<T>(4)) VectorBase<4, T>
 		{
 			union {
 				T vals[4] {};
@@ -0,0 +1,155 @@
+#ifndef LMI_ANIMATION_H
+#define LMI_ANIMATION_H
+
+#include <algorithm>
+
+#include "../detail/parallel.h"
+#include "../detail/quaternion.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// A keyframe track is a non-owning view of `count` keys sorted by ascending time. Vector keys are interpolated
+	// linearly, Quaternion keys with slerp. Sampling outside the key range clamps to the first or last key.
+	template <typename Value, typename T = float>
+	struct Track
+	{
+		const T *times;
+		const Value *values;
+		size_t count;
+	};
+
+	// Remembers the key interval of the last sample, one per track and playing instance. Moving forward or a little
+	// backward from there is O(1); only jumps fall back to a binary search.
+	struct TrackCursor
+	{
+		size_t key = 0;
+	};
+
+	namespace detail
+	{
+		template <typename Value>
+		struct KeyTraits;
+
+		template <size_t DIM, typename T>
+		struct KeyTraits<Vector<DIM, T>>
+		{
+			static constexpr size_t components = DIM;
+
+			static Vector<DIM, T> interpolate(const Vector<DIM, T> &a, const Vector<DIM, T> &b, T t)
+			{
+				return a + (b - a) * t;
+			}
+		};
+
+		template <typename T>
+		struct KeyTraits<Quaternion<T>>
+		{
+			static constexpr size_t components = 4;
+
+			static Quaternion<T> interpolate(const Quaternion<T> &a, const Quaternion<T> &b, T t)
+			{
+				return slerp(a, b, t);
+			}
+		};
+
+		// Returns the index k of the interval [times[k], times[k + 1]) containing `time` and updates the cursor.
+		template <typename Value, typename T>
+		size_t seek(const Track<Value, T> &track, T time, TrackCursor &cursor)
+		{
+			const size_t last = track.count - 1;
+			size_t k = std::min(cursor.key, last);
+
+			if(track.times[k] <= time)
+			{
+				// Sequential playback only ever steps over one or two keys per sample.
+				for(size_t steps = 0; steps < 2 && k < last && track.times[k + 1] <= time; ++steps)
+					++k;
+				if(k < last && track.times[k + 1] <= time)
+					k = size_t(std::upper_bound(track.times + k, track.times + track.count, time) - track.times) - 1;
+			}
+			else if(k > 0 && track.times[k - 1] <= time)
+			{
+				--k;
+			}
+			else
+			{
+				const T *it = std::upper_bound(track.times, track.times + k, time);
+				k = it == track.times ? 0 : size_t(it - track.times) - 1;
+			}
+
+			cursor.key = k;
+			return k;
+		}
+
+		template <typename Value, typename T>
+		Value sampleAt(const Track<Value, T> &track, T time, size_t k)
+		{
+			if(k + 1 >= track.count || time <= track.times[k])
+				return track.values[k];
+
+			const T t = (time - track.times[k]) / (track.times[k + 1] - track.times[k]);
+			return KeyTraits<Value>::interpolate(track.values[k], track.values[k + 1], std::min(t, T{1}));
+		}
+	}
+
+	template <typename Value, typename T>
+	Value sample(const Track<Value, T> &track, T time, TrackCursor &cursor)
+	{
+		assert(track.count > 0 && "Cannot sample an empty track");
+		return detail::sampleAt(track, time, detail::seek(track, time, cursor));
+	}
+
+	template <typename Value, typename T>
+	Value sample(const Track<Value, T> &track, T time)
+	{
+		TrackCursor cursor;
+		return sample(track, time, cursor);
+	}
+
+	// Samples `count` tracks, each with its own cursor, at the same time value.
+	template <typename Value, typename T>
+	void sample(const Track<Value, T> *tracks,
+				TrackCursor *cursors,
+				size_t count,
+				T time,
+				Value *out,
+				size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [=](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+				out[i] = sample(tracks[i], time, cursors[i]);
+		});
+	}
+
+	// Same as above, but writes structure of arrays output: component c of track i goes to components[c][i].
+	// Cursors are advanced in a first pass, so the interpolation pass runs over blocks of tracks without searching.
+	template <typename Value, typename T>
+	void sample(const Track<Value, T> *tracks,
+				TrackCursor *cursors,
+				size_t count,
+				T time,
+				T *const *components,
+				size_t threads = 1)
+	{
+		const size_t blockSize = 64;
+		detail::parallelFor(count, threads, [=](size_t begin, size_t end) {
+			size_t keys[blockSize];
+			for(size_t block = begin; block < end; block += blockSize)
+			{
+				const size_t n = std::min(blockSize, end - block);
+				for(size_t i = 0; i < n; ++i)
+					keys[i] = detail::seek(tracks[block + i], time, cursors[block + i]);
+
+				for(size_t i = 0; i < n; ++i)
+				{
+					const Value v = detail::sampleAt(tracks[block + i], time, keys[i]);
+					for(size_t c = 0; c < detail::KeyTraits<Value>::components; ++c)
+						components[c][block + i] = v[c];
+				}
+			}
+		});
+	}
+}
+
+#endif
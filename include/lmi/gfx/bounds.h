@@ -0,0 +1,440 @@
+#ifndef LMI_BOUNDS_H
+#define LMI_BOUNDS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../algorithm/decomposition.h"
+#include "../detail/aligned_allocator.h"
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Bounding volumes fitted to point sets. Every fit is a reduction with a mergeable partial result: the functions
+	// below split their input into one chunk per thread and merge the per chunk results in a fixed order, and the
+	// same merge() lets callers fit data that arrives in pieces, e.g. box.merge(fitAabb(chunk, n)). Results of
+	// floating point sums depend on the chunking by a few ulp.
+
+	template <typename T = float>
+	struct Aabb
+	{
+		Vector<3, T> min = Vector<3, T>(std::numeric_limits<T>::infinity());
+		Vector<3, T> max = Vector<3, T>(-std::numeric_limits<T>::infinity());
+
+		bool empty() const
+		{
+			return !(min[0] <= max[0]);
+		}
+
+		void merge(const Vector<3, T> &p)
+		{
+			for(size_t a = 0; a < 3; ++a)
+			{
+				min[a] = std::min(min[a], p[a]);
+				max[a] = std::max(max[a], p[a]);
+			}
+		}
+
+		void merge(const Aabb &other)
+		{
+			for(size_t a = 0; a < 3; ++a)
+			{
+				min[a] = std::min(min[a], other.min[a]);
+				max[a] = std::max(max[a], other.max[a]);
+			}
+		}
+	};
+
+	// An empty sphere has a negative radius.
+	template <typename T = float>
+	struct Sphere
+	{
+		Vector<3, T> center;
+		T radius = T{-1};
+
+		bool empty() const
+		{
+			return radius < T{0};
+		}
+
+		// Ritter's update: the smallest sphere containing this sphere and p.
+		void merge(const Vector<3, T> &p)
+		{
+			const Vector<3, T> d = p - center;
+			const T d2 = dot(d, d);
+			if(empty())
+			{
+				center = p;
+				radius = T{0};
+			}
+			else if(d2 > radius * radius)
+			{
+				const T distance = std::sqrt(d2);
+				const T newRadius = (radius + distance) / 2;
+				center += d * ((newRadius - radius) / distance);
+				radius = newRadius;
+			}
+		}
+
+		// The smallest sphere containing both spheres.
+		void merge(const Sphere &other)
+		{
+			if(other.empty())
+				return;
+			const Vector<3, T> d = other.center - center;
+			const T distance = length(d);
+			if(empty() || distance + radius <= other.radius)
+				*this = other;
+			else if(distance + other.radius > radius)
+			{
+				const T newRadius = (distance + radius + other.radius) / 2;
+				center += d * ((newRadius - radius) / distance);
+				radius = newRadius;
+			}
+		}
+	};
+
+	// Box with center, orthonormal axes (the columns of a right handed rotation) and half extents along them.
+	template <typename T = float>
+	struct Obb
+	{
+		Vector<3, T> center;
+		Matrix<3, 3, T> axes = Matrix<3, 3, T>(T{1});
+		Vector<3, T> halfExtents;
+	};
+
+	// Point count, mean and sum of outer products of the deviations from the mean. Partials are combined with the
+	// pairwise update of Chan et al., which stays accurate when the points are far from the origin.
+	template <typename T = float>
+	struct Covariance
+	{
+		size_t count = 0;
+		Vector<3, T> mean;
+		Matrix<3, 3, T> scatter = Matrix<3, 3, T>(T{0});
+
+		void merge(const Covariance &other)
+		{
+			if(other.count == 0)
+				return;
+			if(count == 0)
+			{
+				*this = other;
+				return;
+			}
+			const T n = T(count), m = T(other.count), total = n + m;
+			const Vector<3, T> delta = other.mean - mean;
+			for(size_t c = 0; c < 3; ++c)
+				for(size_t r = 0; r < 3; ++r)
+					scatter[c][r] += other.scatter[c][r] + delta[c] * delta[r] * (n * m / total);
+			mean += delta * (m / total);
+			count += other.count;
+		}
+
+		Matrix<3, 3, T> matrix() const
+		{
+			return count != 0 ? scatter / T(count) : scatter;
+		}
+	};
+
+	namespace detail
+	{
+		// Reductions run over lanes of this many points, so the inner loops are plain elementwise operations the
+		// compiler vectorizes without reassociating floating point math.
+		constexpr size_t boundsLanes = 8;
+
+		template <typename T, typename Function>
+		Aabb<T> reduceAabb(size_t count, size_t threads, Function &&point)
+		{
+			threads = resolveThreadCount(threads);
+			AlignedVector<Aabb<T>> partial(std::max(chunkCount(count, threads), size_t{1}));
+			parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+				const size_t L = boundsLanes;
+				T lo[3][L], hi[3][L];
+				for(size_t a = 0; a < 3; ++a)
+					for(size_t l = 0; l < L; ++l)
+					{
+						lo[a][l] = std::numeric_limits<T>::infinity();
+						hi[a][l] = -std::numeric_limits<T>::infinity();
+					}
+				size_t i = begin;
+				for(; i + L <= end; i += L)
+					for(size_t a = 0; a < 3; ++a)
+						for(size_t l = 0; l < L; ++l)
+						{
+							const T v = point(i + l, a);
+							lo[a][l] = std::min(lo[a][l], v);
+							hi[a][l] = std::max(hi[a][l], v);
+						}
+				Aabb<T> box;
+				for(; i < end; ++i)
+					for(size_t a = 0; a < 3; ++a)
+					{
+						box.min[a] = std::min(box.min[a], point(i, a));
+						box.max[a] = std::max(box.max[a], point(i, a));
+					}
+				for(size_t a = 0; a < 3; ++a)
+					for(size_t l = 0; l < L; ++l)
+					{
+						box.min[a] = std::min(box.min[a], lo[a][l]);
+						box.max[a] = std::max(box.max[a], hi[a][l]);
+					}
+				partial[chunk] = box;
+			});
+			Aabb<T> res;
+			for(const auto &box : partial)
+				res.merge(box);
+			return res;
+		}
+
+		// Sphere through a and b as a diameter.
+		template <typename T>
+		Sphere<T> sphereFrom(const Vector<3, T> &a, const Vector<3, T> &b)
+		{
+			return {(a + b) / T{2}, length(b - a) / T{2}};
+		}
+
+		// Smallest sphere with a, b and c on its surface: the circumcircle of the triangle. Collinear points fall back
+		// to the sphere over the two farthest apart.
+		template <typename T>
+		Sphere<T> sphereFrom(const Vector<3, T> &a, const Vector<3, T> &b, const Vector<3, T> &c)
+		{
+			const Vector<3, T> ab = b - a, ac = c - a, n = cross(ab, ac);
+			const T n2 = dot(n, n);
+			if(n2 <= std::numeric_limits<T>::epsilon() * dot(ab, ab) * dot(ac, ac))
+			{
+				Sphere<T> s = sphereFrom(a, b);
+				s.merge(sphereFrom(a, c));
+				s.merge(sphereFrom(b, c));
+				return s;
+			}
+			const Vector<3, T> offset = (cross(n, ab) * dot(ac, ac) + cross(ac, n) * dot(ab, ab)) / (2 * n2);
+			return {a + offset, length(offset)};
+		}
+
+		// Sphere through four points. Coplanar points fall back to the smallest of the spheres over three of them
+		// that contains the fourth.
+		template <typename T>
+		Sphere<T> sphereFrom(const Vector<3, T> &a, const Vector<3, T> &b, const Vector<3, T> &c, const Vector<3, T> &d)
+		{
+			const Vector<3, T> ab = b - a, ac = c - a, ad = d - a;
+			const T det = dot(ab, cross(ac, ad));
+			const T scale = length(ab) * length(ac) * length(ad);
+			if(std::abs(det) <= std::numeric_limits<T>::epsilon() * scale)
+			{
+				const Vector<3, T> p[4] = {a, b, c, d};
+				Sphere<T> best;
+				for(size_t skip = 0; skip < 4; ++skip)
+				{
+					const Vector<3, T> &x = p[skip == 0 ? 1 : 0], &y = p[skip <= 1 ? 2 : 1], &z = p[skip <= 2 ? 3 : 2];
+					const Sphere<T> s = sphereFrom(x, y, z);
+					const T slack = s.radius * (1 + 16 * std::numeric_limits<T>::epsilon());
+					if(length(p[skip] - s.center) <= slack && (best.empty() || s.radius < best.radius))
+						best = s;
+				}
+				if(best.empty())
+				{
+					best = sphereFrom(a, b, c);
+					best.merge(d);
+				}
+				return best;
+			}
+			const Vector<3, T> offset =
+				(cross(ac, ad) * dot(ab, ab) + cross(ad, ab) * dot(ac, ac) + cross(ab, ac) * dot(ad, ad)) / (2 * det);
+			return {a + offset, length(offset)};
+		}
+
+		template <typename T>
+		bool outside(const Sphere<T> &s, const Vector<3, T> &p)
+		{
+			const Vector<3, T> d = p - s.center;
+			const T slack = s.radius * (1 + 16 * std::numeric_limits<T>::epsilon());
+			return dot(d, d) > slack * slack;
+		}
+	}
+
+	// ==================== Axis aligned boxes ====================
+
+	template <typename T>
+	Aabb<T> fitAabb(const Vector<3, T> *points, size_t count, size_t threads = 1)
+	{
+		return detail::reduceAabb<T>(count, threads, [points](size_t i, size_t a) { return points[i][a]; });
+	}
+
+	// Bounds of the points in the frame given by the columns of axes, i.e. of transpose(axes) * p.
+	template <typename T>
+	Aabb<T> fitAabb(const Vector<3, T> *points, size_t count, const Matrix<3, 3, T> &axes, size_t threads = 1)
+	{
+		return detail::reduceAabb<T>(count, threads, [&](size_t i, size_t a) { return dot(axes[a], points[i]); });
+	}
+
+	// ==================== Oriented boxes ====================
+
+	template <typename T>
+	Covariance<T> fitCovariance(const Vector<3, T> *points, size_t count, size_t threads = 1)
+	{
+		threads = detail::resolveThreadCount(threads);
+		detail::AlignedVector<Covariance<T>> partial(std::max(detail::chunkCount(count, threads), size_t{1}));
+		detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+			// Two passes over the chunk: mean first, then the deviations.
+			Covariance<T> c;
+			c.count = end - begin;
+			for(size_t i = begin; i < end; ++i)
+				c.mean += points[i];
+			c.mean /= T(c.count);
+			T xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+			for(size_t i = begin; i < end; ++i)
+			{
+				const Vector<3, T> d = points[i] - c.mean;
+				xx += d[0] * d[0], xy += d[0] * d[1], xz += d[0] * d[2];
+				yy += d[1] * d[1], yz += d[1] * d[2], zz += d[2] * d[2];
+			}
+			// clang-format off
+			c.scatter = Matrix<3, 3, T>
+			(
+				xx, xy, xz,
+				xy, yy, yz,
+				xz, yz, zz
+			);
+			// clang-format on
+			partial[chunk] = c;
+		});
+		Covariance<T> res;
+		for(const auto &c : partial)
+			res.merge(c);
+		return res;
+	}
+
+	// Eigenvectors of the covariance as the columns of a right handed rotation, sorted by decreasing variance.
+	template <typename T>
+	Matrix<3, 3, T> principalAxes(const Covariance<T> &covariance)
+	{
+		Matrix<3, 3, T> vectors;
+		Vector<3, T> values;
+		algorithm::symmetricEigen(covariance.matrix(), vectors, values);
+
+		size_t order[3] = {0, 1, 2};
+		std::sort(order, order + 3, [&](size_t a, size_t b) { return values[a] > values[b]; });
+		Matrix<3, 3, T> axes;
+		axes[0] = vectors[order[0]];
+		axes[1] = vectors[order[1]];
+		axes[2] = cross(axes[0], axes[1]);
+		return axes;
+	}
+
+	// Box with the given axes around bounds computed in their frame by fitAabb(points, count, axes).
+	template <typename T>
+	Obb<T> makeObb(const Matrix<3, 3, T> &axes, const Aabb<T> &local)
+	{
+		const Vector<3, T> c = (local.min + local.max) / T{2};
+		return {axes * c, axes, (local.max - local.min) / T{2}};
+	}
+
+	// PCA box: the axes are the principal axes of the points. Not the minimal box, but close to it for elongated
+	// shapes, and two linear passes only.
+	template <typename T>
+	Obb<T> fitObb(const Vector<3, T> *points, size_t count, size_t threads = 1)
+	{
+		const Matrix<3, 3, T> axes = principalAxes(fitCovariance(points, count, threads));
+		return makeObb(axes, fitAabb(points, count, axes, threads));
+	}
+
+	// ==================== Spheres ====================
+
+	// Ritter's sphere per chunk, the chunk spheres merged and finally shrunk to the farthest point from the merged
+	// center. Usually within a few percent of the minimal sphere.
+	template <typename T>
+	Sphere<T> fitSphere(const Vector<3, T> *points, size_t count, size_t threads = 1)
+	{
+		threads = detail::resolveThreadCount(threads);
+		detail::AlignedVector<Sphere<T>> partial(std::max(detail::chunkCount(count, threads), size_t{1}));
+		detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+			// Initial diameter: the farthest apart pair among the extreme points along the coordinate axes.
+			size_t lo[3] = {begin, begin, begin}, hi[3] = {begin, begin, begin};
+			for(size_t i = begin; i < end; ++i)
+				for(size_t a = 0; a < 3; ++a)
+				{
+					lo[a] = points[i][a] < points[lo[a]][a] ? i : lo[a];
+					hi[a] = points[i][a] > points[hi[a]][a] ? i : hi[a];
+				}
+			size_t axis = 0;
+			T widest = T{-1};
+			for(size_t a = 0; a < 3; ++a)
+			{
+				const Vector<3, T> d = points[hi[a]] - points[lo[a]];
+				if(dot(d, d) > widest)
+				{
+					widest = dot(d, d);
+					axis = a;
+				}
+			}
+
+			Sphere<T> s = detail::sphereFrom(points[lo[axis]], points[hi[axis]]);
+			for(size_t i = begin; i < end; ++i)
+				s.merge(points[i]);
+			partial[chunk] = s;
+		});
+		Sphere<T> res;
+		for(const auto &s : partial)
+			res.merge(s);
+		if(res.empty())
+			return res;
+
+		std::vector<T> farthest(partial.size(), T{0});
+		detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+			T d2 = 0;
+			for(size_t i = begin; i < end; ++i)
+			{
+				const Vector<3, T> d = points[i] - res.center;
+				d2 = std::max(d2, dot(d, d));
+			}
+			farthest[chunk] = d2;
+		});
+		res.radius = std::sqrt(*std::max_element(farthest.begin(), farthest.end()));
+		return res;
+	}
+
+	// Minimal bounding sphere with Welzl's algorithm, in its iterative randomized incremental form: expected linear
+	// time on the shuffled copy of the points it works on. Serial.
+	template <typename T>
+	Sphere<T> minimalSphere(const Vector<3, T> *points, size_t count)
+	{
+		detail::AlignedVector<Vector<3, T>> p(points, points + count);
+		uint32_t seed = 0x9e3779b9u;
+		for(size_t i = count; i > 1; --i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			std::swap(p[i - 1], p[size_t(seed >> 8) % i]);
+		}
+
+		Sphere<T> s;
+		for(size_t i = 0; i < count; ++i)
+		{
+			if(!s.empty() && !detail::outside(s, p[i]))
+				continue;
+			s = {p[i], T{0}};
+			for(size_t j = 0; j < i; ++j)
+			{
+				if(!detail::outside(s, p[j]))
+					continue;
+				s = detail::sphereFrom(p[i], p[j]);
+				for(size_t k = 0; k < j; ++k)
+				{
+					if(!detail::outside(s, p[k]))
+						continue;
+					s = detail::sphereFrom(p[i], p[j], p[k]);
+					for(size_t l = 0; l < k; ++l)
+						if(detail::outside(s, p[l]))
+							s = detail::sphereFrom(p[i], p[j], p[k], p[l]);
+				}
+			}
+		}
+		return s;
+	}
+}
+
+#endif
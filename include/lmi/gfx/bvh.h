@@ -0,0 +1,886 @@
+#ifndef LMI_BVH_H
+#define LMI_BVH_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "ray.h"
+
+namespace lmi
+{
+	// Closest hit of a ray: distance along the ray, barycentric coordinates of the hit inside the triangle and the
+	// index of the triangle, or none for a miss.
+	template <typename T = float>
+	struct RayHit
+	{
+		static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+		T t = std::numeric_limits<T>::infinity();
+		T u = T{0}, v = T{0};
+		uint32_t primitive = none;
+	};
+
+	template <typename T>
+	constexpr uint32_t RayHit<T>::none;
+
+	// Bounding volume hierarchy over axis aligned boxes with WIDTH children per node. The tree is built with the
+	// binned surface area heuristic as a binary tree and then collapsed, the bounds of the children of a node are
+	// stored as structure of arrays so one ray is tested against all of them in a single vectorized loop.
+	//
+	// Leaves reference a range of primitives(), which holds the original primitive indices in leaf order.
+	template <typename T = float, size_t WIDTH = 4>
+	class Bvh
+	{
+		static_assert(WIDTH >= 2 && WIDTH <= 16, "Nodes need between 2 and 16 children");
+
+		static constexpr size_t bins = 16;
+		static constexpr size_t maxDepth = 64;	// Deeper nodes fall back to median splits.
+		static constexpr size_t minParallelRange = 1 << 15;
+
+		public:
+		static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+		static constexpr size_t maxLeafSize = 8;
+
+		// Empty child slots have inverted bounds and child == none, so they never pass the slab test.
+		struct Node
+		{
+			T minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+			T maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+			uint32_t child[WIDTH];	// Inner child: node index. Leaf child: first entry in primitives().
+			uint32_t count[WIDTH];	// Number of primitives for a leaf, 0 for an inner child.
+		};
+
+		Bvh() = default;
+
+		// Builds over count boxes. With threads != 1 the bounds, the binning of the large top level nodes and the
+		// independent subtrees below them are processed in parallel; the resulting tree does not depend on the
+		// thread count.
+		Bvh(const Vector<3, T> *boxMin, const Vector<3, T> *boxMax, size_t count, size_t threads = 1)
+		{
+			build(boxMin, boxMax, count, threads);
+		}
+
+		const std::vector<Node> &nodes() const
+		{
+			return nodeStorage;
+		}
+
+		const std::vector<uint32_t> &primitives() const
+		{
+			return primitiveOrder;
+		}
+
+		bool empty() const
+		{
+			return nodeStorage.empty();
+		}
+
+		// Front to back closest hit traversal. For every leaf that may contain a closer hit, leaf(first, count, tMax)
+		// is called with a range of primitives() and has to return true and lower tMax if it found a closer hit.
+		template <typename Leaf>
+		bool traverse(const Ray<T> &ray, T tMin, T &tMax, Leaf &&leaf) const
+		{
+			if(empty())
+				return false;
+
+			const SlabRay r(ray);
+			StackEntry stack[stackSize];
+			size_t top = 0;
+			stack[top++] = {0, 0, tMin};
+
+			bool hit = false;
+			while(top != 0)
+			{
+				const StackEntry e = stack[--top];
+				if(e.tNear > tMax)
+					continue;
+				if(e.count != 0)
+				{
+					hit |= leaf(size_t{e.node}, size_t{e.count}, tMax);
+					continue;
+				}
+
+				const Node &node = nodeStorage[e.node];
+				T tNear[WIDTH];
+				const unsigned mask = slabTest(node, r, tMin, tMax, tNear);
+
+				// Push the hit children far to near so the nearest one is popped first.
+				StackEntry children[WIDTH];
+				size_t n = 0;
+				for(size_t i = 0; i < WIDTH; ++i)
+				{
+					if(!(mask & (1u << i)))
+						continue;
+					StackEntry c = {node.child[i], node.count[i], tNear[i]};
+					size_t j = n++;
+					for(; j > 0 && children[j - 1].tNear < c.tNear; --j)
+						children[j] = children[j - 1];
+					children[j] = c;
+				}
+				for(size_t i = 0; i < n; ++i)
+					stack[top++] = children[i];
+			}
+			return hit;
+		}
+
+		// Closest hit against the primitives themselves: intersect(primitive, ray, tMin, tMax) returns true and lowers
+		// tMax on a hit. Returns the hit primitive or none.
+		template <typename Intersect>
+		uint32_t intersect(const Ray<T> &ray, T tMin, T &tMax, Intersect &&intersect) const
+		{
+			uint32_t closest = none;
+			traverse(ray, tMin, tMax, [&](size_t first, size_t count, T &t) {
+				bool hit = false;
+				for(size_t i = first; i < first + count; ++i)
+				{
+					if(intersect(primitiveOrder[i], ray, tMin, t))
+					{
+						closest = primitiveOrder[i];
+						hit = true;
+					}
+				}
+				return hit;
+			});
+			return closest;
+		}
+
+		// Calls f(primitive) for every primitive in a leaf whose bounds overlap the box. Leaf bounds enclose all of
+		// their primitives, so f still has to test the primitive itself.
+		template <typename Function>
+		void overlap(const Vector<3, T> &min, const Vector<3, T> &max, Function &&f) const
+		{
+			if(empty())
+				return;
+
+			uint32_t stack[stackSize];
+			size_t top = 0;
+			stack[top++] = 0;
+			while(top != 0)
+			{
+				const Node &node = nodeStorage[stack[--top]];
+				for(size_t i = 0; i < WIDTH; ++i)
+				{
+					const bool overlaps = node.minX[i] <= max[0] && node.maxX[i] >= min[0] && node.minY[i] <= max[1] &&
+										  node.maxY[i] >= min[1] && node.minZ[i] <= max[2] && node.maxZ[i] >= min[2];
+					if(!overlaps)
+						continue;
+					if(node.count[i] == 0)
+						stack[top++] = node.child[i];
+					else
+						for(uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+							f(primitiveOrder[p]);
+				}
+			}
+		}
+
+		// ==================== Traversal helpers ====================
+		// Public for custom traversals such as the ray packets of TriangleBvh.
+
+		// Ray with precomputed reciprocal direction. Per axis the near plane of a box is the min plane for a positive
+		// direction and the max plane otherwise, which leaves only two max and two min per child. A zero component
+		// gives an infinite reciprocal, and 0 * inf = NaN for an origin on one of the planes of that axis.
+		struct SlabRay
+		{
+			explicit SlabRay(const Ray<T> &ray)
+			{
+				for(size_t a = 0; a < 3; ++a)
+				{
+					origin[a] = ray.origin[a];
+					invDirection[a] = T{1} / ray.direction[a];
+					negative[a] = invDirection[a] < T{0};
+				}
+			}
+
+			T origin[3], invDirection[3];
+			bool negative[3];
+		};
+
+		static unsigned slabTest(const Node &node, const SlabRay &r, T tMin, T tMax, T (&tNear)[WIDTH])
+		{
+			const T *nearX = r.negative[0] ? node.maxX : node.minX, *farX = r.negative[0] ? node.minX : node.maxX;
+			const T *nearY = r.negative[1] ? node.maxY : node.minY, *farY = r.negative[1] ? node.minY : node.maxY;
+			const T *nearZ = r.negative[2] ? node.maxZ : node.minZ, *farZ = r.negative[2] ? node.minZ : node.maxZ;
+
+			unsigned mask = 0;
+			for(size_t i = 0; i < WIDTH; ++i)
+			{
+				const T t0x = (nearX[i] - r.origin[0]) * r.invDirection[0];
+				const T t0y = (nearY[i] - r.origin[1]) * r.invDirection[1];
+				const T t0z = (nearZ[i] - r.origin[2]) * r.invDirection[2];
+				const T t1x = (farX[i] - r.origin[0]) * r.invDirection[0];
+				const T t1y = (farY[i] - r.origin[1]) * r.invDirection[1];
+				const T t1z = (farZ[i] - r.origin[2]) * r.invDirection[2];
+				// std::max and std::min return their first argument if the second is NaN, so starting from the
+				// interval drops a NaN distance and leaves the ray unbounded along that axis.
+				const T t0 = std::max(std::max(std::max(tMin, t0x), t0y), t0z);
+				const T t1 = std::min(std::min(std::min(tMax, t1x), t1y), t1z);
+				tNear[i] = t0;
+				mask |= unsigned(t0 <= t1) << i;
+			}
+			return mask;
+		}
+
+		// Enough for the depth the builder allows, with WIDTH - 1 pending siblings per level.
+		static constexpr size_t stackSize = (maxDepth + 32) * (WIDTH - 1) + 1;
+
+		private:
+		struct StackEntry
+		{
+			uint32_t node, count;
+			T tNear;
+		};
+
+		struct Bounds
+		{
+			Vector<3, T> min = Vector<3, T>(std::numeric_limits<T>::infinity());
+			Vector<3, T> max = Vector<3, T>(-std::numeric_limits<T>::infinity());
+
+			void grow(const Vector<3, T> &lo, const Vector<3, T> &hi)
+			{
+				for(size_t a = 0; a < 3; ++a)
+				{
+					min[a] = std::min(min[a], lo[a]);
+					max[a] = std::max(max[a], hi[a]);
+				}
+			}
+
+			void grow(const Bounds &b)
+			{
+				grow(b.min, b.max);
+			}
+
+			T halfArea() const
+			{
+				const Vector<3, T> e = max - min;
+				return e[0] < T{0} ? T{0} : e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+			}
+		};
+
+		// Bounds of a range of primitives and of their centroids.
+		struct RangeBounds
+		{
+			Bounds box, centroids;
+
+			void grow(const RangeBounds &b)
+			{
+				box.grow(b.box);
+				centroids.grow(b.centroids);
+			}
+		};
+
+		struct Bin
+		{
+			Bounds box;
+			size_t count = 0;
+		};
+
+		struct BuildNode
+		{
+			Bounds box;
+			uint32_t left = none, right = none;
+			uint32_t first = 0, count = 0;
+		};
+
+		struct Task
+		{
+			uint32_t node;
+			uint32_t begin, end;
+			uint32_t depth;
+		};
+
+		void build(const Vector<3, T> *boxMin, const Vector<3, T> *boxMax, size_t count, size_t threads)
+		{
+			nodeStorage.clear();
+			primitiveOrder.resize(count);
+			if(count == 0)
+				return;
+
+			threads = detail::resolveThreadCount(threads);
+			primMin = boxMin;
+			primMax = boxMax;
+			centroids.resize(count);
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+				{
+					centroids[i] = (boxMin[i] + boxMax[i]) / T{2};
+					primitiveOrder[i] = uint32_t(i);
+				}
+			});
+
+			// Split the large top level nodes one at a time with parallel binning until there are enough
+			// independent subtrees to keep every thread busy.
+			detail::AlignedVector<BuildNode> top(1);
+			std::vector<Task> tasks = {{0, 0, uint32_t(count), 0}};
+			std::vector<Task> subtrees;
+			while(!tasks.empty())
+			{
+				auto largest = std::max_element(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+					return a.end - a.begin < b.end - b.begin;
+				});
+				if(threads == 1 || largest->end - largest->begin < minParallelRange ||
+				   tasks.size() + subtrees.size() >= 4 * threads)
+					break;
+
+				const Task task = *largest;
+				tasks.erase(largest);
+				uint32_t mid = 0;
+				if(!splitNode(top[task.node], task.begin, task.end, task.depth, threads, mid))
+					continue;
+
+				const uint32_t left = uint32_t(top.size());
+				top[task.node].left = left;
+				top[task.node].right = left + 1;
+				top.resize(top.size() + 2);
+				tasks.push_back({left, task.begin, mid, task.depth + 1});
+				tasks.push_back({left + 1, mid, task.end, task.depth + 1});
+			}
+			subtrees.insert(subtrees.end(), tasks.begin(), tasks.end());
+
+			std::vector<detail::AlignedVector<BuildNode>> built(subtrees.size());
+			detail::parallelFor(subtrees.size(), threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					buildSerial(subtrees[i], built[i]);
+			});
+
+			// Every subtree root replaces its placeholder in the top tree, the other nodes are appended.
+			for(size_t i = 0; i < subtrees.size(); ++i)
+			{
+				const uint32_t offset = uint32_t(top.size()) - 1;
+				auto remap = [&](uint32_t n) { return n == none ? none : n + offset; };
+				for(size_t n = 0; n < built[i].size(); ++n)
+				{
+					BuildNode b = built[i][n];
+					b.left = remap(b.left);
+					b.right = remap(b.right);
+					if(n == 0)
+						top[subtrees[i].node] = b;
+					else
+						top.push_back(b);
+				}
+			}
+
+			collapse(top);
+			centroids.clear();
+			centroids.shrink_to_fit();
+		}
+
+		void buildSerial(const Task &root, detail::AlignedVector<BuildNode> &nodes)
+		{
+			nodes.resize(1);
+			std::vector<Task> stack = {{0, root.begin, root.end, root.depth}};
+			while(!stack.empty())
+			{
+				const Task task = stack.back();
+				stack.pop_back();
+
+				uint32_t mid = 0;
+				BuildNode node;
+				const bool split = splitNode(node, task.begin, task.end, task.depth, 1, mid);
+				if(split)
+				{
+					node.left = uint32_t(nodes.size());
+					node.right = node.left + 1;
+					stack.push_back({node.left, task.begin, mid, task.depth + 1});
+					stack.push_back({node.right, mid, task.end, task.depth + 1});
+					nodes.resize(nodes.size() + 2);
+				}
+				nodes[task.node] = node;
+			}
+		}
+
+		RangeBounds rangeBounds(uint32_t begin, uint32_t end, size_t threads) const
+		{
+			const size_t n = end - begin;
+			detail::AlignedVector<RangeBounds> partial(n >= minParallelRange ? detail::chunkCount(n, threads) : 1);
+			detail::parallelChunks(n, n >= minParallelRange ? threads : 1, [&](size_t chunk, size_t b, size_t e) {
+				RangeBounds r;
+				for(size_t i = begin + b; i < begin + e; ++i)
+				{
+					const uint32_t p = primitiveOrder[i];
+					r.box.grow(primMin[p], primMax[p]);
+					r.centroids.grow(centroids[p], centroids[p]);
+				}
+				partial[chunk] = r;
+			});
+			RangeBounds res;
+			for(const auto &r : partial)
+				res.grow(r);
+			return res;
+		}
+
+		// Fills in the bounds of node and either makes it a leaf over [begin, end) or partitions the range at mid and
+		// returns true.
+		bool splitNode(BuildNode &node, uint32_t begin, uint32_t end, uint32_t depth, size_t threads, uint32_t &mid)
+		{
+			const uint32_t n = end - begin;
+			const RangeBounds bounds = rangeBounds(begin, end, threads);
+			node.box = bounds.box;
+			node.first = begin;
+			node.count = n;
+			if(n <= 1)
+				return false;
+
+			const Vector<3, T> cMin = bounds.centroids.min;
+			Vector<3, T> scale;
+			for(size_t a = 0; a < 3; ++a)
+			{
+				const T extent = bounds.centroids.max[a] - cMin[a];
+				scale[a] = extent > T{0} ? T(bins) / extent : T{0};
+			}
+			auto binOf = [&](uint32_t p, size_t a) {
+				return std::min(bins - 1, size_t((centroids[p][a] - cMin[a]) * scale[a]));
+			};
+
+			// Binning of all three axes, with per chunk bins for large ranges.
+			using Bins = std::array<std::array<Bin, bins>, 3>;
+			const size_t binThreads = n >= minParallelRange ? threads : 1;
+			detail::AlignedVector<Bins> partial(detail::chunkCount(n, binThreads));
+			detail::parallelChunks(n, binThreads, [&](size_t chunk, size_t b, size_t e) {
+				Bins local;
+				for(size_t i = begin + b; i < begin + e; ++i)
+				{
+					const uint32_t p = primitiveOrder[i];
+					for(size_t a = 0; a < 3; ++a)
+					{
+						Bin &bin = local[a][binOf(p, a)];
+						bin.box.grow(primMin[p], primMax[p]);
+						++bin.count;
+					}
+				}
+				partial[chunk] = local;
+			});
+			Bins merged = partial[0];
+			for(size_t c = 1; c < partial.size(); ++c)
+				for(size_t a = 0; a < 3; ++a)
+					for(size_t i = 0; i < bins; ++i)
+					{
+						merged[a][i].box.grow(partial[c][a][i].box);
+						merged[a][i].count += partial[c][a][i].count;
+					}
+
+			// Sweep: cost of splitting in front of bin i is area(left) * count(left) + area(right) * count(right).
+			T bestCost = std::numeric_limits<T>::infinity();
+			size_t bestAxis = 0, bestBin = 0;
+			for(size_t a = 0; a < 3; ++a)
+			{
+				T rightCost[bins];
+				Bounds right;
+				size_t rightCount = 0;
+				for(size_t i = bins - 1; i > 0; --i)
+				{
+					right.grow(merged[a][i].box);
+					rightCount += merged[a][i].count;
+					rightCost[i] = right.halfArea() * T(rightCount);
+				}
+				Bounds left;
+				size_t leftCount = 0;
+				for(size_t i = 1; i < bins; ++i)
+				{
+					left.grow(merged[a][i - 1].box);
+					leftCount += merged[a][i - 1].count;
+					if(leftCount == 0 || leftCount == n)
+						continue;
+					const T cost = left.halfArea() * T(leftCount) + rightCost[i];
+					if(cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = a;
+						bestBin = i;
+					}
+				}
+			}
+
+			// A traversal step costs about as much as one primitive test.
+			const T leafCost = node.box.halfArea() * T(n);
+			const bool sahSplit = bestCost < std::numeric_limits<T>::infinity();
+			if(n <= maxLeafSize && (!sahSplit || node.box.halfArea() + bestCost >= leafCost))
+				return false;
+
+			if(sahSplit && depth < maxDepth)
+			{
+				mid = uint32_t(std::partition(primitiveOrder.begin() + begin,
+											  primitiveOrder.begin() + end,
+											  [&](uint32_t p) { return binOf(p, bestAxis) < bestBin; }) -
+							   primitiveOrder.begin());
+			}
+			else
+			{
+				// All centroids coincide or the tree got too deep: median split along the widest centroid axis.
+				const Vector<3, T> extent = bounds.centroids.max - cMin;
+				const size_t axis =
+					extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+				mid = begin + n / 2;
+				std::nth_element(primitiveOrder.begin() + begin,
+								 primitiveOrder.begin() + mid,
+								 primitiveOrder.begin() + end,
+								 [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+			}
+			return true;
+		}
+
+		// Turns the binary tree into WIDTH wide nodes by repeatedly opening the inner child with the largest
+		// surface area.
+		void collapse(const detail::AlignedVector<BuildNode> &binary)
+		{
+			nodeStorage.clear();
+			nodeStorage.reserve(binary.size() / (WIDTH - 1) + 1);
+			nodeStorage.emplace_back();
+
+			struct Pending
+			{
+				uint32_t binary, wide;
+			};
+			std::vector<Pending> stack = {{0, 0}};
+			while(!stack.empty())
+			{
+				const Pending p = stack.back();
+				stack.pop_back();
+
+				uint32_t children[WIDTH];
+				size_t n = 0;
+				if(binary[p.binary].left == none)
+					children[n++] = p.binary;
+				else
+				{
+					children[n++] = binary[p.binary].left;
+					children[n++] = binary[p.binary].right;
+				}
+				while(n < WIDTH)
+				{
+					size_t open = WIDTH;
+					T largest = -T{1};
+					for(size_t i = 0; i < n; ++i)
+					{
+						const BuildNode &c = binary[children[i]];
+						if(c.left != none && c.box.halfArea() > largest)
+						{
+							largest = c.box.halfArea();
+							open = i;
+						}
+					}
+					if(open == WIDTH)
+						break;
+					const BuildNode &c = binary[children[open]];
+					children[open] = c.left;
+					children[n++] = c.right;
+				}
+
+				for(size_t i = 0; i < WIDTH; ++i)
+				{
+					Node &node = nodeStorage[p.wide];
+					if(i >= n)
+					{
+						setSlot(node, i, Bounds(), none, 0);
+						continue;
+					}
+					const BuildNode &c = binary[children[i]];
+					if(c.left == none)
+					{
+						setSlot(node, i, c.box, c.first, c.count);
+						continue;
+					}
+					const uint32_t wide = uint32_t(nodeStorage.size());
+					setSlot(node, i, c.box, wide, 0);
+					nodeStorage.emplace_back();
+					stack.push_back({children[i], wide});
+				}
+			}
+		}
+
+		static void setSlot(Node &node, size_t i, const Bounds &b, uint32_t child, uint32_t count)
+		{
+			node.minX[i] = b.min[0];
+			node.minY[i] = b.min[1];
+			node.minZ[i] = b.min[2];
+			node.maxX[i] = b.max[0];
+			node.maxY[i] = b.max[1];
+			node.maxZ[i] = b.max[2];
+			node.child[i] = child;
+			node.count[i] = count;
+		}
+
+		std::vector<Node> nodeStorage;
+		std::vector<uint32_t> primitiveOrder;
+
+		// Only valid during build().
+		const Vector<3, T> *primMin = nullptr, *primMax = nullptr;
+		detail::AlignedVector<Vector<3, T>> centroids;
+	};
+
+	template <typename T, size_t WIDTH>
+	constexpr uint32_t Bvh<T, WIDTH>::none;
+
+	template <typename T, size_t WIDTH>
+	constexpr size_t Bvh<T, WIDTH>::maxLeafSize;
+
+	template <typename T, size_t WIDTH>
+	constexpr size_t Bvh<T, WIDTH>::stackSize;
+
+	// Bvh over an indexed triangle mesh. The triangles are copied in leaf order as a vertex and two edges in
+	// structure of arrays form, which is what the Möller-Trumbore test needs and lets a leaf be tested against a
+	// ray packet with one vectorized loop per triangle.
+	template <typename T = float, size_t WIDTH = 4>
+	class TriangleBvh
+	{
+		public:
+		// Rays per packet in intersectPackets(). 8 floats fill an AVX register.
+		static constexpr size_t packetSize = 8;
+
+		TriangleBvh() = default;
+
+		// indices holds three vertex indices per triangle.
+		TriangleBvh(const Vector<3, T> *vertices, const uint32_t *indices, size_t triangleCount, size_t threads = 1)
+		{
+			detail::AlignedVector<Vector<3, T>> boxMin(triangleCount), boxMax(triangleCount);
+			detail::parallelFor(triangleCount, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+				{
+					const auto &a = vertices[indices[3 * i]], &b = vertices[indices[3 * i + 1]],
+							   &c = vertices[indices[3 * i + 2]];
+					for(size_t k = 0; k < 3; ++k)
+					{
+						boxMin[i][k] = std::min(a[k], std::min(b[k], c[k]));
+						boxMax[i][k] = std::max(a[k], std::max(b[k], c[k]));
+					}
+				}
+			});
+			tree = Bvh<T, WIDTH>(boxMin.data(), boxMax.data(), triangleCount, threads);
+
+			for(auto *v : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+				v->resize(triangleCount);
+			const auto &order = tree.primitives();
+			detail::parallelFor(triangleCount, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+				{
+					const uint32_t tri = order[i];
+					const auto &a = vertices[indices[3 * tri]], &b = vertices[indices[3 * tri + 1]],
+							   &c = vertices[indices[3 * tri + 2]];
+					v0x[i] = a[0], v0y[i] = a[1], v0z[i] = a[2];
+					e1x[i] = b[0] - a[0], e1y[i] = b[1] - a[1], e1z[i] = b[2] - a[2];
+					e2x[i] = c[0] - a[0], e2y[i] = c[1] - a[1], e2z[i] = c[2] - a[2];
+				}
+			});
+		}
+
+		const Bvh<T, WIDTH> &bvh() const
+		{
+			return tree;
+		}
+
+		// Closest hit with t in (tMin, tMax). Triangles are two sided.
+		RayHit<T> intersect(const Ray<T> &ray,
+							T tMin = T{0},
+							T tMax = std::numeric_limits<T>::infinity()) const
+		{
+			RayHit<T> hit;
+			hit.t = tMax;
+			uint32_t closest = RayHit<T>::none;
+			tree.traverse(ray, tMin, hit.t, [&](size_t first, size_t count, T &t) {
+				bool found = false;
+				for(size_t i = first; i < first + count; ++i)
+				{
+					T tHit, u, v;
+					if(triangle(i, ray, tMin, t, tHit, u, v))
+					{
+						t = tHit;
+						hit.u = u;
+						hit.v = v;
+						closest = uint32_t(i);
+						found = true;
+					}
+				}
+				return found;
+			});
+			if(closest != RayHit<T>::none)
+				hit.primitive = tree.primitives()[closest];
+			else
+				hit.t = std::numeric_limits<T>::infinity();
+			return hit;
+		}
+
+		// Any hit with t in (tMin, tMax), for shadow and visibility rays.
+		bool occluded(const Ray<T> &ray, T tMin = T{0}, T tMax = std::numeric_limits<T>::infinity()) const
+		{
+			bool found = false;
+			tree.traverse(ray, tMin, tMax, [&](size_t first, size_t count, T &t) {
+				for(size_t i = first; i < first + count && !found; ++i)
+				{
+					T tHit, u, v;
+					found = triangle(i, ray, tMin, t, tHit, u, v);
+				}
+				// Ends the traversal: nothing can be nearer than tMin.
+				if(found)
+					t = tMin - T{1};
+				return found;
+			});
+			return found;
+		}
+
+		// One closest hit per ray, every ray traversed on its own.
+		void intersect(const Ray<T> *rays, RayHit<T> *hits, size_t count, size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					hits[i] = intersect(rays[i]);
+			});
+		}
+
+		// Same results as intersect(), but consecutive groups of packetSize rays traverse the tree together: a node
+		// is visited if any ray of the packet hits it, and boxes and triangles are tested against all rays at once.
+		// Pays off for coherent rays such as camera rays of a screen tile.
+		void intersectPackets(const Ray<T> *rays, RayHit<T> *hits, size_t count, size_t threads = 1) const
+		{
+			const size_t packets = (count + packetSize - 1) / packetSize;
+			detail::parallelFor(packets, threads, [&](size_t begin, size_t end) {
+				for(size_t p = begin; p < end; ++p)
+				{
+					const size_t first = p * packetSize;
+					intersectPacket(rays + first, hits + first, std::min(packetSize, count - first));
+				}
+			});
+		}
+
+		private:
+		using Node = typename Bvh<T, WIDTH>::Node;
+
+		// Möller-Trumbore. A zero determinant turns u, v and t into NaN or infinity, which fails the tests.
+		bool triangle(size_t i, const Ray<T> &ray, T tMin, T tMax, T &t, T &u, T &v) const
+		{
+			const T dx = ray.direction[0], dy = ray.direction[1], dz = ray.direction[2];
+			const T px = dy * e2z[i] - dz * e2y[i], py = dz * e2x[i] - dx * e2z[i], pz = dx * e2y[i] - dy * e2x[i];
+			const T invDet = T{1} / (e1x[i] * px + e1y[i] * py + e1z[i] * pz);
+			const T sx = ray.origin[0] - v0x[i], sy = ray.origin[1] - v0y[i], sz = ray.origin[2] - v0z[i];
+			u = (sx * px + sy * py + sz * pz) * invDet;
+			const T qx = sy * e1z[i] - sz * e1y[i], qy = sz * e1x[i] - sx * e1z[i], qz = sx * e1y[i] - sy * e1x[i];
+			v = (dx * qx + dy * qy + dz * qz) * invDet;
+			t = (e2x[i] * qx + e2y[i] * qy + e2z[i] * qz) * invDet;
+			return u >= T{0} && v >= T{0} && u + v <= T{1} && t > tMin && t < tMax;
+		}
+
+		void intersectPacket(const Ray<T> *rays, RayHit<T> *hits, size_t n) const
+		{
+			const size_t P = packetSize;
+			T ox[P], oy[P], oz[P], dx[P], dy[P], dz[P], ix[P], iy[P], iz[P], tMax[P], u[P], v[P];
+			uint32_t closest[P];
+			for(size_t r = 0; r < P; ++r)
+			{
+				// Missing rays of a partial packet repeat the first one with an empty interval.
+				const Ray<T> &ray = rays[r < n ? r : 0];
+				ox[r] = ray.origin[0], oy[r] = ray.origin[1], oz[r] = ray.origin[2];
+				dx[r] = ray.direction[0], dy[r] = ray.direction[1], dz[r] = ray.direction[2];
+				ix[r] = T{1} / dx[r], iy[r] = T{1} / dy[r], iz[r] = T{1} / dz[r];
+				tMax[r] = r < n ? std::numeric_limits<T>::infinity() : -T{1};
+				u[r] = v[r] = T{0};
+				closest[r] = RayHit<T>::none;
+			}
+
+			const auto &nodes = tree.nodes();
+			uint32_t stack[Bvh<T, WIDTH>::stackSize][2];
+			size_t top = 0;
+			if(!nodes.empty())
+			{
+				stack[top][0] = 0;
+				stack[top++][1] = 0;
+			}
+			while(top != 0)
+			{
+				--top;
+				const uint32_t index = stack[top][0], leafCount = stack[top][1];
+				if(leafCount != 0)
+				{
+					for(uint32_t i = index; i < index + leafCount; ++i)
+						trianglePacket(i, ox, oy, oz, dx, dy, dz, tMax, u, v, closest);
+					continue;
+				}
+
+				const Node &node = nodes[index];
+				for(size_t c = 0; c < WIDTH; ++c)
+				{
+					if(node.child[c] == Bvh<T, WIDTH>::none)
+						continue;
+					unsigned any = 0;
+					for(size_t r = 0; r < P; ++r)
+					{
+						// Near and far planes by the sign of the reciprocal and NaN dropping as in slabTest.
+						const T nearX = ix[r] < T{0} ? node.maxX[c] : node.minX[c];
+						const T farX = ix[r] < T{0} ? node.minX[c] : node.maxX[c];
+						const T nearY = iy[r] < T{0} ? node.maxY[c] : node.minY[c];
+						const T farY = iy[r] < T{0} ? node.minY[c] : node.maxY[c];
+						const T nearZ = iz[r] < T{0} ? node.maxZ[c] : node.minZ[c];
+						const T farZ = iz[r] < T{0} ? node.minZ[c] : node.maxZ[c];
+						const T t0x = (nearX - ox[r]) * ix[r], t1x = (farX - ox[r]) * ix[r];
+						const T t0y = (nearY - oy[r]) * iy[r], t1y = (farY - oy[r]) * iy[r];
+						const T t0z = (nearZ - oz[r]) * iz[r], t1z = (farZ - oz[r]) * iz[r];
+						const T t0 = std::max(std::max(std::max(T{0}, t0x), t0y), t0z);
+						const T t1 = std::min(std::min(std::min(tMax[r], t1x), t1y), t1z);
+						any |= unsigned(t0 <= t1);
+					}
+					if(any)
+					{
+						stack[top][0] = node.child[c];
+						stack[top++][1] = node.count[c];
+					}
+				}
+			}
+
+			for(size_t r = 0; r < n; ++r)
+			{
+				RayHit<T> &hit = hits[r];
+				hit = RayHit<T>();
+				if(closest[r] == RayHit<T>::none)
+					continue;
+				hit.t = tMax[r];
+				hit.u = u[r];
+				hit.v = v[r];
+				hit.primitive = tree.primitives()[closest[r]];
+			}
+		}
+
+		// One triangle against all rays of a packet, branch free per ray.
+		void trianglePacket(uint32_t i,
+							const T *ox,
+							const T *oy,
+							const T *oz,
+							const T *dx,
+							const T *dy,
+							const T *dz,
+							T *tMax,
+							T *hitU,
+							T *hitV,
+							uint32_t *closest) const
+		{
+			const T ax = v0x[i], ay = v0y[i], az = v0z[i];
+			const T bx = e1x[i], by = e1y[i], bz = e1z[i];
+			const T cx = e2x[i], cy = e2y[i], cz = e2z[i];
+			for(size_t r = 0; r < packetSize; ++r)
+			{
+				const T px = dy[r] * cz - dz[r] * cy, py = dz[r] * cx - dx[r] * cz, pz = dx[r] * cy - dy[r] * cx;
+				const T invDet = T{1} / (bx * px + by * py + bz * pz);
+				const T sx = ox[r] - ax, sy = oy[r] - ay, sz = oz[r] - az;
+				const T u = (sx * px + sy * py + sz * pz) * invDet;
+				const T qx = sy * bz - sz * by, qy = sz * bx - sx * bz, qz = sx * by - sy * bx;
+				const T v = (dx[r] * qx + dy[r] * qy + dz[r] * qz) * invDet;
+				const T t = (cx * qx + cy * qy + cz * qz) * invDet;
+				const bool hit = (u >= T{0}) & (v >= T{0}) & (u + v <= T{1}) & (t > T{0}) & (t < tMax[r]);
+				tMax[r] = hit ? t : tMax[r];
+				hitU[r] = hit ? u : hitU[r];
+				hitV[r] = hit ? v : hitV[r];
+				closest[r] = hit ? i : closest[r];
+			}
+		}
+
+		Bvh<T, WIDTH> tree;
+		std::vector<T> v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+	};
+
+	template <typename T, size_t WIDTH>
+	constexpr size_t TriangleBvh<T, WIDTH>::packetSize;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef LMI_COMPRESSION_H
+#define LMI_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "../detail/quaternion.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Smallest three encoding of a unit quaternion: the index of the largest component in 2 bits followed by the
+	// other three components, each quantized to 10 bits in [-1/sqrt(2), 1/sqrt(2)]. The largest component is
+	// rebuilt from the unit length constraint; q and -q are the same rotation, so its sign is always positive.
+	struct CompressedQuat32
+	{
+		uint32_t bits;
+	};
+
+	// Same as CompressedQuat32 with 15 bits per component, stored as three 16 bit words to keep it 2 byte aligned.
+	struct CompressedQuat48
+	{
+		uint16_t bits[3];
+	};
+
+	// Vector quantized to 16 bits per component relative to a [min, max] box, e.g. the bounds of one track.
+	struct QuantizedVec3
+	{
+		uint16_t bits[3];
+	};
+
+	namespace detail
+	{
+		template <unsigned BITS, typename T>
+		uint64_t encodeSmallestThree(const Quaternion<T> &q)
+		{
+			const T maxValue = T((uint64_t{1} << BITS) - 1);
+			const T sqrt2 = T(1.4142135623730950488);
+
+			unsigned largest = 0;
+			for(unsigned i = 1; i < 4; ++i)
+			{
+				if(std::abs(q[i]) > std::abs(q[largest]))
+					largest = i;
+			}
+			const T sign = q[largest] < 0 ? T{-1} : T{1};
+
+			uint64_t res = largest;
+			for(unsigned i = 0; i < 4; ++i)
+			{
+				if(i == largest)
+					continue;
+				const T normalized = (q[i] * sign * sqrt2 + 1) / 2;
+				const T quantized = std::round(std::min(std::max(normalized, T{0}), T{1}) * maxValue);
+				res = (res << BITS) | static_cast<uint64_t>(quantized);
+			}
+			return res;
+		}
+
+		// Branch free so the batch loops below vectorize; the largest component is inserted with selects.
+		template <unsigned BITS, typename T>
+		Quaternion<T> decodeSmallestThree(uint64_t bits)
+		{
+			const uint64_t mask = (uint64_t{1} << BITS) - 1;
+			const T scale = T(1.4142135623730950488) / T(mask);
+			const T offset = T(0.70710678118654752440);
+
+			const unsigned largest = static_cast<unsigned>(bits >> (3 * BITS)) & 3u;
+			const T a = T(static_cast<uint32_t>((bits >> (2 * BITS)) & mask)) * scale - offset;
+			const T b = T(static_cast<uint32_t>((bits >> BITS) & mask)) * scale - offset;
+			const T c = T(static_cast<uint32_t>(bits & mask)) * scale - offset;
+			const T d = std::sqrt(std::max(T{0}, 1 - a * a - b * b - c * c));
+
+			return Quaternion<T>(largest == 0 ? d : a,
+								 largest == 0 ? a : largest == 1 ? d : b,
+								 largest <= 1 ? b : largest == 2 ? d : c,
+								 largest == 3 ? d : c);
+		}
+	}
+
+	template <typename T>
+	CompressedQuat32 compress32(const Quaternion<T> &q)
+	{
+		return {static_cast<uint32_t>(detail::encodeSmallestThree<10>(q))};
+	}
+
+	template <typename T>
+	CompressedQuat48 compress48(const Quaternion<T> &q)
+	{
+		const uint64_t bits = detail::encodeSmallestThree<15>(q);
+		return {{static_cast<uint16_t>(bits >> 32), static_cast<uint16_t>(bits >> 16), static_cast<uint16_t>(bits)}};
+	}
+
+	template <typename T = float>
+	Quaternion<T> decompress(const CompressedQuat32 &q)
+	{
+		return detail::decodeSmallestThree<10, T>(q.bits);
+	}
+
+	template <typename T = float>
+	Quaternion<T> decompress(const CompressedQuat48 &q)
+	{
+		const uint64_t bits = (uint64_t{q.bits[0]} << 32) | (uint64_t{q.bits[1]} << 16) | uint64_t{q.bits[2]};
+		return detail::decodeSmallestThree<15, T>(bits);
+	}
+
+	template <typename T>
+	QuantizedVec3 quantize(const Vector<3, T> &v, const Vector<3, T> &min, const Vector<3, T> &max)
+	{
+		QuantizedVec3 res{};
+		for(size_t i = 0; i < 3; ++i)
+		{
+			const T extent = max[i] - min[i];
+			const T normalized = extent > 0 ? (v[i] - min[i]) / extent : T{0};
+			res.bits[i] = static_cast<uint16_t>(std::round(std::min(std::max(normalized, T{0}), T{1}) * T{65535}));
+		}
+		return res;
+	}
+
+	template <typename T>
+	Vector<3, T> dequantize(const QuantizedVec3 &q, const Vector<3, T> &min, const Vector<3, T> &max)
+	{
+		Vector<3, T> res;
+		for(size_t i = 0; i < 3; ++i)
+			res[i] = min[i] + T(q.bits[i]) * ((max[i] - min[i]) / T{65535});
+		return res;
+	}
+
+	// ==================== Batch decoding ====================
+
+	template <typename T>
+	void decompress(const CompressedQuat32 *in, Quaternion<T> *out, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			out[i] = detail::decodeSmallestThree<10, T>(in[i].bits);
+	}
+
+	template <typename T>
+	void decompress(const CompressedQuat48 *in, Quaternion<T> *out, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			out[i] = decompress<T>(in[i]);
+	}
+
+	template <typename T>
+	void dequantize(
+		const QuantizedVec3 *in, Vector<3, T> *out, size_t count, const Vector<3, T> &min, const Vector<3, T> &max)
+	{
+		const Vector<3, T> step = (max - min) / T{65535};
+		for(size_t i = 0; i < count; ++i)
+		{
+			for(size_t c = 0; c < 3; ++c)
+				out[i][c] = min[c] + T(in[i].bits[c]) * step[c];
+		}
+	}
+}
+
+#endif
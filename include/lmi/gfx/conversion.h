@@ -0,0 +1,32 @@
+#ifndef LMI_CONVERSION_H
+#define LMI_CONVERSION_H
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/quaternion.h"
+
+namespace lmi
+{
+	// Batch conversions between rotation representations. Both directions are straight-line code without
+	// data-dependent branches, so each chunk compiles to a vectorized loop; chunks are spread across `threads`.
+
+	template <size_t COLS, size_t ROWS, typename T>
+	void convert(const Quaternion<T> *quaternions, Matrix<COLS, ROWS, T> *matrices, size_t count, size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [=](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+				matrices[i] = static_cast<Matrix<COLS, ROWS, T>>(quaternions[i]);
+		});
+	}
+
+	template <size_t COLS, size_t ROWS, typename T>
+	void convert(const Matrix<COLS, ROWS, T> *matrices, Quaternion<T> *quaternions, size_t count, size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [=](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+				quaternions[i] = Quaternion<T>(matrices[i]);
+		});
+	}
+}
+
+#endif
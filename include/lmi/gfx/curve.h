@@ -0,0 +1,480 @@
+#ifndef LMI_CURVE_H
+#define LMI_CURVE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Uniform cubic bases. Bezier curves share every third control point between segments (3n + 1 points for n
+	// segments) and pass through the shared ones, Catmull-Rom and B-spline segments use a sliding window of four
+	// (n + 3 points); Catmull-Rom interpolates the inner points, the B-spline only approximates them but is C2.
+	enum class CurveBasis
+	{
+		Bezier,
+		CatmullRom,
+		BSpline
+	};
+
+	namespace detail
+	{
+		// Row k holds the weights of the four control points in the coefficient of t^k.
+		template <typename T>
+		void basisMatrix(CurveBasis basis, T (&m)[4][4])
+		{
+			// clang-format off
+			static const double bezier[4][4] = {{ 1,  0,  0, 0},
+												{-3,  3,  0, 0},
+												{ 3, -6,  3, 0},
+												{-1,  3, -3, 1}};
+			static const double catmullRom[4][4] = {{   0,    1,    0,    0},
+													{-0.5,    0,  0.5,    0},
+													{   1, -2.5,    2, -0.5},
+													{-0.5,  1.5, -1.5,  0.5}};
+			static const double bSpline[4][4] = {{ 1,  4, 1, 0},
+												 {-3,  0, 3, 0},
+												 { 3, -6, 3, 0},
+												 {-1,  3, -3, 1}};
+			// clang-format on
+			const double(&b)[4][4] =
+				basis == CurveBasis::Bezier ? bezier : basis == CurveBasis::CatmullRom ? catmullRom : bSpline;
+			const double scale = basis == CurveBasis::BSpline ? 1.0 / 6.0 : 1.0;
+			for(size_t k = 0; k < 4; ++k)
+				for(size_t i = 0; i < 4; ++i)
+					m[k][i] = T(b[k][i] * scale);
+		}
+
+		inline size_t segmentStride(CurveBasis basis)
+		{
+			return basis == CurveBasis::Bezier ? 3 : 1;
+		}
+
+		inline size_t segmentCount(CurveBasis basis, size_t points)
+		{
+			return points < 4 ? 0 : (points - 1 - (basis == CurveBasis::Bezier ? 0 : 2)) / segmentStride(basis);
+		}
+
+		// Splits a global parameter in [0, segments] into a segment and the local parameter in [0, 1].
+		template <typename T>
+		size_t locate(T u, size_t segments, T &t)
+		{
+			u = std::min(std::max(u, T{0}), T(segments));
+			const size_t s = std::min(size_t(u), segments - 1);
+			t = u - T(s);
+			return s;
+		}
+
+		// Steps a cubic c0 + c1 t + c2 t^2 + c3 t^3 in increments of h with three additions per step. The error grows
+		// with the number of steps, so every segment restarts from its exact coefficients.
+		template <typename V, typename T>
+		struct ForwardDifferences
+		{
+			V d0, d1, d2, d3;
+
+			ForwardDifferences(const V &c0, const V &c1, const V &c2, const V &c3, T h)
+				: d0(c0),
+				  d1(c1 * h + c2 * (h * h) + c3 * (h * h * h)),
+				  d2(c2 * (2 * h * h) + c3 * (6 * h * h * h)),
+				  d3(c3 * (6 * h * h * h))
+			{
+			}
+
+			void step()
+			{
+				d0 += d1;
+				d1 += d2;
+				d2 += d3;
+			}
+		};
+	}
+
+	// Piecewise cubic curve over Vector<DIM, T>. The control points are converted to per segment power basis
+	// coefficients once, so evaluating a point costs a few multiply adds per component and no basis functions. The
+	// curve parameter u runs from 0 to segments(), segment s covering [s, s + 1]; derivatives are with respect to u.
+	template <size_t DIM, typename T = float>
+	class CubicCurve
+	{
+		public:
+		CubicCurve() = default;
+
+		CubicCurve(CurveBasis basis, const Vector<DIM, T> *points, size_t count)
+			: coefficients(4 * detail::segmentCount(basis, count)), components(DIM * coefficients.size())
+		{
+			T m[4][4];
+			detail::basisMatrix(basis, m);
+			const size_t stride = detail::segmentStride(basis);
+			for(size_t s = 0; s < segments(); ++s)
+				for(size_t k = 0; k < 4; ++k)
+					for(size_t i = 0; i < 4; ++i)
+						coefficients[4 * s + k] += points[s * stride + i] * m[k][i];
+			for(size_t d = 0; d < DIM; ++d)
+				for(size_t c = 0; c < coefficients.size(); ++c)
+					components[d * coefficients.size() + c] = coefficients[c][d];
+		}
+
+		size_t segments() const
+		{
+			return coefficients.size() / 4;
+		}
+
+		// Power basis coefficients of segment s, position = c[0] + c[1] t + c[2] t^2 + c[3] t^3.
+		const Vector<DIM, T> *segment(size_t s) const
+		{
+			return coefficients.data() + 4 * s;
+		}
+
+		// A curve without segments, from fewer than four points, evaluates to zero everywhere.
+		Vector<DIM, T> evaluate(T u) const
+		{
+			if(segments() == 0)
+				return Vector<DIM, T>();
+			T t;
+			const Vector<DIM, T> *c = segment(detail::locate(u, segments(), t));
+			return ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+		}
+
+		Vector<DIM, T> derivative(T u) const
+		{
+			if(segments() == 0)
+				return Vector<DIM, T>();
+			T t;
+			const Vector<DIM, T> *c = segment(detail::locate(u, segments(), t));
+			return (c[3] * (3 * t) + c[2] * T{2}) * t + c[1];
+		}
+
+		Vector<DIM, T> secondDerivative(T u) const
+		{
+			if(segments() == 0)
+				return Vector<DIM, T>();
+			T t;
+			const Vector<DIM, T> *c = segment(detail::locate(u, segments(), t));
+			return c[3] * (6 * t) + c[2] * T{2};
+		}
+
+		// Positions and, if requested, first derivatives at arbitrary parameters. Every component is evaluated in its
+		// own pass over a block of parameters, gathering from per component coefficient arrays so the passes
+		// vectorize.
+		void evaluate(const T *u,
+					  size_t count,
+					  Vector<DIM, T> *positions,
+					  Vector<DIM, T> *derivatives = nullptr,
+					  size_t threads = 1) const
+		{
+			if(segments() == 0)
+			{
+				std::fill(positions, positions + count, Vector<DIM, T>());
+				if(derivatives)
+					std::fill(derivatives, derivatives + count, Vector<DIM, T>());
+				return;
+			}
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				int32_t index[blockSize];
+				T t[blockSize], p[blockSize], dp[blockSize];
+				for(size_t b = begin; b < end; b += blockSize)
+				{
+					const size_t n = std::min(blockSize, end - b);
+					for(size_t i = 0; i < n; ++i)
+						index[i] = int32_t(4 * detail::locate(u[b + i], segments(), t[i]));
+					for(size_t d = 0; d < DIM; ++d)
+					{
+						const T *c = components.data() + d * coefficients.size();
+						for(size_t i = 0; i < n; ++i)
+						{
+							const int32_t k = index[i];
+							p[i] = ((c[k + 3] * t[i] + c[k + 2]) * t[i] + c[k + 1]) * t[i] + c[k];
+							dp[i] = (3 * c[k + 3] * t[i] + 2 * c[k + 2]) * t[i] + c[k + 1];
+						}
+						for(size_t i = 0; i < n; ++i)
+							positions[b + i][d] = p[i];
+						if(derivatives)
+							for(size_t i = 0; i < n; ++i)
+								derivatives[b + i][d] = dp[i];
+					}
+				}
+			});
+		}
+
+		// steps uniformly spaced points per segment plus the end point, segments() * steps + 1 in total, by forward
+		// differencing. Segments are processed in parallel.
+		void tessellate(size_t steps,
+						Vector<DIM, T> *positions,
+						Vector<DIM, T> *derivatives = nullptr,
+						size_t threads = 1) const
+		{
+			const T h = T{1} / T(steps);
+			detail::parallelFor(segments(), threads, [&](size_t begin, size_t end) {
+				for(size_t s = begin; s < end; ++s)
+				{
+					const Vector<DIM, T> *c = segment(s);
+					const size_t first = s * steps;
+					detail::ForwardDifferences<Vector<DIM, T>, T> p(c[0], c[1], c[2], c[3], h);
+					for(size_t i = 0; i < steps; ++i, p.step())
+						positions[first + i] = p.d0;
+					if(derivatives)
+					{
+						detail::ForwardDifferences<Vector<DIM, T>, T> dp(c[1], c[2] * T{2}, c[3] * T{3},
+																		 Vector<DIM, T>(), h);
+						for(size_t i = 0; i < steps; ++i, dp.step())
+							derivatives[first + i] = dp.d0;
+					}
+				}
+			});
+			if(segments() == 0)
+				return;
+			const size_t last = segments() * steps;
+			positions[last] = evaluate(T(segments()));
+			if(derivatives)
+				derivatives[last] = derivative(T(segments()));
+		}
+
+		private:
+		static constexpr size_t blockSize = 64;
+
+		detail::AlignedVector<Vector<DIM, T>> coefficients;
+		std::vector<T> components;	// The coefficients again, one array per component, for the batch evaluation.
+	};
+
+	template <size_t DIM, typename T>
+	constexpr size_t CubicCurve<DIM, T>::blockSize;
+
+	// Cumulative arc length of a curve at samplesPerSegment uniformly spaced parameters, integrated with 5 point
+	// Gauss-Legendre quadrature. Maps distances along the curve to curve parameters by a binary search in the
+	// table, linear interpolation and one Newton step, which makes the mapping accurate to a small fraction of a
+	// table interval. Build it once per curve and reuse it for every query; the table refers to the curve, which
+	// has to outlive it.
+	template <size_t DIM, typename T = float>
+	class ArcLengthTable
+	{
+		public:
+		explicit ArcLengthTable(const CubicCurve<DIM, T> &curve, size_t samplesPerSegment = 16, size_t threads = 1)
+			: curve(&curve), samples(samplesPerSegment), lengths(curve.segments() * samplesPerSegment + 1)
+		{
+			const T h = T{1} / T(samples);
+			detail::parallelFor(lengths.size() - 1, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					lengths[i + 1] = integrate(T(i) * h, T(i + 1) * h);
+			});
+			for(size_t i = 1; i < lengths.size(); ++i)
+				lengths[i] += lengths[i - 1];
+		}
+
+		// A temporary curve would be gone before the first query.
+		ArcLengthTable(CubicCurve<DIM, T> &&, size_t = 16, size_t = 1) = delete;
+
+		T length() const
+		{
+			return lengths.back();
+		}
+
+		// Curve parameter at distance s from the start, s is clamped to [0, length()].
+		T parameter(T s) const
+		{
+			if(lengths.size() < 2)
+				return T{0};
+			s = std::min(std::max(s, T{0}), length());
+			const size_t i = std::min(size_t(std::upper_bound(lengths.begin(), lengths.end(), s) - lengths.begin()),
+									  lengths.size() - 1) - 1;
+			const T h = T{1} / T(samples), u0 = T(i) * h;
+			const T span = lengths[i + 1] - lengths[i];
+			T u = span > T{0} ? u0 + h * (s - lengths[i]) / span : u0;
+
+			const T speed = lmi::length(curve->derivative(u));
+			if(speed > T{0})
+				u -= (lengths[i] + integrate(u0, u) - s) / speed;
+			return std::min(std::max(u, u0), u0 + h);
+		}
+
+		void parameters(const T *distances, size_t count, T *u, size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					u[i] = parameter(distances[i]);
+			});
+		}
+
+		// count points (at least 2) evenly spaced by arc length, from the start to the end of the curve.
+		void sampleEvenly(size_t count,
+						  Vector<DIM, T> *positions,
+						  Vector<DIM, T> *derivatives = nullptr,
+						  size_t threads = 1) const
+		{
+			std::vector<T> u(count);
+			const T spacing = length() / T(count - 1);
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					u[i] = parameter(T(i) * spacing);
+			});
+			curve->evaluate(u.data(), count, positions, derivatives, threads);
+		}
+
+		private:
+		T integrate(T a, T b) const
+		{
+			static const T nodes[5] = {T(-0.9061798459386640), T(-0.5384693101056831), T(0), T(0.5384693101056831),
+									   T(0.9061798459386640)};
+			static const T weights[5] = {T(0.2369268850561891), T(0.4786286704993665), T(0.5688888888888889),
+										 T(0.4786286704993665), T(0.2369268850561891)};
+			const T half = (b - a) / 2, mid = (a + b) / 2;
+			T sum = 0;
+			for(size_t k = 0; k < 5; ++k)
+				sum += weights[k] * lmi::length(curve->derivative(mid + half * nodes[k]));
+			return sum * half;
+		}
+
+		const CubicCurve<DIM, T> *curve;
+		size_t samples;
+		std::vector<T> lengths;
+	};
+
+	// Tensor product of two cubic curves over a grid of columns x rows control points, stored row major. Rows are
+	// curves in u, columns curves in v. (u, v) runs over [0, patchesU()] x [0, patchesV()], every patch is stored as
+	// 4 x 4 power basis coefficients.
+	template <size_t DIM, typename T = float>
+	class CubicPatch
+	{
+		public:
+		CubicPatch() = default;
+
+		CubicPatch(CurveBasis basis, const Vector<DIM, T> *points, size_t columns, size_t rows)
+			: countU(detail::segmentCount(basis, columns)),
+			  countV(detail::segmentCount(basis, rows)),
+			  coefficients(16 * countU * countV)
+		{
+			T m[4][4];
+			detail::basisMatrix(basis, m);
+			const size_t stride = detail::segmentStride(basis);
+			for(size_t pv = 0; pv < countV; ++pv)
+				for(size_t pu = 0; pu < countU; ++pu)
+				{
+					Vector<DIM, T> *c = coefficients.data() + 16 * (pv * countU + pu);
+					for(size_t l = 0; l < 4; ++l)
+						for(size_t k = 0; k < 4; ++k)
+							for(size_t j = 0; j < 4; ++j)
+								for(size_t i = 0; i < 4; ++i)
+									c[4 * l + k] +=
+										points[(pv * stride + j) * columns + pu * stride + i] * (m[k][i] * m[l][j]);
+				}
+		}
+
+		size_t patchesU() const
+		{
+			return countU;
+		}
+
+		size_t patchesV() const
+		{
+			return countV;
+		}
+
+		// Position and, if requested, the partial derivatives.
+		Vector<DIM, T> evaluate(T u, T v, Vector<DIM, T> *du = nullptr, Vector<DIM, T> *dv = nullptr) const
+		{
+			T s, t;
+			const size_t pu = detail::locate(u, countU, s), pv = detail::locate(v, countV, t);
+			Vector<DIM, T> a[4], b[4];
+			collapse(patch(pu, pv), t, a, b);
+			if(du)
+				*du = (a[3] * (3 * s) + a[2] * T{2}) * s + a[1];
+			if(dv)
+				*dv = ((b[3] * s + b[2]) * s + b[1]) * s + b[0];
+			return ((a[3] * s + a[2]) * s + a[1]) * s + a[0];
+		}
+
+		void evaluate(const Vector<2, T> *uv,
+					  size_t count,
+					  Vector<DIM, T> *positions,
+					  Vector<DIM, T> *du = nullptr,
+					  Vector<DIM, T> *dv = nullptr,
+					  size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+				{
+					Vector<DIM, T> pu, pv;
+					positions[i] = evaluate(uv[i][0], uv[i][1], &pu, &pv);
+					if(du)
+						du[i] = pu;
+					if(dv)
+						dv[i] = pv;
+				}
+			});
+		}
+
+		// Regular grid of (patchesU() * stepsU + 1) x (patchesV() * stepsV + 1) vertices, row major with u varying
+		// fastest. Every row collapses the patches to cubics in u once and forward differences along them; rows are
+		// processed in parallel.
+		void tessellate(size_t stepsU,
+						size_t stepsV,
+						Vector<DIM, T> *positions,
+						Vector<DIM, T> *du = nullptr,
+						Vector<DIM, T> *dv = nullptr,
+						size_t threads = 1) const
+		{
+			const size_t width = countU * stepsU + 1, height = countV * stepsV + 1;
+			const T h = T{1} / T(stepsU);
+			detail::parallelFor(countU * countV == 0 ? 0 : height, threads, [&](size_t begin, size_t end) {
+				for(size_t row = begin; row < end; ++row)
+				{
+					T t;
+					const size_t pv = detail::locate(T(row) / T(stepsV), countV, t);
+					Vector<DIM, T> *out = positions + row * width;
+					for(size_t pu = 0; pu < countU; ++pu)
+					{
+						Vector<DIM, T> a[4], b[4];
+						collapse(patch(pu, pv), t, a, b);
+						const size_t first = pu * stepsU;
+						detail::ForwardDifferences<Vector<DIM, T>, T> p(a[0], a[1], a[2], a[3], h);
+						for(size_t i = 0; i < stepsU; ++i, p.step())
+							out[first + i] = p.d0;
+						if(du)
+						{
+							detail::ForwardDifferences<Vector<DIM, T>, T> d(a[1], a[2] * T{2}, a[3] * T{3},
+																			Vector<DIM, T>(), h);
+							for(size_t i = 0; i < stepsU; ++i, d.step())
+								du[row * width + first + i] = d.d0;
+						}
+						if(dv)
+						{
+							detail::ForwardDifferences<Vector<DIM, T>, T> d(b[0], b[1], b[2], b[3], h);
+							for(size_t i = 0; i < stepsU; ++i, d.step())
+								dv[row * width + first + i] = d.d0;
+						}
+					}
+					Vector<DIM, T> endU, endV;
+					out[width - 1] = evaluate(T(countU), T(row) / T(stepsV), &endU, &endV);
+					if(du)
+						du[row * width + width - 1] = endU;
+					if(dv)
+						dv[row * width + width - 1] = endV;
+				}
+			});
+		}
+
+		private:
+		const Vector<DIM, T> *patch(size_t pu, size_t pv) const
+		{
+			return coefficients.data() + 16 * (pv * countU + pu);
+		}
+
+		// Coefficients of the cubic in u at a fixed v (a) and of its derivative with respect to v (b).
+		static void collapse(const Vector<DIM, T> *c, T t, Vector<DIM, T> (&a)[4], Vector<DIM, T> (&b)[4])
+		{
+			for(size_t k = 0; k < 4; ++k)
+			{
+				a[k] = ((c[12 + k] * t + c[8 + k]) * t + c[4 + k]) * t + c[k];
+				b[k] = (c[12 + k] * (3 * t) + c[8 + k] * T{2}) * t + c[4 + k];
+			}
+		}
+
+		size_t countU = 0, countV = 0;
+		detail::AlignedVector<Vector<DIM, T>> coefficients;
+	};
+}
+
+#endif
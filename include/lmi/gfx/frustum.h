@@ -0,0 +1,244 @@
+#ifndef LMI_FRUSTUM_H
+#define LMI_FRUSTUM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "projection.h"
+
+namespace lmi
+{
+	// Structure of arrays views used by the batch culling functions, one entry per object.
+	template <typename T>
+	struct BoundingSpheres
+	{
+		const T *x, *y, *z, *radius;
+	};
+
+	template <typename T>
+	struct BoundingBoxes
+	{
+		const T *minX, *minY, *minZ, *maxX, *maxY, *maxZ;
+	};
+
+	template <typename T = float>
+	class Frustum
+	{
+		public:
+		enum Side
+		{
+			Left,
+			Right,
+			Bottom,
+			Top,
+			Near,
+			Far
+		};
+
+		constexpr Frustum() = default;
+
+		// Gribb/Hartmann extraction from a projection * view matrix, by default with OpenGL clip conventions
+		// (-w <= z <= w) as produced by perspective(). For DepthRange::ZeroToOne the Near and Far planes are z >= 0
+		// and z <= w, which under reverse-Z are the far and near plane respectively. Planes are stored as
+		// (a, b, c, d) with a unit normal pointing inwards. A plane at infinity (infinite far plane) degenerates to
+		// one that accepts everything.
+		constexpr explicit Frustum(const Matrix<4, 4, T> &m, DepthRange depth = DepthRange::NegativeOneToOne)
+		{
+			for(size_t i = 0; i < 3; ++i)
+			{
+				for(size_t c = 0; c < 4; ++c)
+				{
+					planes[2 * i][c] = m[c][3] + m[c][i];
+					planes[2 * i + 1][c] = m[c][3] - m[c][i];
+				}
+			}
+			if(depth == DepthRange::ZeroToOne)
+			{
+				for(size_t c = 0; c < 4; ++c)
+					planes[Near][c] = m[c][2];
+			}
+
+			for(auto &p : planes)
+			{
+				const T len = lmi::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+				if(len > T{0})
+					p /= len;
+				else
+					p = Vector<4, T>(T{0}, T{0}, T{0}, T{1});
+			}
+		}
+
+		constexpr const Vector<4, T> &operator[](size_t i) const
+		{
+			return planes[i];
+		}
+
+		constexpr T distance(size_t plane, const Vector<3, T> &p) const
+		{
+			return planes[plane][0] * p[0] + planes[plane][1] * p[1] + planes[plane][2] * p[2] + planes[plane][3];
+		}
+
+		constexpr bool contains(const Vector<3, T> &p) const
+		{
+			return intersects(p, T{0});
+		}
+
+		constexpr bool intersects(const Vector<3, T> &center, T radius) const
+		{
+			for(size_t i = 0; i < 6; ++i)
+			{
+				if(distance(i, center) < -radius)
+					return false;
+			}
+			return true;
+		}
+
+		// Conservative: boxes that straddle two planes outside a frustum corner are reported as visible.
+		constexpr bool intersects(const Vector<3, T> &min, const Vector<3, T> &max) const
+		{
+			const Vector<3, T> center = (min + max) / T{2};
+			const Vector<3, T> extent = (max - min) / T{2};
+			for(size_t i = 0; i < 6; ++i)
+			{
+				const T radius = std::abs(planes[i][0]) * extent[0] + std::abs(planes[i][1]) * extent[1] +
+								 std::abs(planes[i][2]) * extent[2];
+				if(distance(i, center) < -radius)
+					return false;
+			}
+			return true;
+		}
+
+		// ==================== Batch culling ====================
+		// The kernels test all six planes per object without early outs, so every loop iteration is independent and
+		// the compiler processes as many objects per instruction as the target allows (4 with SSE, 8 with AVX, 16
+		// with AVX-512). The mask versions write 1 for visible and 0 for culled objects, the index versions write the
+		// indices of the visible objects in ascending order and return how many there are; `indices` needs room for
+		// `count` entries.
+
+		void cull(const BoundingSpheres<T> &spheres, size_t count, uint8_t *visible, size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				sphereMask(spheres, begin, end, visible + begin);
+			});
+		}
+
+		size_t cull(const BoundingSpheres<T> &spheres, size_t count, uint32_t *indices, size_t threads = 1) const
+		{
+			return compact(count, threads, indices, [&](size_t begin, size_t end, uint8_t *visible) {
+				sphereMask(spheres, begin, end, visible);
+			});
+		}
+
+		void cull(const BoundingBoxes<T> &boxes, size_t count, uint8_t *visible, size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				boxMask(boxes, begin, end, visible + begin);
+			});
+		}
+
+		size_t cull(const BoundingBoxes<T> &boxes, size_t count, uint32_t *indices, size_t threads = 1) const
+		{
+			return compact(count, threads, indices, [&](size_t begin, size_t end, uint8_t *visible) {
+				boxMask(boxes, begin, end, visible);
+			});
+		}
+
+		private:
+		void sphereMask(const BoundingSpheres<T> &s, size_t begin, size_t end, uint8_t *visible) const
+		{
+			T a[6], b[6], c[6], d[6];
+			for(size_t p = 0; p < 6; ++p)
+			{
+				a[p] = planes[p][0];
+				b[p] = planes[p][1];
+				c[p] = planes[p][2];
+				d[p] = planes[p][3];
+			}
+
+			for(size_t i = begin; i < end; ++i)
+			{
+				unsigned inside = 1;
+				for(size_t p = 0; p < 6; ++p)
+					inside &= unsigned(a[p] * s.x[i] + b[p] * s.y[i] + c[p] * s.z[i] + d[p] >= -s.radius[i]);
+				visible[i - begin] = uint8_t(inside);
+			}
+		}
+
+		void boxMask(const BoundingBoxes<T> &bb, size_t begin, size_t end, uint8_t *visible) const
+		{
+			T a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+			for(size_t p = 0; p < 6; ++p)
+			{
+				a[p] = planes[p][0];
+				b[p] = planes[p][1];
+				c[p] = planes[p][2];
+				d[p] = planes[p][3];
+				absA[p] = std::abs(a[p]);
+				absB[p] = std::abs(b[p]);
+				absC[p] = std::abs(c[p]);
+			}
+
+			for(size_t i = begin; i < end; ++i)
+			{
+				const T cx = (bb.minX[i] + bb.maxX[i]) / T{2}, ex = (bb.maxX[i] - bb.minX[i]) / T{2};
+				const T cy = (bb.minY[i] + bb.maxY[i]) / T{2}, ey = (bb.maxY[i] - bb.minY[i]) / T{2};
+				const T cz = (bb.minZ[i] + bb.maxZ[i]) / T{2}, ez = (bb.maxZ[i] - bb.minZ[i]) / T{2};
+
+				unsigned inside = 1;
+				for(size_t p = 0; p < 6; ++p)
+				{
+					const T radius = absA[p] * ex + absB[p] * ey + absC[p] * ez;
+					inside &= unsigned(a[p] * cx + b[p] * cy + c[p] * cz + d[p] >= -radius);
+				}
+				visible[i - begin] = uint8_t(inside);
+			}
+		}
+
+		// Every chunk compacts into its own slice of `indices` through a small stack mask, then the slices are
+		// moved down to close the gaps. The output order does not depend on the thread count.
+		template <typename Kernel>
+		static size_t compact(size_t count, size_t threads, uint32_t *indices, Kernel &&kernel)
+		{
+			const size_t chunks = detail::chunkCount(count, threads);
+			const size_t chunk = detail::chunkSize(count, threads);
+			std::vector<size_t> visibleCounts(chunks);
+
+			detail::parallelChunks(count, threads, [&](size_t i, size_t begin, size_t end) {
+				const size_t blockSize = 256;
+				uint8_t visible[blockSize];
+				size_t n = 0;
+				for(size_t block = begin; block < end; block += blockSize)
+				{
+					const size_t blockEnd = std::min(block + blockSize, end);
+					kernel(block, blockEnd, visible);
+					for(size_t j = block; j < blockEnd; ++j)
+					{
+						indices[begin + n] = uint32_t(j);
+						n += visible[j - block];
+					}
+				}
+				visibleCounts[i] = n;
+			});
+
+			// Chunk 0 is already in place, and so is every chunk with no gap before it, which std::copy must not be
+			// asked to copy onto itself.
+			size_t total = chunks != 0 ? visibleCounts[0] : 0;
+			for(size_t i = 1; i < chunks; ++i)
+			{
+				if(total != i * chunk)
+					std::copy(indices + i * chunk, indices + i * chunk + visibleCounts[i], indices + total);
+				total += visibleCounts[i];
+			}
+			return total;
+		}
+
+		Vector<4, T> planes[6];
+	};
+}
+
+#endif
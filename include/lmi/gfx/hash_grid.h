@@ -0,0 +1,198 @@
+#ifndef LMI_HASH_GRID_H
+#define LMI_HASH_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Uniform grid over unbounded space, with only the occupied cells stored in an open addressing hash table. The
+	// points of a cell are stored contiguously, in cell order, together with their original indices. Rebuilding is
+	// a counting sort and allocates nothing once the grid has seen its largest point count.
+	template <typename T = float>
+	class HashGrid
+	{
+		public:
+		explicit HashGrid(T cellSize) : cellSize(cellSize), invCellSize(T{1} / cellSize)
+		{
+		}
+
+		// Replaces the contents with count points. Cell coordinates and the final scatter run in parallel, the hash
+		// table inserts are serial.
+		void build(const Vector<3, T> *points, size_t count, size_t threads = 1)
+		{
+			size_t capacity = 16;
+			while(capacity < 2 * count)
+				capacity *= 2;
+			table.assign(capacity, Slot());
+			cells.resize(count);
+			slots.resize(count);
+			entries.resize(count);
+			sorted.resize(count);
+			used = 0;
+
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					cells[i] = cell(points[i]);
+			});
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				size_t s = find(cells[i]);
+				if(table[s].count == 0)
+				{
+					table[s].cell = cells[i];
+					++used;
+				}
+				++table[s].count;
+				slots[i] = uint32_t(s);
+			}
+
+			// count is rebuilt while scattering. Stable, so the points of a cell stay in input order.
+			uint32_t offset = 0;
+			for(auto &slot : table)
+			{
+				slot.begin = offset;
+				offset += slot.count;
+				slot.count = 0;
+			}
+			for(size_t i = 0; i < count; ++i)
+			{
+				Slot &slot = table[slots[i]];
+				entries[slot.begin + slot.count++] = uint32_t(i);
+			}
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					sorted[i] = points[entries[i]];
+			});
+		}
+
+		Vector<3, int> cell(const Vector<3, T> &p) const
+		{
+			return Vector<3, int>(int(std::floor(p[0] * invCellSize)),
+								  int(std::floor(p[1] * invCellSize)),
+								  int(std::floor(p[2] * invCellSize)));
+		}
+
+		size_t size() const
+		{
+			return entries.size();
+		}
+
+		size_t occupiedCells() const
+		{
+			return used;
+		}
+
+		// Calls f(index, position) for every point in the cell.
+		template <typename Function>
+		void forEachInCell(const Vector<3, int> &c, Function &&f) const
+		{
+			if(table.empty())
+				return;
+			const Slot &slot = table[find(c)];
+			for(uint32_t i = slot.begin; i < slot.begin + slot.count; ++i)
+				f(entries[i], sorted[i]);
+		}
+
+		// Calls f(index, squaredDistance) for every point with a distance of at most radius to p. Visits
+		// (2 * ceil(radius / cellSize) + 1)^3 cells, so the cell size should be close to the typical radius.
+		template <typename Function>
+		void forEachNeighbour(const Vector<3, T> &p, T radius, Function &&f) const
+		{
+			const Vector<3, int> lo = cell(p - Vector<3, T>(radius)), hi = cell(p + Vector<3, T>(radius));
+			const T r2 = radius * radius;
+			for(int z = lo[2]; z <= hi[2]; ++z)
+				for(int y = lo[1]; y <= hi[1]; ++y)
+					for(int x = lo[0]; x <= hi[0]; ++x)
+						forEachInCell(Vector<3, int>(x, y, z), [&](uint32_t index, const Vector<3, T> &q) {
+							const Vector<3, T> d = q - p;
+							const T d2 = dot(d, d);
+							if(d2 <= r2)
+								f(index, d2);
+						});
+		}
+
+		private:
+		struct Slot
+		{
+			Vector<3, int> cell;
+			uint32_t begin = 0, count = 0;
+		};
+
+		static size_t hash(const Vector<3, int> &c)
+		{
+			uint64_t h = uint64_t(uint32_t(c[0])) * 0x9e3779b97f4a7c15u;
+			h ^= uint64_t(uint32_t(c[1])) * 0xc2b2ae3d27d4eb4fu;
+			h ^= uint64_t(uint32_t(c[2])) * 0x165667b19e3779f9u;
+			return size_t(h ^ (h >> 29));
+		}
+
+		// Slot holding c, or the empty slot where it would be inserted. The table is at most half full, so linear
+		// probing always ends.
+		size_t find(const Vector<3, int> &c) const
+		{
+			const size_t mask = table.size() - 1;
+			size_t s = hash(c) & mask;
+			while(table[s].count != 0 && !(table[s].cell == c))
+				s = (s + 1) & mask;
+			return s;
+		}
+
+		T cellSize, invCellSize;
+		size_t used = 0;
+		detail::AlignedVector<Slot> table;
+		detail::AlignedVector<Vector<3, int>> cells;
+		std::vector<uint32_t> slots, entries;
+		detail::AlignedVector<Vector<3, T>> sorted;
+	};
+
+	// Merges vertices at most epsilon apart. remap[i] receives the new index of vertex i; the first vertex of every
+	// group in input order is kept, so vertices never move and indices of kept vertices only shift down. unique
+	// (optional, may alias vertices) receives the kept vertices. Returns the number of kept vertices.
+	//
+	// Closeness is not transitive: a vertex joins the first kept vertex within epsilon, chains of vertices at most
+	// epsilon apart can still end up in several groups.
+	template <typename T>
+	size_t weldVertices(const Vector<3, T> *vertices,
+						size_t count,
+						T epsilon,
+						uint32_t *remap,
+						Vector<3, T> *unique = nullptr,
+						size_t threads = 1)
+	{
+		HashGrid<T> grid(epsilon > T{0} ? 2 * epsilon : T{1});
+		grid.build(vertices, count, threads);
+
+		// Kept vertices are their own representative, the others get their new index in a second pass.
+		const uint32_t none = ~uint32_t{0};
+		std::vector<uint32_t> representative(count);
+		uint32_t kept = 0;
+		for(size_t i = 0; i < count; ++i)
+		{
+			uint32_t first = uint32_t(i);
+			grid.forEachNeighbour(vertices[i], epsilon, [&](uint32_t j, T) {
+				if(j < first && representative[j] == j)
+					first = j;
+			});
+			representative[i] = first;
+			remap[i] = first == i ? kept++ : none;
+		}
+		for(size_t i = 0; i < count; ++i)
+		{
+			if(remap[i] == none)
+				remap[i] = remap[representative[i]];
+			else if(unique)
+				unique[remap[i]] = vertices[i];
+		}
+		return kept;
+	}
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef LMI_HIERARCHY_H
+#define LMI_HIERARCHY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/quaternion.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	namespace detail
+	{
+		// parent * local for affine matrices, skipping the constant last row.
+		template <typename T>
+		void composeAffine(const Matrix<4, 4, T> &parent, const Matrix<4, 4, T> &local, Matrix<4, 4, T> &res)
+		{
+			for(size_t c = 0; c < 4; ++c)
+			{
+				for(size_t r = 0; r < 3; ++r)
+				{
+					res[c][r] = parent[0][r] * local[c][0] + parent[1][r] * local[c][1] + parent[2][r] * local[c][2];
+				}
+				res[c][3] = T{0};
+			}
+			for(size_t r = 0; r < 3; ++r)
+				res[3][r] += parent[3][r];
+			res[3][3] = T{1};
+		}
+
+		template <typename T>
+		Matrix<4, 4, T> composeTRS(const Vector<3, T> &t, const Quaternion<T> &r, const Vector<3, T> &s)
+		{
+			Matrix<4, 4, T> res = static_cast<Matrix<4, 4, T>>(r);
+			for(size_t c = 0; c < 3; ++c)
+				res[c] *= s[c];
+			res[3] = Vector<4, T>(t[0], t[1], t[2], T{1});
+			return res;
+		}
+	}
+
+	// Scene transform hierarchy. Local translation, rotation and scale live in structure of arrays storage sorted by
+	// depth, so every level is a contiguous range whose nodes only depend on the level above. update() walks the
+	// levels in order and recomputes world matrices only for nodes that were changed or whose ancestor was, splitting
+	// large levels across threads. Node handles stay valid while the storage is reordered.
+	template <typename T = float>
+	class TransformHierarchy
+	{
+		public:
+		using Node = uint32_t;
+		static constexpr Node none = std::numeric_limits<Node>::max();
+
+		Node add(Node parent = none,
+				 const Vector<3, T> &translation = Vector<3, T>(T{0}),
+				 const Quaternion<T> &rotation = Quaternion<T>(T{1}),
+				 const Vector<3, T> &scale = Vector<3, T>(T{1}))
+		{
+			const Node node = Node(slotOf.size());
+			const uint32_t depth = parent == none ? 0 : depths[slotOf[parent]] + 1;
+
+			slotOf.push_back(Node(nodeOf.size()));
+			nodeOf.push_back(node);
+			parents.push_back(parent == none ? none : slotOf[parent]);
+			depths.push_back(depth);
+			translations.push_back(translation);
+			rotations.push_back(rotation);
+			scales.push_back(scale);
+			worlds.push_back(Matrix<4, 4, T>(T{1}));
+			dirty.push_back(1);
+
+			// Appending keeps the depth order unless the new node is shallower than the last one.
+			sorted = sorted && (depths.size() < 2 || depth >= depths[depths.size() - 2]);
+			return node;
+		}
+
+		size_t size() const
+		{
+			return nodeOf.size();
+		}
+
+		Node parent(Node node) const
+		{
+			const Node p = parents[slotOf[node]];
+			return p == none ? none : nodeOf[p];
+		}
+
+		const Vector<3, T> &translation(Node node) const
+		{
+			return translations[slotOf[node]];
+		}
+
+		const Quaternion<T> &rotation(Node node) const
+		{
+			return rotations[slotOf[node]];
+		}
+
+		const Vector<3, T> &scale(Node node) const
+		{
+			return scales[slotOf[node]];
+		}
+
+		void setTranslation(Node node, const Vector<3, T> &t)
+		{
+			translations[slotOf[node]] = t;
+			dirty[slotOf[node]] = 1;
+		}
+
+		void setRotation(Node node, const Quaternion<T> &r)
+		{
+			rotations[slotOf[node]] = r;
+			dirty[slotOf[node]] = 1;
+		}
+
+		void setScale(Node node, const Vector<3, T> &s)
+		{
+			scales[slotOf[node]] = s;
+			dirty[slotOf[node]] = 1;
+		}
+
+		// Only up to date after update().
+		const Matrix<4, 4, T> &world(Node node) const
+		{
+			return worlds[slotOf[node]];
+		}
+
+		void update(size_t threads = 1)
+		{
+			if(!sorted)
+				sortByDepth();
+
+			// Spawning threads costs more than updating a small level inline.
+			const size_t minParallelLevel = 4096;
+			size_t begin = 0;
+			while(begin < size())
+			{
+				size_t end = begin;
+				while(end < size() && depths[end] == depths[begin])
+					++end;
+
+				const size_t levelThreads = end - begin < minParallelLevel ? 1 : threads;
+				detail::parallelFor(end - begin, levelThreads, [&](size_t b, size_t e) {
+					updateRange(begin + b, begin + e);
+				});
+				begin = end;
+			}
+
+			// Children read their parent's flag, so flags can only be cleared once every level is done.
+			std::fill(dirty.begin(), dirty.end(), uint8_t{0});
+		}
+
+		private:
+		void updateRange(size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				const Node p = parents[i];
+				if(p != none)
+					dirty[i] |= dirty[p];
+				if(!dirty[i])
+					continue;
+
+				const Matrix<4, 4, T> local = detail::composeTRS(translations[i], rotations[i], scales[i]);
+				if(p == none)
+					worlds[i] = local;
+				else
+					detail::composeAffine(worlds[p], local, worlds[i]);
+			}
+		}
+
+		// Stable counting sort of all slots by depth.
+		void sortByDepth()
+		{
+			const size_t n = size();
+			uint32_t maxDepth = 0;
+			for(auto d : depths)
+				maxDepth = std::max(maxDepth, d);
+
+			std::vector<size_t> offsets(maxDepth + 2, 0);
+			for(auto d : depths)
+				++offsets[d + 1];
+			for(size_t d = 1; d < offsets.size(); ++d)
+				offsets[d] += offsets[d - 1];
+
+			std::vector<Node> newSlot(n);
+			for(size_t i = 0; i < n; ++i)
+				newSlot[i] = Node(offsets[depths[i]]++);
+
+			auto permute = [&](auto &v) {
+				std::remove_reference_t<decltype(v)> res(n);
+				for(size_t i = 0; i < n; ++i)
+					res[newSlot[i]] = v[i];
+				v.swap(res);
+			};
+			for(auto &p : parents)
+				p = p == none ? none : newSlot[p];
+			permute(parents);
+			permute(depths);
+			permute(translations);
+			permute(rotations);
+			permute(scales);
+			permute(worlds);
+			permute(dirty);
+			permute(nodeOf);
+			for(size_t i = 0; i < n; ++i)
+				slotOf[nodeOf[i]] = Node(i);
+			sorted = true;
+		}
+
+		std::vector<Node> slotOf, nodeOf, parents;
+		std::vector<uint32_t> depths;
+		detail::AlignedVector<Vector<3, T>> translations;
+		detail::AlignedVector<Quaternion<T>> rotations;
+		detail::AlignedVector<Vector<3, T>> scales;
+		detail::AlignedVector<Matrix<4, 4, T>> worlds;
+		std::vector<uint8_t> dirty;
+		bool sorted = true;
+	};
+
+	template <typename T>
+	constexpr typename TransformHierarchy<T>::Node TransformHierarchy<T>::none;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef LMI_KDTREE_H
+#define LMI_KDTREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Balanced k-d tree without pointers. Every level splits each node's range of points at the same relative
+	// position, so the range of a node follows from its level and index, and the tree is just one split value and
+	// axis per inner node in heap order plus the reordered points. The points are stored as one array per axis,
+	// which lets a leaf be scanned with a single vectorized distance loop.
+	template <size_t DIM, typename T = float>
+	class KdTree
+	{
+		static_assert(DIM == 2 || DIM == 3, "KdTree supports 2D and 3D points");
+
+		public:
+		static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+		static constexpr size_t maxLeafSize = 16;
+
+		KdTree() = default;
+
+		// Levels are split one after another, the nodes of a level in parallel. The root split is a serial
+		// nth_element over all points, so the first levels use fewer threads than requested.
+		KdTree(const Vector<DIM, T> *points, size_t count, size_t threads = 1) : count(count)
+		{
+			while(((count + (size_t{1} << levels) - 1) >> levels) > maxLeafSize)
+				++levels;
+
+			struct Item
+			{
+				Vector<DIM, T> p;
+				uint32_t index;
+			};
+			detail::AlignedVector<Item> items(count);
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					items[i] = {points[i], uint32_t(i)};
+			});
+
+			const size_t inner = (size_t{1} << levels) - 1;
+			splits.resize(inner);
+			axes.resize(inner);
+			for(unsigned level = 0; level < levels; ++level)
+			{
+				detail::parallelFor(size_t{1} << level, threads, [&](size_t first, size_t last) {
+					for(size_t k = first; k < last; ++k)
+					{
+						const size_t begin = rangeBegin(level, k), end = rangeBegin(level, k + 1);
+						const size_t mid = rangeBegin(level + 1, 2 * k + 1);
+
+						Vector<DIM, T> min = items[begin].p, max = items[begin].p;
+						for(size_t i = begin; i < end; ++i)
+							for(size_t a = 0; a < DIM; ++a)
+							{
+								min[a] = std::min(min[a], items[i].p[a]);
+								max[a] = std::max(max[a], items[i].p[a]);
+							}
+						uint8_t axis = 0;
+						for(uint8_t a = 1; a < DIM; ++a)
+							if(max[a] - min[a] > max[axis] - min[axis])
+								axis = a;
+
+						std::nth_element(items.begin() + begin,
+										 items.begin() + mid,
+										 items.begin() + end,
+										 [axis](const Item &l, const Item &r) { return l.p[axis] < r.p[axis]; });
+						const size_t node = (size_t{1} << level) - 1 + k;
+						splits[node] = items[mid].p[axis];
+						axes[node] = axis;
+					}
+				});
+			}
+
+			for(auto &c : coords)
+				c.resize(count);
+			order.resize(count);
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+				{
+					for(size_t a = 0; a < DIM; ++a)
+						coords[a][i] = items[i].p[a];
+					order[i] = items[i].index;
+				}
+			});
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		// Original index of every point in tree order.
+		const std::vector<uint32_t> &indices() const
+		{
+			return order;
+		}
+
+		// The k nearest points, sorted by distance. indices and squaredDistances need room for k entries; returns
+		// how many were found, which is less than k only for small trees. Points farther than maxDistance are
+		// ignored.
+		size_t nearest(const Vector<DIM, T> &query,
+					   size_t k,
+					   uint32_t *indices,
+					   T *squaredDistances,
+					   T maxDistance = std::numeric_limits<T>::infinity()) const
+		{
+			if(k == 0)
+				return 0;
+			size_t found = 0;
+			T worst = maxDistance * maxDistance;
+			search(query, [&] { return found == k ? squaredDistances[k - 1] : worst; }, [&](size_t i, T d) {
+				// Insertion into the sorted result, k is small in practice.
+				size_t j = found < k ? found++ : k - 1;
+				for(; j > 0 && squaredDistances[j - 1] > d; --j)
+				{
+					squaredDistances[j] = squaredDistances[j - 1];
+					indices[j] = indices[j - 1];
+				}
+				squaredDistances[j] = d;
+				indices[j] = order[i];
+			});
+			return found;
+		}
+
+		// Calls f(index, squaredDistance) for every point closer than radius to query, in no particular order.
+		template <typename Function>
+		void radius(const Vector<DIM, T> &query, T radius, Function &&f) const
+		{
+			const T r2 = radius * radius;
+			search(query, [r2] { return r2; }, [&](size_t i, T d) { f(order[i], d); });
+		}
+
+		// k nearest neighbours of many queries: row i of indices and squaredDistances (k entries each) belongs to
+		// queries[i]. Rows with fewer than k neighbours are padded with none and infinity.
+		void nearest(const Vector<DIM, T> *queries,
+					 size_t queryCount,
+					 size_t k,
+					 uint32_t *indices,
+					 T *squaredDistances,
+					 size_t threads = 1,
+					 T maxDistance = std::numeric_limits<T>::infinity()) const
+		{
+			detail::parallelFor(queryCount, threads, [&](size_t begin, size_t end) {
+				for(size_t q = begin; q < end; ++q)
+				{
+					uint32_t *row = indices + q * k;
+					T *rowDistances = squaredDistances + q * k;
+					const size_t found = nearest(queries[q], k, row, rowDistances, maxDistance);
+					std::fill(row + found, row + k, none);
+					std::fill(rowDistances + found, rowDistances + k, std::numeric_limits<T>::infinity());
+				}
+			});
+		}
+
+		// Radius queries for many points, f(query, index, squaredDistance) is called concurrently from all threads.
+		template <typename Function>
+		void radius(const Vector<DIM, T> *queries, size_t queryCount, T radius, Function &&f, size_t threads = 1) const
+		{
+			detail::parallelFor(queryCount, threads, [&](size_t begin, size_t end) {
+				for(size_t q = begin; q < end; ++q)
+					this->radius(queries[q], radius, [&](uint32_t index, T d) { f(q, index, d); });
+			});
+		}
+
+		private:
+		size_t rangeBegin(unsigned level, size_t k) const
+		{
+			return size_t((uint64_t(k) * count) >> level);
+		}
+
+		// Depth first, nearer child first. bound() is the current squared search radius, visit(i, d) is called for
+		// every point in tree order i with squared distance d < bound().
+		template <typename Bound, typename Visit>
+		void search(const Vector<DIM, T> &query, Bound &&bound, Visit &&visit) const
+		{
+			if(count == 0)
+				return;
+
+			struct Entry
+			{
+				size_t node;
+				unsigned level;
+				T distance;
+			};
+			Entry stack[64];
+			size_t top = 0;
+			stack[top++] = {0, 0, T{0}};
+			while(top != 0)
+			{
+				const Entry e = stack[--top];
+				if(e.distance >= bound())
+					continue;
+
+				if(e.level == levels)
+				{
+					const size_t leaf = e.node - ((size_t{1} << levels) - 1);
+					scanLeaf(query, rangeBegin(levels, leaf), rangeBegin(levels, leaf + 1), bound, visit);
+					continue;
+				}
+
+				const T d = query[axes[e.node]] - splits[e.node];
+				const size_t left = 2 * e.node + 1;
+				const size_t nearChild = d < T{0} ? left : left + 1;
+				stack[top++] = {(left + left + 1) - nearChild, e.level + 1, std::max(e.distance, d * d)};
+				stack[top++] = {nearChild, e.level + 1, e.distance};
+			}
+		}
+
+		template <typename Bound, typename Visit>
+		void scanLeaf(const Vector<DIM, T> &query, size_t begin, size_t end, Bound &&bound, Visit &&visit) const
+		{
+			const size_t n = end - begin;
+			T distance[maxLeafSize] = {};
+			for(size_t a = 0; a < DIM; ++a)
+			{
+				const T *c = coords[a].data() + begin;
+				const T q = query[a];
+				for(size_t i = 0; i < n; ++i)
+				{
+					const T d = c[i] - q;
+					distance[i] += d * d;
+				}
+			}
+			for(size_t i = 0; i < n; ++i)
+				if(distance[i] < bound())
+					visit(begin + i, distance[i]);
+		}
+
+		size_t count = 0;
+		unsigned levels = 0;
+		std::vector<T> splits;
+		std::vector<uint8_t> axes;
+		std::vector<T> coords[DIM];
+		std::vector<uint32_t> order;
+	};
+
+	template <size_t DIM, typename T>
+	constexpr uint32_t KdTree<DIM, T>::none;
+
+	template <size_t DIM, typename T>
+	constexpr size_t KdTree<DIM, T>::maxLeafSize;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef LMI_MESH_H
+#define LMI_MESH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/quaternion.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Triangles around every vertex as compressed sparse rows: the corners of vertex v are
+	// corners()[offsets()[v], offsets()[v + 1]), a corner being 3 * triangle + index within the triangle. Built
+	// once per topology, it turns the per vertex accumulation of face attributes into a gather that runs in
+	// parallel over vertices without atomics or per thread buffers, and in a fixed order.
+	class VertexAdjacency
+	{
+		public:
+		VertexAdjacency() = default;
+
+		VertexAdjacency(const uint32_t *indices, size_t triangleCount, size_t vertexCount)
+			: offsetStorage(vertexCount + 1), cornerStorage(3 * triangleCount)
+		{
+			for(size_t c = 0; c < 3 * triangleCount; ++c)
+				++offsetStorage[indices[c] + 1];
+			for(size_t v = 0; v < vertexCount; ++v)
+				offsetStorage[v + 1] += offsetStorage[v];
+			std::vector<uint32_t> cursor(offsetStorage.begin(), offsetStorage.end() - 1);
+			for(size_t c = 0; c < 3 * triangleCount; ++c)
+				cornerStorage[cursor[indices[c]]++] = uint32_t(c);
+		}
+
+		size_t vertexCount() const
+		{
+			return offsetStorage.empty() ? 0 : offsetStorage.size() - 1;
+		}
+
+		const std::vector<uint32_t> &offsets() const
+		{
+			return offsetStorage;
+		}
+
+		const std::vector<uint32_t> &corners() const
+		{
+			return cornerStorage;
+		}
+
+		private:
+		std::vector<uint32_t> offsetStorage, cornerStorage;
+	};
+
+	enum class NormalWeighting
+	{
+		Area,	// Face normals weighted by triangle area, cheapest.
+		Angle	// Weighted by the corner angle, independent of how the faces around a vertex are triangulated.
+	};
+
+	namespace detail
+	{
+		// Weighted normal contribution of one triangle corner. The unnormalized cross product is twice the area
+		// times the unit normal.
+		template <typename T>
+		Vector<3, T> cornerNormal(const Vector<3, T> *positions,
+								  const uint32_t *indices,
+								  uint32_t corner,
+								  NormalWeighting weighting)
+		{
+			const uint32_t first = corner - corner % 3;
+			const Vector<3, T> &p = positions[indices[corner]];
+			const Vector<3, T> e1 = positions[indices[first + (corner + 1) % 3]] - p;
+			const Vector<3, T> e2 = positions[indices[first + (corner + 2) % 3]] - p;
+			const Vector<3, T> n = cross(e1, e2);
+			if(weighting == NormalWeighting::Area)
+				return n;
+			const T sinLength = length(n);
+			return sinLength > T{0} ? n * (std::atan2(sinLength, dot(e1, e2)) / sinLength) : Vector<3, T>();
+		}
+
+		template <typename T>
+		Vector<3, T> normalizeOrZero(const Vector<3, T> &v)
+		{
+			const T l = length(v);
+			return l > T{0} ? v / l : Vector<3, T>();
+		}
+	}
+
+	// Vertex normals of an indexed triangle list with counter clockwise front faces. Vertices without any non
+	// degenerate triangle get a zero normal.
+	template <typename T>
+	void computeNormals(const Vector<3, T> *positions,
+						const uint32_t *indices,
+						const VertexAdjacency &adjacency,
+						Vector<3, T> *normals,
+						NormalWeighting weighting = NormalWeighting::Area,
+						size_t threads = 1)
+	{
+		const uint32_t *offsets = adjacency.offsets().data(), *corners = adjacency.corners().data();
+		detail::parallelFor(adjacency.vertexCount(), threads, [&](size_t begin, size_t end) {
+			for(size_t v = begin; v < end; ++v)
+			{
+				Vector<3, T> n;
+				for(uint32_t c = offsets[v]; c < offsets[v + 1]; ++c)
+					n += detail::cornerNormal(positions, indices, corners[c], weighting);
+				normals[v] = detail::normalizeOrZero(n);
+			}
+		});
+	}
+
+	// Convenience overload that builds the adjacency, keep a VertexAdjacency around when the topology is reused.
+	template <typename T>
+	void computeNormals(const Vector<3, T> *positions,
+						size_t vertexCount,
+						const uint32_t *indices,
+						size_t triangleCount,
+						Vector<3, T> *normals,
+						NormalWeighting weighting = NormalWeighting::Area,
+						size_t threads = 1)
+	{
+		computeNormals(positions, indices, VertexAdjacency(indices, triangleCount, vertexCount), normals, weighting,
+					   threads);
+	}
+
+	// Tangent frames following MikkTSpace: per corner the triangle's dP/du is projected into the tangent plane of
+	// the vertex normal, normalized and accumulated weighted by the corner angle in that plane. The result is
+	// orthogonalized against the normal, and the bitangent is handedness * cross(normal, tangent) with the
+	// handedness (+1 or -1, in w) taken from the winding of the UV triangles. This reproduces MikkTSpace exactly on
+	// meshes that are already split at UV seams and mirroring boundaries; MikkTSpace would split vertices whose
+	// triangles disagree in handedness, here the angle weighted majority wins.
+	template <typename T>
+	void computeTangents(const Vector<3, T> *positions,
+						 const Vector<3, T> *normals,
+						 const Vector<2, T> *uvs,
+						 const uint32_t *indices,
+						 const VertexAdjacency &adjacency,
+						 Vector<4, T> *tangents,
+						 size_t threads = 1)
+	{
+		const uint32_t *offsets = adjacency.offsets().data(), *corners = adjacency.corners().data();
+		detail::parallelFor(adjacency.vertexCount(), threads, [&](size_t begin, size_t end) {
+			for(size_t v = begin; v < end; ++v)
+			{
+				const Vector<3, T> n = normals[v];
+				auto project = [&n](const Vector<3, T> &x) { return x - n * dot(n, x); };
+
+				Vector<3, T> tangent;
+				T orientation = 0;
+				for(uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+				{
+					const uint32_t corner = corners[i], first = corner - corner % 3;
+					const uint32_t i0 = indices[corner], i1 = indices[first + (corner + 1) % 3],
+								   i2 = indices[first + (corner + 2) % 3];
+					const Vector<3, T> e1 = positions[i1] - positions[i0], e2 = positions[i2] - positions[i0];
+					const Vector<2, T> d1 = uvs[i1] - uvs[i0], d2 = uvs[i2] - uvs[i0];
+					const T det = d1[0] * d2[1] - d1[1] * d2[0];
+					const T sign = det < T{0} ? T{-1} : T{1};
+
+					const Vector<3, T> faceTangent = detail::normalizeOrZero(project((e1 * d2[1] - e2 * d1[1]) * sign));
+					const Vector<3, T> p1 = detail::normalizeOrZero(project(e1));
+					const Vector<3, T> p2 = detail::normalizeOrZero(project(e2));
+					const T angle = std::acos(std::min(std::max(dot(p1, p2), T{-1}), T{1}));
+					tangent += faceTangent * angle;
+					orientation += det == T{0} ? T{0} : sign * angle;
+				}
+
+				Vector<3, T> t = detail::normalizeOrZero(project(tangent));
+				if(t == Vector<3, T>())
+				{
+					// No usable UVs: any unit vector perpendicular to the normal.
+					const Vector<3, T> axis = std::abs(n[0]) < T(0.9) ? Vector<3, T>(1, 0, 0) : Vector<3, T>(0, 1, 0);
+					t = detail::normalizeOrZero(project(axis));
+				}
+				tangents[v] = Vector<4, T>(t[0], t[1], t[2], orientation < T{0} ? T{-1} : T{1});
+			}
+		});
+	}
+
+	// ==================== Quaternion tangent frames ====================
+	// A tangent frame (tangent, bitangent, normal) stored as the rotation taking x to the tangent and z to the
+	// normal, 4 values instead of 7. The handedness is the sign of w: q and -q are the same rotation, so the encoder
+	// makes w positive for right handed frames and negative for mirrored ones. w is kept at least bias away from zero
+	// so the sign survives quantization, the default suits 16 bit snorm storage.
+
+	template <typename T>
+	Quaternion<T> encodeTangentFrame(const Vector<3, T> &normal,
+									 const Vector<4, T> &tangent,
+									 T bias = T{1} / T{32767})
+	{
+		const Vector<3, T> t(tangent[0], tangent[1], tangent[2]);
+		const Vector<3, T> b = cross(normal, t);
+		Matrix<3, 3, T> frame;
+		frame[0] = t;
+		frame[1] = b;
+		frame[2] = normal;
+		Quaternion<T> q = normalize(Quaternion<T>(frame));
+		if(q[0] < T{0})
+			q = -q;
+		if(q[0] < bias)
+		{
+			const T scale = std::sqrt(1 - bias * bias) / length(vectorPart(q));
+			q = Quaternion<T>(bias, q[1] * scale, q[2] * scale, q[3] * scale);
+		}
+		return tangent[3] < T{0} ? -q : q;
+	}
+
+	// Normal in the result, tangent and handedness in the out parameter.
+	template <typename T>
+	Vector<3, T> decodeTangentFrame(const Quaternion<T> &q, Vector<4, T> &tangent)
+	{
+		const Matrix<3, 3, T> frame(q);
+		tangent = Vector<4, T>(frame[0][0], frame[0][1], frame[0][2], q[0] < T{0} ? T{-1} : T{1});
+		return frame[2];
+	}
+
+	// Batch encoding of whole vertex streams.
+	template <typename T>
+	void encodeTangentFrames(const Vector<3, T> *normals,
+							 const Vector<4, T> *tangents,
+							 Quaternion<T> *frames,
+							 size_t count,
+							 size_t threads = 1)
+	{
+		detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+				frames[i] = encodeTangentFrame(normals[i], tangents[i]);
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef LMI_OCCLUSION_H
+#define LMI_OCCLUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/math.h"
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "bounds.h"
+#include "projection.h"
+#include "vertex_pipeline.h"
+
+namespace lmi
+{
+	// Software depth buffer for occlusion culling without a GPU. Occluder triangles are transformed with
+	// VertexPipeline, set up and binned into tiles of tileSize^2 pixels in parallel, and every tile is then
+	// rasterized by one thread with edge functions evaluated over whole pixel rows in branch free, vectorized
+	// loops. After rasterization each tile records the farthest depth of every block of blockSize^2 pixels, and box
+	// queries test against those block maxima before looking at individual pixels.
+	//
+	// Depth grows with distance (reverse-Z projections are flipped on the way in), the buffer is meant to be small,
+	// e.g. 320 x 192. Coverage follows the top left rule, so triangles sharing an edge leave neither cracks nor
+	// double coverage. Occluders crossing the near plane are dropped instead of clipped, which only ever
+	// underestimates occlusion. Triangles are front facing when counter clockwise.
+	template <typename T = float>
+	class OcclusionBuffer
+	{
+		public:
+		static constexpr size_t tileSize = 32;
+		static constexpr size_t blockSize = 8;
+
+		OcclusionBuffer(size_t width,
+						size_t height,
+						DepthRange depthRange = DepthRange::NegativeOneToOne,
+						bool reverseZ = false)
+			: w(width),
+			  h(height),
+			  tilesX((width + tileSize - 1) / tileSize),
+			  tilesY((height + tileSize - 1) / tileSize),
+			  blocksX((width + blockSize - 1) / blockSize),
+			  depthRange(depthRange),
+			  reverseZ(reverseZ),
+			  depthBuffer(width * height),
+			  blockMax(blocksX * ((height + blockSize - 1) / blockSize))
+		{
+			clear();
+		}
+
+		size_t width() const
+		{
+			return w;
+		}
+
+		size_t height() const
+		{
+			return h;
+		}
+
+		// Row major, row 0 at the bottom, depth in [0, 1] growing with distance.
+		const T *depth() const
+		{
+			return depthBuffer.data();
+		}
+
+		void clear()
+		{
+			std::fill(depthBuffer.begin(), depthBuffer.end(), T{1});
+			std::fill(blockMax.begin(), blockMax.end(), T{1});
+		}
+
+		// Adds indexed occluder triangles to the buffer.
+		void render(const Vector<3, T> *vertices,
+					size_t vertexCount,
+					const uint32_t *indices,
+					size_t triangleCount,
+					const Matrix<4, 4, T> &modelViewProjection,
+					size_t threads = 1)
+		{
+			threads = detail::resolveThreadCount(threads);
+			screen.resize(vertexCount);
+			outcodes.resize(vertexCount);
+			VertexStreams<T> streams;
+			streams.screen = screen.data();
+			streams.outcodes = outcodes.data();
+			pipeline(modelViewProjection).process(vertices, vertexCount, streams, threads);
+
+			// Setup and binning, with one list per chunk and tile so the chunks never share a list.
+			const size_t tiles = tilesX * tilesY;
+			const size_t chunks = std::max(detail::chunkCount(triangleCount, threads), size_t{1});
+			setups.resize(triangleCount);
+			bins.resize(chunks * tiles);
+			for(auto &bin : bins)
+				bin.clear();
+			detail::parallelChunks(triangleCount, threads, [&](size_t chunk, size_t begin, size_t end) {
+				for(size_t t = begin; t < end; ++t)
+				{
+					if(!setup(indices + 3 * t, setups[t]))
+						continue;
+					const Setup &s = setups[t];
+					for(size_t ty = s.minY / tileSize; ty <= (s.maxY - 1) / tileSize; ++ty)
+						for(size_t tx = s.minX / tileSize; tx <= (s.maxX - 1) / tileSize; ++tx)
+							bins[chunk * tiles + ty * tilesX + tx].push_back(uint32_t(t));
+				}
+			});
+
+			detail::parallelFor(tiles, threads, [&](size_t begin, size_t end) {
+				for(size_t tile = begin; tile < end; ++tile)
+				{
+					for(size_t chunk = 0; chunk < chunks; ++chunk)
+						for(uint32_t t : bins[chunk * tiles + tile])
+							rasterize(setups[t], tile);
+					updateBlocks(tile);
+				}
+			});
+		}
+
+		// False if the box is outside the viewport or every pixel it covers has a nearer occluder. Boxes crossing
+		// the near plane are always visible. The eight corners are transformed and classified as VertexPipeline
+		// would, without its setup for a whole batch.
+		bool visible(const Aabb<T> &box, const Matrix<4, 4, T> &viewProjection) const
+		{
+			const Matrix<4, 4, T> &m = viewProjection;
+			const bool negativeOne = depthRange == DepthRange::NegativeOneToOne;
+			const T near = reverseZ ? T{1} : T{0}, far = reverseZ ? T{0} : T{1};
+			const T depthScale = (far - near) / (negativeOne ? T{2} : T{1});
+			const T depthOffset = near + (negativeOne ? depthScale : T{0}), nearScale = negativeOne ? T{-1} : T{0};
+			const T halfWidth = T(w) / 2, halfHeight = T(h) / 2;
+
+			Vector<3, T> projected[8];
+			unsigned allCodes = 0x3f, anyCodes = 0;
+			for(size_t i = 0; i < 8; ++i)
+			{
+				const T px = i & 1 ? box.max[0] : box.min[0];
+				const T py = i & 2 ? box.max[1] : box.min[1];
+				const T pz = i & 4 ? box.max[2] : box.min[2];
+				const T x = m[0][0] * px + m[1][0] * py + m[2][0] * pz + m[3][0];
+				const T y = m[0][1] * px + m[1][1] * py + m[2][1] * pz + m[3][1];
+				const T z = m[0][2] * px + m[1][2] * py + m[2][2] * pz + m[3][2];
+				const T cw = m[0][3] * px + m[1][3] * py + m[2][3] * pz + m[3][3];
+				const unsigned code = unsigned(x < -cw) * OutsideLeft | unsigned(x > cw) * OutsideRight |
+									  unsigned(y < -cw) * OutsideBottom | unsigned(y > cw) * OutsideTop |
+									  unsigned(z < nearScale * cw) * OutsideNear | unsigned(z > cw) * OutsideFar;
+				allCodes &= code;
+				anyCodes |= code;
+
+				const T invW = T{1} / cw;
+				projected[i] = Vector<3, T>(halfWidth + x * invW * halfWidth,
+											halfHeight + y * invW * halfHeight,
+											depthOffset + z * invW * depthScale);
+			}
+			if(allCodes != 0)
+				return false;
+			if(anyCodes & nearBit())
+				return true;
+
+			T minX = projected[0][0], maxX = minX, minY = projected[0][1], maxY = minY, nearest = projected[0][2];
+			for(const auto &c : projected)
+			{
+				minX = std::min(minX, c[0]), maxX = std::max(maxX, c[0]);
+				minY = std::min(minY, c[1]), maxY = std::max(maxY, c[1]);
+				nearest = std::min(nearest, c[2]);
+			}
+			const size_t x0 = size_t(std::max(std::floor(minX), T{0})), x1 = size_t(std::min(std::ceil(maxX), T(w)));
+			const size_t y0 = size_t(std::max(std::floor(minY), T{0})), y1 = size_t(std::min(std::ceil(maxY), T(h)));
+			if(x0 >= x1 || y0 >= y1)
+				return false;
+
+			for(size_t by = y0 / blockSize; by <= (y1 - 1) / blockSize; ++by)
+				for(size_t bx = x0 / blockSize; bx <= (x1 - 1) / blockSize; ++bx)
+				{
+					if(nearest > blockMax[by * blocksX + bx])
+						continue;
+					for(size_t y = std::max(y0, by * blockSize); y < std::min(y1, (by + 1) * blockSize); ++y)
+					{
+						const T *row = depthBuffer.data() + y * w;
+						unsigned any = 0;
+						for(size_t x = std::max(x0, bx * blockSize); x < std::min(x1, (bx + 1) * blockSize); ++x)
+							any |= unsigned(nearest <= row[x]);
+						if(any)
+							return true;
+					}
+				}
+			return false;
+		}
+
+		void visible(const Aabb<T> *boxes,
+					 size_t count,
+					 const Matrix<4, 4, T> &viewProjection,
+					 uint8_t *result,
+					 size_t threads = 1) const
+		{
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					result[i] = uint8_t(visible(boxes[i], viewProjection));
+			});
+		}
+
+		private:
+		// Edge functions e = a * x + b * y + c at pixel centers, positive inside, and the depth plane.
+		struct Setup
+		{
+			T a[3], b[3], c[3];
+			bool inclusive[3];	// Top left edges, which own the pixel centers exactly on them.
+			T z, dzdx, dzdy;
+			size_t minX, minY, maxX, maxY;	// Pixel bounds, max exclusive.
+		};
+
+		VertexPipeline<T> pipeline(const Matrix<4, 4, T> &m) const
+		{
+			const T near = reverseZ ? T{1} : T{0}, far = reverseZ ? T{0} : T{1};
+			const Matrix<4, 4, T> identity(T{1});
+			return VertexPipeline<T>(identity, identity, m, Viewport<T>{T{0}, T{0}, T(w), T(h), near, far}, depthRange);
+		}
+
+		uint8_t nearBit() const
+		{
+			return reverseZ ? OutsideFar : OutsideNear;
+		}
+
+		bool setup(const uint32_t *tri, Setup &s) const
+		{
+			const uint8_t c0 = outcodes[tri[0]], c1 = outcodes[tri[1]], c2 = outcodes[tri[2]];
+			if((c0 & c1 & c2) != 0 || ((c0 | c1 | c2) & nearBit()) != 0)
+				return false;
+
+			const Vector<3, T> &p0 = screen[tri[0]], &p1 = screen[tri[1]], &p2 = screen[tri[2]];
+			const T area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+			if(!(area > T{0}))
+				return false;
+
+			const T fx[2] = {std::min({p0[0], p1[0], p2[0]}), std::max({p0[0], p1[0], p2[0]})};
+			const T fy[2] = {std::min({p0[1], p1[1], p2[1]}), std::max({p0[1], p1[1], p2[1]})};
+			s.minX = size_t(std::max(std::floor(fx[0]), T{0}));
+			s.minY = size_t(std::max(std::floor(fy[0]), T{0}));
+			s.maxX = size_t(std::min(std::ceil(fx[1]), T(w)));
+			s.maxY = size_t(std::min(std::ceil(fy[1]), T(h)));
+			if(s.minX >= s.maxX || s.minY >= s.maxY)
+				return false;
+
+			const Vector<3, T> *p[3] = {&p0, &p1, &p2};
+			for(size_t e = 0; e < 3; ++e)
+			{
+				const Vector<3, T> &from = *p[e], &to = *p[(e + 1) % 3];
+				s.a[e] = from[1] - to[1];
+				s.b[e] = to[0] - from[0];
+				s.c[e] = -(s.a[e] * from[0] + s.b[e] * from[1]);
+				s.inclusive[e] = s.a[e] > T{0} || (s.a[e] == T{0} && s.b[e] < T{0});
+			}
+			s.dzdx = ((p1[2] - p0[2]) * (p2[1] - p0[1]) - (p2[2] - p0[2]) * (p1[1] - p0[1])) / area;
+			s.dzdy = ((p2[2] - p0[2]) * (p1[0] - p0[0]) - (p1[2] - p0[2]) * (p2[0] - p0[0])) / area;
+			s.z = p0[2] - s.dzdx * p0[0] - s.dzdy * p0[1];
+			return true;
+		}
+
+		void rasterize(const Setup &s, size_t tile)
+		{
+			const size_t x0 = std::max(s.minX, tile % tilesX * tileSize);
+			const size_t x1 = std::min(s.maxX, std::min(x0 - x0 % tileSize + tileSize, w));
+			const size_t y0 = std::max(s.minY, tile / tilesX * tileSize);
+			const size_t y1 = std::min(s.maxY, std::min(y0 - y0 % tileSize + tileSize, h));
+			for(size_t y = y0; y < y1; ++y)
+			{
+				const T py = T(y) + T(0.5);
+				const T r0 = s.b[0] * py + s.c[0], r1 = s.b[1] * py + s.c[1], r2 = s.b[2] * py + s.c[2];
+				const T rz = s.dzdy * py + s.z;
+				const bool i0 = s.inclusive[0], i1 = s.inclusive[1], i2 = s.inclusive[2];
+				T *row = depthBuffer.data() + y * w;
+				for(size_t x = x0; x < x1; ++x)
+				{
+					const T px = T(x) + T(0.5);
+					const T e0 = s.a[0] * px + r0, e1 = s.a[1] * px + r1, e2 = s.a[2] * px + r2;
+					const bool inside = ((e0 > T{0}) | ((e0 == T{0}) & i0)) & ((e1 > T{0}) | ((e1 == T{0}) & i1)) &
+										((e2 > T{0}) | ((e2 == T{0}) & i2));
+					const T z = s.dzdx * px + rz;
+					row[x] = std::min(row[x], detail::math::select(inside, z, row[x]));
+				}
+			}
+		}
+
+		void updateBlocks(size_t tile)
+		{
+			const size_t bx0 = tile % tilesX * (tileSize / blockSize), by0 = tile / tilesX * (tileSize / blockSize);
+			for(size_t by = by0; by < by0 + tileSize / blockSize && by * blockSize < h; ++by)
+				for(size_t bx = bx0; bx < bx0 + tileSize / blockSize && bx * blockSize < w; ++bx)
+				{
+					T farthest = T{0};
+					for(size_t y = by * blockSize; y < std::min((by + 1) * blockSize, h); ++y)
+						for(size_t x = bx * blockSize; x < std::min((bx + 1) * blockSize, w); ++x)
+							farthest = std::max(farthest, depthBuffer[y * w + x]);
+					blockMax[by * blocksX + bx] = farthest;
+				}
+		}
+
+		size_t w, h, tilesX, tilesY, blocksX;
+		DepthRange depthRange;
+		bool reverseZ;
+		std::vector<T> depthBuffer, blockMax;
+
+		// Per frame scratch, kept to avoid reallocation.
+		detail::AlignedVector<Vector<3, T>> screen;
+		std::vector<uint8_t> outcodes;
+		std::vector<Setup> setups;
+		std::vector<std::vector<uint32_t>> bins;
+	};
+
+	template <typename T>
+	constexpr size_t OcclusionBuffer<T>::tileSize;
+
+	template <typename T>
+	constexpr size_t OcclusionBuffer<T>::blockSize;
+}
+
+#endif
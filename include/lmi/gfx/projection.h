@@ -1,24 +1,204 @@
 #ifndef LMI_PROJECTION_H
 #define LMI_PROJECTION_H
 
+#include "../detail/constexpr_math.h"
 #include "../detail/matrix.h"
+#include "ray.h"
 #include <cmath>
 #include <limits>
 
 namespace lmi
 {
+	// Range of z / w after projection. OpenGL uses [-1, 1]; Direct3D, Vulkan and reverse-Z use [0, 1].
+	enum class DepthRange
+	{
+		NegativeOneToOne,
+		ZeroToOne
+	};
+
+	template <typename T>
+	constexpr Matrix<4, 4, T> perspective(T fovy, T aspect, T zNear, T zFar = std::numeric_limits<T>::infinity())
+	{
+		auto tanHalfFovy = lmi::tan(fovy / T{2});
+		const bool infinite = zFar == std::numeric_limits<T>::infinity();
+		const T c = infinite ? T{-1} : -(zFar + zNear) / (zFar - zNear);
+		const T d = infinite ? -T{2} * zNear : -(T{2} * zFar * zNear) / (zFar - zNear);
+
+		// clang-format off
+		return {1 / (aspect * tanHalfFovy),  0,               0,  0,
+				0,                           1 / tanHalfFovy, 0,  0,
+				0,                           0,               c,  d,
+				0,                           0,               -1, 0};
+		// clang-format on
+	}
+
+	// Reverse-Z perspective: maps zNear to depth 1 and zFar to depth 0 (DepthRange::ZeroToOne), which spreads the
+	// floating point precision evenly over the view distance. zFar may be infinite.
+	template <typename T>
+	constexpr Matrix<4, 4, T>
+	perspectiveReverseZ(T fovy, T aspect, T zNear, T zFar = std::numeric_limits<T>::infinity())
+	{
+		auto tanHalfFovy = lmi::tan(fovy / T{2});
+		const bool infinite = zFar == std::numeric_limits<T>::infinity();
+		const T c = infinite ? T{0} : zNear / (zFar - zNear);
+		const T d = infinite ? zNear : zFar * zNear / (zFar - zNear);
+
+		// clang-format off
+		return {1 / (aspect * tanHalfFovy),  0,               0,  0,
+				0,                           1 / tanHalfFovy, 0,  0,
+				0,                           0,               c,  d,
+				0,                           0,               -1, 0};
+		// clang-format on
+	}
+
+	// Off-center perspective, the bounds are given on the near plane (glFrustum).
 	template <typename T>
-	Matrix<4, 4, T> perspective(T fovy, T aspect, T zNear, T zFar = std::numeric_limits<T>::infinity())
+	constexpr Matrix<4, 4, T> frustum(T left, T right, T bottom, T top, T zNear, T zFar)
 	{
-		auto tanHalfFovy = std::tan(fovy / T{2});
-		
+		const T a = (right + left) / (right - left);
+		const T b = (top + bottom) / (top - bottom);
+		const T c = -(zFar + zNear) / (zFar - zNear);
+		const T d = -(T{2} * zFar * zNear) / (zFar - zNear);
+
 		// clang-format off
-		return {1 / (aspect * tanHalfFovy),  0,               0,                                0,
-				0,                           1 / tanHalfFovy, 0,                                0,
-				0,                           0,               -(zFar + zNear) / (zFar - zNear), -(T{2} * zFar * zNear) / (zFar - zNear),
-				0,                           0,               -1,                               0};
+		return {T{2} * zNear / (right - left), 0,                             a,  0,
+				0,                             T{2} * zNear / (top - bottom), b,  0,
+				0,                             0,                             c,  d,
+				0,                             0,                             -1, 0};
 		// clang-format on
 	}
+
+	template <typename T>
+	constexpr Matrix<4, 4, T> orthographic(T left, T right, T bottom, T top, T zNear, T zFar)
+	{
+		// clang-format off
+		return {T{2} / (right - left), 0,                     0,                      -(right + left) / (right - left),
+				0,                     T{2} / (top - bottom), 0,                      -(top + bottom) / (top - bottom),
+				0,                     0,                     -T{2} / (zFar - zNear), -(zFar + zNear) / (zFar - zNear),
+				0,                     0,                     0,                      1};
+		// clang-format on
+	}
+
+	// A projection matrix bundled with its analytic inverse. All supported projections are sparse enough that the
+	// inverse is a handful of divisions, so unprojecting and generating view rays never needs inverse(mat4).
+	template <typename T = float>
+	class Projection
+	{
+		public:
+		static constexpr Projection perspective(T fovy, T aspect, T zNear, T zFar = std::numeric_limits<T>::infinity())
+		{
+			return fromPerspective(lmi::perspective(fovy, aspect, zNear, zFar), T{-1}, T{1});
+		}
+
+		static constexpr Projection
+		perspectiveReverseZ(T fovy, T aspect, T zNear, T zFar = std::numeric_limits<T>::infinity())
+		{
+			return fromPerspective(lmi::perspectiveReverseZ(fovy, aspect, zNear, zFar), T{1}, T{0});
+		}
+
+		static constexpr Projection frustum(T left, T right, T bottom, T top, T zNear, T zFar)
+		{
+			return fromPerspective(lmi::frustum(left, right, bottom, top, zNear, zFar), T{-1}, T{1});
+		}
+
+		static constexpr Projection orthographic(T left, T right, T bottom, T top, T zNear, T zFar)
+		{
+			Projection p;
+			p.m = lmi::orthographic(left, right, bottom, top, zNear, zFar);
+			p.inv = Matrix<4, 4, T>(T{1});
+			for(size_t i = 0; i < 3; ++i)
+			{
+				p.inv[i][i] = 1 / p.m[i][i];
+				p.inv[3][i] = -p.m[3][i] / p.m[i][i];
+			}
+			p.nearDepth = T{-1};
+			p.farDepth = T{1};
+			return p;
+		}
+
+		constexpr const Matrix<4, 4, T> &matrix() const
+		{
+			return m;
+		}
+
+		constexpr const Matrix<4, 4, T> &inverse() const
+		{
+			return inv;
+		}
+
+		constexpr DepthRange depthRange() const
+		{
+			return nearDepth < T{0} ? DepthRange::NegativeOneToOne : DepthRange::ZeroToOne;
+		}
+
+		// Normalized device coordinates to view space.
+		constexpr Vector<3, T> unproject(const Vector<3, T> &ndc) const
+		{
+			const Vector<4, T> p = unprojectHomogeneous(ndc[0], ndc[1], ndc[2]);
+			return Vector<3, T>(p[0], p[1], p[2]) / p[3];
+		}
+
+		// View space ray through a point in normalized device coordinates, starting on the near plane. The direction
+		// is normalized and also well defined for an infinite far plane.
+		constexpr Ray<T> ray(const Vector<2, T> &ndc) const
+		{
+			const Vector<4, T> pNear = unprojectHomogeneous(ndc[0], ndc[1], nearDepth);
+			const Vector<4, T> pFar = unprojectHomogeneous(ndc[0], ndc[1], farDepth);
+
+			Ray<T> res;
+			res.origin = Vector<3, T>(pNear[0], pNear[1], pNear[2]) / pNear[3];
+			res.direction = normalize(Vector<3, T>(pFar[0] * pNear[3] - pNear[0] * pFar[3],
+												   pFar[1] * pNear[3] - pNear[1] * pFar[3],
+												   pFar[2] * pNear[3] - pNear[2] * pFar[3]));
+			return res;
+		}
+
+		void unproject(const Vector<3, T> *ndc, Vector<3, T> *out, size_t count) const
+		{
+			for(size_t i = 0; i < count; ++i)
+				out[i] = unproject(ndc[i]);
+		}
+
+		void ray(const Vector<2, T> *ndc, Ray<T> *out, size_t count) const
+		{
+			for(size_t i = 0; i < count; ++i)
+				out[i] = ray(ndc[i]);
+		}
+
+		private:
+		// Every perspective matrix here has the form
+		//     [a 0 e 0]              [1/a 0   0   e/a]
+		//     [0 b f 0]  with the    [0   1/b 0   f/b]
+		//     [0 0 c d]  inverse     [0   0   0   -1 ]
+		//     [0 0 -1 0]             [0   0   1/d c/d]
+		static constexpr Projection fromPerspective(const Matrix<4, 4, T> &proj, T nearZ, T farZ)
+		{
+			Projection p;
+			p.m = proj;
+			p.inv = Matrix<4, 4, T>(T{0});
+			p.inv[0][0] = 1 / proj[0][0];
+			p.inv[1][1] = 1 / proj[1][1];
+			p.inv[3][0] = proj[2][0] / proj[0][0];
+			p.inv[3][1] = proj[2][1] / proj[1][1];
+			p.inv[3][2] = T{-1};
+			p.inv[2][3] = 1 / proj[3][2];
+			p.inv[3][3] = proj[2][2] / proj[3][2];
+			p.nearDepth = nearZ;
+			p.farDepth = farZ;
+			return p;
+		}
+
+		constexpr Vector<4, T> unprojectHomogeneous(T x, T y, T z) const
+		{
+			Vector<4, T> res;
+			for(size_t r = 0; r < 4; ++r)
+				res[r] = inv[0][r] * x + inv[1][r] * y + inv[2][r] * z + inv[3][r];
+			return res;
+		}
+
+		Matrix<4, 4, T> m, inv;
+		T nearDepth = T{-1}, farDepth = T{1};
+	};
 }
 
 #endif
@@ -0,0 +1,21 @@
+#ifndef LMI_RAY_H
+#define LMI_RAY_H
+
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	template <typename T = float>
+	struct Ray
+	{
+		Vector<3, T> origin;
+		Vector<3, T> direction;
+
+		constexpr Vector<3, T> operator()(T t) const
+		{
+			return origin + direction * t;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef LMI_SKINNING_H
+#define LMI_SKINNING_H
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace lmi
+{
+	namespace detail
+	{
+		// Blends the affine part (upper three rows) of the bones straight into a local column array, so there are
+		// no Matrix temporaries and the 12 multiply-adds per influence stay in registers.
+		template <size_t INFLUENCES, size_t ROWS, typename T, typename Index>
+		void skinRange(const Matrix<4, ROWS, T> *palette,
+					   const Index *indices,
+					   const T *weights,
+					   const Vector<3, T> *positions,
+					   const Vector<3, T> *normals,
+					   Vector<3, T> *skinnedPositions,
+					   Vector<3, T> *skinnedNormals,
+					   size_t begin,
+					   size_t end)
+		{
+			for(size_t v = begin; v < end; ++v)
+			{
+				T m[4][3] = {};
+				for(size_t k = 0; k < INFLUENCES; ++k)
+				{
+					const auto &bone = palette[indices[v * INFLUENCES + k]];
+					const T w = weights[v * INFLUENCES + k];
+					for(size_t c = 0; c < 4; ++c)
+						for(size_t r = 0; r < 3; ++r)
+							m[c][r] += bone[c][r] * w;
+				}
+
+				const auto &p = positions[v];
+				for(size_t r = 0; r < 3; ++r)
+					skinnedPositions[v][r] = m[0][r] * p[0] + m[1][r] * p[1] + m[2][r] * p[2] + m[3][r];
+
+				if(normals)
+				{
+					const auto &n = normals[v];
+					for(size_t r = 0; r < 3; ++r)
+						skinnedNormals[v][r] = m[0][r] * n[0] + m[1][r] * n[1] + m[2][r] * n[2];
+				}
+			}
+		}
+
+#if defined(__SSE4_1__)
+		// With SSE enabled every column is a 16 byte aligned Vector, so a whole column is blended per instruction.
+		template <size_t INFLUENCES, size_t ROWS, typename Index>
+		void skinRange(const Matrix<4, ROWS, float> *palette,
+					   const Index *indices,
+					   const float *weights,
+					   const vec3 *positions,
+					   const vec3 *normals,
+					   vec3 *skinnedPositions,
+					   vec3 *skinnedNormals,
+					   size_t begin,
+					   size_t end)
+		{
+			for(size_t v = begin; v < end; ++v)
+			{
+				__m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+				for(size_t k = 0; k < INFLUENCES; ++k)
+				{
+					const auto &bone = palette[indices[v * INFLUENCES + k]];
+					const __m128 w = _mm_set1_ps(weights[v * INFLUENCES + k]);
+					c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_load_ps(bone[0]), w));
+					c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_load_ps(bone[1]), w));
+					c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_load_ps(bone[2]), w));
+					c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_load_ps(bone[3]), w));
+				}
+
+				const auto &p = positions[v];
+				__m128 res = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p[0])));
+				res = _mm_add_ps(res, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+				res = _mm_add_ps(res, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+				_mm_store_ps(skinnedPositions[v], res);
+
+				if(normals)
+				{
+					const auto &n = normals[v];
+					res = _mm_mul_ps(c0, _mm_set1_ps(n[0]));
+					res = _mm_add_ps(res, _mm_mul_ps(c1, _mm_set1_ps(n[1])));
+					res = _mm_add_ps(res, _mm_mul_ps(c2, _mm_set1_ps(n[2])));
+					_mm_store_ps(skinnedNormals[v], res);
+				}
+			}
+		}
+#endif
+	}
+
+	// Linear blend skinning of `count` vertices. The palette holds one affine bone transform per bone, either as a
+	// full Matrix<4, 4, T> or as its 3x4 affine form Matrix<4, 3, T>. Every vertex has INFLUENCES consecutive
+	// entries in `indices` and `weights`. Normals may be null and are otherwise transformed by the blended
+	// upper 3x3 without renormalization. Work is split into contiguous vertex chunks across `threads` threads.
+	template <size_t INFLUENCES, size_t ROWS, typename T, typename Index>
+	void skin(const Matrix<4, ROWS, T> *palette,
+			  const Index *indices,
+			  const T *weights,
+			  const Vector<3, T> *positions,
+			  const Vector<3, T> *normals,
+			  Vector<3, T> *skinnedPositions,
+			  Vector<3, T> *skinnedNormals,
+			  size_t count,
+			  size_t threads = 1)
+	{
+		static_assert(ROWS == 3 || ROWS == 4, "Bone palette must be a 4x4 or an affine 3x4 matrix");
+		static_assert(INFLUENCES > 0, "Every vertex needs at least one influence");
+
+		detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+			detail::skinRange<INFLUENCES>(
+				palette, indices, weights, positions, normals, skinnedPositions, skinnedNormals, begin, end);
+		});
+	}
+
+	template <size_t INFLUENCES, size_t ROWS, typename T, typename Index>
+	void skin(const Matrix<4, ROWS, T> *palette,
+			  const Index *indices,
+			  const T *weights,
+			  const Vector<3, T> *positions,
+			  Vector<3, T> *skinnedPositions,
+			  size_t count,
+			  size_t threads = 1)
+	{
+		skin<INFLUENCES>(palette,
+						 indices,
+						 weights,
+						 positions,
+						 static_cast<const Vector<3, T> *>(nullptr),
+						 skinnedPositions,
+						 static_cast<Vector<3, T> *>(nullptr),
+						 count,
+						 threads);
+	}
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef LMI_SPATIAL_ORDER_H
+#define LMI_SPATIAL_ORDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "../detail/aligned_allocator.h"
+#include "../detail/constexpr_math.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+
+namespace lmi
+{
+	// Space filling curves map 2D and 3D grid cells to 64 bit keys so that cells close on the curve are close in
+	// space. Sorting points by their key groups neighbours in memory, which speeds up everything that later walks
+	// them by proximity. 3D keys use 21 bits per axis, 2D keys 32 bits per axis.
+	enum class SpaceFillingCurve
+	{
+		Morton,
+		Hilbert
+	};
+
+	namespace detail
+	{
+		// Bit interleaving, with pdep/pext when BMI2 is available. Note that pdep and pext are microcoded and slow on
+		// AMD processors before Zen 3, build without -mbmi2 there.
+		constexpr uint64_t spread3(uint32_t v)
+		{
+#if defined(__BMI2__)
+			if(!cmath::constantEvaluated())
+				return _pdep_u64(v, 0x1249249249249249);
+#endif
+			uint64_t x = v & 0x1fffff;
+			x = (x | x << 32) & 0x1f00000000ffff;
+			x = (x | x << 16) & 0x1f0000ff0000ff;
+			x = (x | x << 8) & 0x100f00f00f00f00f;
+			x = (x | x << 4) & 0x10c30c30c30c30c3;
+			x = (x | x << 2) & 0x1249249249249249;
+			return x;
+		}
+
+		constexpr uint32_t compact3(uint64_t x)
+		{
+#if defined(__BMI2__)
+			if(!cmath::constantEvaluated())
+				return uint32_t(_pext_u64(x, 0x1249249249249249));
+#endif
+			x &= 0x1249249249249249;
+			x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3;
+			x = (x ^ (x >> 4)) & 0x100f00f00f00f00f;
+			x = (x ^ (x >> 8)) & 0x1f0000ff0000ff;
+			x = (x ^ (x >> 16)) & 0x1f00000000ffff;
+			x = (x ^ (x >> 32)) & 0x1fffff;
+			return uint32_t(x);
+		}
+
+		constexpr uint64_t spread2(uint32_t v)
+		{
+#if defined(__BMI2__)
+			if(!cmath::constantEvaluated())
+				return _pdep_u64(v, 0x5555555555555555);
+#endif
+			uint64_t x = v;
+			x = (x | x << 16) & 0x0000ffff0000ffff;
+			x = (x | x << 8) & 0x00ff00ff00ff00ff;
+			x = (x | x << 4) & 0x0f0f0f0f0f0f0f0f;
+			x = (x | x << 2) & 0x3333333333333333;
+			x = (x | x << 1) & 0x5555555555555555;
+			return x;
+		}
+
+		constexpr uint32_t compact2(uint64_t x)
+		{
+#if defined(__BMI2__)
+			if(!cmath::constantEvaluated())
+				return uint32_t(_pext_u64(x, 0x5555555555555555));
+#endif
+			x &= 0x5555555555555555;
+			x = (x ^ (x >> 1)) & 0x3333333333333333;
+			x = (x ^ (x >> 2)) & 0x0f0f0f0f0f0f0f0f;
+			x = (x ^ (x >> 4)) & 0x00ff00ff00ff00ff;
+			x = (x ^ (x >> 8)) & 0x0000ffff0000ffff;
+			x = (x ^ (x >> 16)) & 0x00000000ffffffff;
+			return uint32_t(x);
+		}
+
+		// Skilling's transform of grid coordinates to the transposed Hilbert index ("Programming the Hilbert curve",
+		// 2004): afterwards interleaving the coordinates with x[0] most significant gives the index.
+		template <size_t DIM>
+		constexpr void hilbertTranspose(uint32_t (&x)[DIM], unsigned bits)
+		{
+			for(uint32_t q = uint32_t{1} << (bits - 1); q > 1; q >>= 1)
+			{
+				const uint32_t p = q - 1;
+				for(size_t i = 0; i < DIM; ++i)
+				{
+					if(x[i] & q)
+						x[0] ^= p;
+					else
+					{
+						const uint32_t t = (x[0] ^ x[i]) & p;
+						x[0] ^= t;
+						x[i] ^= t;
+					}
+				}
+			}
+
+			for(size_t i = 1; i < DIM; ++i)
+				x[i] ^= x[i - 1];
+			uint32_t t = 0;
+			for(uint32_t q = uint32_t{1} << (bits - 1); q > 1; q >>= 1)
+				if(x[DIM - 1] & q)
+					t ^= q - 1;
+			for(size_t i = 0; i < DIM; ++i)
+				x[i] ^= t;
+		}
+
+		// Maps points inside [min, max] to grid cells with BITS bits per axis, points outside are clamped. Computed
+		// in double so 32 bit cells stay exact for float input.
+		template <size_t DIM, unsigned BITS, typename T>
+		class GridQuantizer
+		{
+			public:
+			GridQuantizer(const Vector<DIM, T> &min, const Vector<DIM, T> &max)
+			{
+				for(size_t i = 0; i < DIM; ++i)
+				{
+					const double extent = double(max[i]) - double(min[i]);
+					origin[i] = double(min[i]);
+					scale[i] = extent > 0 ? double(uint64_t{1} << BITS) / extent : 0;
+				}
+			}
+
+			Vector<DIM, unsigned> operator()(const Vector<DIM, T> &p) const
+			{
+				const double maxCell = double((uint64_t{1} << BITS) - 1);
+				Vector<DIM, unsigned> res;
+				for(size_t i = 0; i < DIM; ++i)
+					res[i] = unsigned(std::min(std::max((double(p[i]) - origin[i]) * scale[i], 0.0), maxCell));
+				return res;
+			}
+
+			private:
+			double origin[DIM], scale[DIM];
+		};
+
+		template <size_t DIM>
+		struct CurveBits;
+
+		template <>
+		struct CurveBits<2>
+		{
+			static constexpr unsigned value = 32;
+		};
+
+		template <>
+		struct CurveBits<3>
+		{
+			static constexpr unsigned value = 21;
+		};
+	}
+
+	// ==================== Grid cells ====================
+	// Only the low 21 bits of each coordinate are used in 3D.
+
+	constexpr uint64_t mortonEncode(const Vector<3, unsigned> &cell)
+	{
+		return detail::spread3(cell[0]) | detail::spread3(cell[1]) << 1 | detail::spread3(cell[2]) << 2;
+	}
+
+	constexpr uint64_t mortonEncode(const Vector<2, unsigned> &cell)
+	{
+		return detail::spread2(cell[0]) | detail::spread2(cell[1]) << 1;
+	}
+
+	constexpr Vector<3, unsigned> mortonDecode3(uint64_t key)
+	{
+		return Vector<3, unsigned>(detail::compact3(key), detail::compact3(key >> 1), detail::compact3(key >> 2));
+	}
+
+	constexpr Vector<2, unsigned> mortonDecode2(uint64_t key)
+	{
+		return Vector<2, unsigned>(detail::compact2(key), detail::compact2(key >> 1));
+	}
+
+	// Unlike Morton order, consecutive Hilbert keys are always neighbouring cells, at the price of a few dozen more
+	// bit operations per key.
+	constexpr uint64_t hilbertEncode(const Vector<3, unsigned> &cell)
+	{
+		uint32_t x[3] = {cell[0] & 0x1fffff, cell[1] & 0x1fffff, cell[2] & 0x1fffff};
+		detail::hilbertTranspose(x, 21);
+		return detail::spread3(x[2]) | detail::spread3(x[1]) << 1 | detail::spread3(x[0]) << 2;
+	}
+
+	constexpr uint64_t hilbertEncode(const Vector<2, unsigned> &cell)
+	{
+		uint32_t x[2] = {cell[0], cell[1]};
+		detail::hilbertTranspose(x, 32);
+		return detail::spread2(x[1]) | detail::spread2(x[0]) << 1;
+	}
+
+	// ==================== Points in a box ====================
+
+	template <size_t DIM, typename T, typename = std::enable_if_t<std::is_floating_point<T>::value>>
+	uint64_t mortonEncode(const Vector<DIM, T> &p, const Vector<DIM, T> &min, const Vector<DIM, T> &max)
+	{
+		return mortonEncode(detail::GridQuantizer<DIM, detail::CurveBits<DIM>::value, T>(min, max)(p));
+	}
+
+	template <size_t DIM, typename T, typename = std::enable_if_t<std::is_floating_point<T>::value>>
+	uint64_t hilbertEncode(const Vector<DIM, T> &p, const Vector<DIM, T> &min, const Vector<DIM, T> &max)
+	{
+		return hilbertEncode(detail::GridQuantizer<DIM, detail::CurveBits<DIM>::value, T>(min, max)(p));
+	}
+
+	// One key per point, quantized to the box [min, max].
+	template <size_t DIM, typename T>
+	void encodePoints(SpaceFillingCurve curve,
+					  const Vector<DIM, T> *points,
+					  uint64_t *keys,
+					  size_t count,
+					  const Vector<DIM, T> &min,
+					  const Vector<DIM, T> &max,
+					  size_t threads = 1)
+	{
+		const detail::GridQuantizer<DIM, detail::CurveBits<DIM>::value, T> quantize(min, max);
+		detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+			if(curve == SpaceFillingCurve::Morton)
+				for(size_t i = begin; i < end; ++i)
+					keys[i] = mortonEncode(quantize(points[i]));
+			else
+				for(size_t i = begin; i < end; ++i)
+					keys[i] = hilbertEncode(quantize(points[i]));
+		});
+	}
+
+	// ==================== Radix sort ====================
+
+	// Stable LSD radix sort of keys with 8 bit digits. order receives the original index of every sorted key. Only
+	// the low keyBits bits take part, and passes whose digit is the same for every key are skipped, so keys that only
+	// use part of their range cost fewer passes. Each pass counts digits per thread chunk and then scatters every
+	// chunk to its own precomputed offsets, the result does not depend on the thread count.
+	inline void radixSort(uint64_t *keys, uint32_t *order, size_t count, size_t threads = 1, unsigned keyBits = 64)
+	{
+		const size_t radix = 256;
+		threads = detail::resolveThreadCount(threads);
+		const size_t chunks = std::max(detail::chunkCount(count, threads), size_t{1});
+
+		std::vector<uint64_t> keyBuffer(count);
+		std::vector<uint32_t> orderBuffer(count);
+		std::vector<size_t> histogram(chunks * radix);
+		uint64_t *srcKeys = keys, *dstKeys = keyBuffer.data();
+		uint32_t *srcOrder = order, *dstOrder = orderBuffer.data();
+		for(size_t i = 0; i < count; ++i)
+			order[i] = uint32_t(i);
+
+		for(unsigned shift = 0; shift < keyBits; shift += 8)
+		{
+			std::fill(histogram.begin(), histogram.end(), size_t{0});
+			detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+				size_t *h = &histogram[chunk * radix];
+				for(size_t i = begin; i < end; ++i)
+					++h[(srcKeys[i] >> shift) & 0xff];
+			});
+
+			// Offsets in digit major, chunk minor order keep the sort stable.
+			size_t sum = 0;
+			bool trivial = false;
+			for(size_t d = 0; d < radix; ++d)
+			{
+				size_t digitCount = 0;
+				for(size_t c = 0; c < chunks; ++c)
+				{
+					const size_t n = histogram[c * radix + d];
+					histogram[c * radix + d] = sum;
+					sum += n;
+					digitCount += n;
+				}
+				trivial |= digitCount == count;
+			}
+			if(trivial)
+				continue;
+
+			detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+				size_t *offset = &histogram[chunk * radix];
+				for(size_t i = begin; i < end; ++i)
+				{
+					const size_t dst = offset[(srcKeys[i] >> shift) & 0xff]++;
+					dstKeys[dst] = srcKeys[i];
+					dstOrder[dst] = srcOrder[i];
+				}
+			});
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcOrder, dstOrder);
+		}
+
+		if(srcKeys != keys)
+		{
+			std::copy(srcKeys, srcKeys + count, keys);
+			std::copy(srcOrder, srcOrder + count, order);
+		}
+	}
+
+	// array[i] = old array[order[i]] for every array, gathered in parallel.
+	template <typename... Arrays>
+	void applyOrder(const uint32_t *order, size_t count, size_t threads, Arrays *... arrays)
+	{
+		auto apply = [&](auto *array) {
+			using Element = std::remove_pointer_t<decltype(array)>;
+			detail::AlignedVector<Element> sorted(count);
+			detail::parallelFor(count, threads, [&](size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i)
+					sorted[i] = array[order[i]];
+			});
+			std::copy(sorted.begin(), sorted.end(), array);
+		};
+		(void)apply;
+		int expand[] = {0, (apply(arrays), 0)...};
+		(void)expand;
+	}
+
+	// Reorders points and any number of payload arrays of the same length along a space filling curve through their
+	// bounding box. Returns the original index of every point in the new order.
+	template <size_t DIM, typename T, typename... Payloads>
+	std::vector<uint32_t> spatialSort(
+		SpaceFillingCurve curve, Vector<DIM, T> *points, size_t count, size_t threads, Payloads *... payloads)
+	{
+		std::vector<uint32_t> order(count);
+		if(count == 0)
+			return order;
+
+		threads = detail::resolveThreadCount(threads);
+		detail::AlignedVector<Vector<DIM, T>> partialMin(detail::chunkCount(count, threads), points[0]);
+		detail::AlignedVector<Vector<DIM, T>> partialMax(partialMin);
+		detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i)
+				for(size_t a = 0; a < DIM; ++a)
+				{
+					partialMin[chunk][a] = std::min(partialMin[chunk][a], points[i][a]);
+					partialMax[chunk][a] = std::max(partialMax[chunk][a], points[i][a]);
+				}
+		});
+		Vector<DIM, T> min = points[0], max = points[0];
+		for(size_t c = 0; c < partialMin.size(); ++c)
+			for(size_t a = 0; a < DIM; ++a)
+			{
+				min[a] = std::min(min[a], partialMin[c][a]);
+				max[a] = std::max(max[a], partialMax[c][a]);
+			}
+
+		std::vector<uint64_t> keys(count);
+		encodePoints(curve, points, keys.data(), count, min, max, threads);
+		radixSort(keys.data(), order.data(), count, threads, unsigned(DIM * detail::CurveBits<DIM>::value));
+		applyOrder(order.data(), count, threads, points, payloads...);
+		return order;
+	}
+}
+
+#endif
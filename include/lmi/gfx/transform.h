@@ -1,7 +1,9 @@
 #ifndef LMI_TRANSFORM_H
 #define LMI_TRANSFORM_H
 
+#include "../detail/constexpr_math.h"
 #include "../detail/matrix.h"
+#include "../detail/quaternion.h"
 #include <cmath>
 #include <cstdint>
 #include <type_traits>
@@ -42,56 +44,212 @@ namespace lmi
 		return res;
 	}
 
+	namespace detail
+	{
+		// Kept as one call site per angle so the compiler merges both into a single sincos at runtime.
+		template <typename T>
+		constexpr void sincos(T angle, T &s, T &c)
+		{
+			s = lmi::sin(angle);
+			c = lmi::cos(angle);
+		}
+
+		// Left multiplies m by the rotation about coordinate axis AXIS, which only touches the two other rows.
+		template <size_t AXIS, typename T>
+		constexpr void rotateRows(Matrix<3, 3, T> &m, T s, T c)
+		{
+			const size_t p = (AXIS + 1) % 3, q = (AXIS + 2) % 3;
+			for(size_t col = 0; col < 3; ++col)
+			{
+				const T rp = m[col][p], rq = m[col][q];
+				m[col][p] = c * rp - s * rq;
+				m[col][q] = s * rp + c * rq;
+			}
+		}
+
+		// Left multiplies the quaternion (w, v) by the rotation about coordinate axis AXIS, given the sine and cosine
+		// of the half angle.
+		template <size_t AXIS, typename T>
+		constexpr void rotateQuaternion(T (&q)[4], T s, T c)
+		{
+			const size_t i = AXIS + 1, p = (AXIS + 1) % 3 + 1, r = (AXIS + 2) % 3 + 1;
+			const T w = q[0], vi = q[i], vp = q[p], vr = q[r];
+			q[0] = c * w - s * vi;
+			q[i] = c * vi + s * w;
+			q[p] = c * vp - s * vr;
+			q[r] = c * vr + s * vp;
+		}
+	}
+
 	// clang-format off
 	template <typename T>
-	Matrix<3, 3, T> rotateX(T angle)
+	constexpr Matrix<3, 3, T> rotateX(T angle)
 	{
+		T s{}, c{};
+		detail::sincos(angle, s, c);
 		return Matrix<3, 3, T>
 		(
-			1, 0,                0,
-			0, std::cos(angle), -std::sin(angle),
-			0, std::sin(angle),  std::cos(angle)
+			1, 0,  0,
+			0, c, -s,
+			0, s,  c
 		);
 	}
 
 	template <typename T>
-	Matrix<3, 3, T> rotateY(T angle)
+	constexpr Matrix<3, 3, T> rotateY(T angle)
 	{
+		T s{}, c{};
+		detail::sincos(angle, s, c);
 		return Matrix<3, 3, T>
 		(
-			std::cos(angle),  0, std::sin(angle),
-			0,                1, 0,
-			-std::sin(angle), 0, std::cos(angle)
+			 c, 0, s,
+			 0, 1, 0,
+			-s, 0, c
 		);
 	}
 
 	template <typename T>
-	Matrix<3, 3, T> rotateZ(T angle)
+	constexpr Matrix<3, 3, T> rotateZ(T angle)
 	{
+		T s{}, c{};
+		detail::sincos(angle, s, c);
 		return Matrix<3, 3, T>
 		(
-			std::cos(angle), -std::sin(angle), 0,
-			std::sin(angle),  std::cos(angle), 0,
-			0,                0,               1
+			c, -s, 0,
+			s,  c, 0,
+			0,  0, 1
 		);
 	}
 
 	template <typename T>
-	Matrix<2, 2, T> rotateAngles(T angle)
+	constexpr Matrix<2, 2, T> rotateAngles(T angle)
 	{
+		T s{}, c{};
+		detail::sincos(angle, s, c);
 		return Matrix<2, 2, T>
 		(
-				std::cos(angle), -std::sin(angle),
-				std::sin(angle),  std::cos(angle)
+				c, -s,
+				s,  c
 		);
 	}
+	// clang-format on
+
+	// Order of the elementary rotations in an Euler angle triple: ZYX means Rz(a) * Ry(b) * Rx(c), so the last axis
+	// is applied to a vector first.
+	enum class EulerOrder
+	{
+		XYZ,
+		XZY,
+		YXZ,
+		YZX,
+		ZXY,
+		ZYX
+	};
+
+	namespace detail
+	{
+		constexpr size_t eulerAxis(EulerOrder order, size_t i)
+		{
+			// clang-format off
+			constexpr size_t axes[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+			// clang-format on
+			return axes[static_cast<size_t>(order)][i];
+		}
+	}
+
+	// Builds the rotation in closed form: one sincos per angle and two row rotations instead of three full matrices
+	// and two matrix products.
+	template <EulerOrder ORDER, typename T>
+	constexpr Matrix<3, 3, T> rotateEuler(T a, T b, T c)
+	{
+		T sa{}, ca{}, sb{}, cb{}, sc{}, cc{};
+		detail::sincos(a, sa, ca);
+		detail::sincos(b, sb, cb);
+		detail::sincos(c, sc, cc);
+
+		Matrix<3, 3, T> m(T{1});
+		detail::rotateRows<detail::eulerAxis(ORDER, 2)>(m, sc, cc);
+		detail::rotateRows<detail::eulerAxis(ORDER, 1)>(m, sb, cb);
+		detail::rotateRows<detail::eulerAxis(ORDER, 0)>(m, sa, ca);
+		return m;
+	}
 
 	template <typename T>
-	Matrix<3, 3, T> rotateAngles(T yaw, T pitch, T roll)
+	constexpr Matrix<3, 3, T> rotateAngles(T yaw, T pitch, T roll)
 	{
-		return rotateZ(yaw) * rotateY(pitch) * rotateX(roll);
+		return rotateEuler<EulerOrder::ZYX>(yaw, pitch, roll);
+	}
+
+	// Same rotation as rotateEuler<ORDER>(a, b, c) as a unit quaternion.
+	template <EulerOrder ORDER, typename T>
+	constexpr Quaternion<T> eulerQuaternion(T a, T b, T c)
+	{
+		T sa{}, ca{}, sb{}, cb{}, sc{}, cc{};
+		detail::sincos(a / T{2}, sa, ca);
+		detail::sincos(b / T{2}, sb, cb);
+		detail::sincos(c / T{2}, sc, cc);
+
+		T q[4] = {T{1}, T{0}, T{0}, T{0}};
+		detail::rotateQuaternion<detail::eulerAxis(ORDER, 2)>(q, sc, cc);
+		detail::rotateQuaternion<detail::eulerAxis(ORDER, 1)>(q, sb, cb);
+		detail::rotateQuaternion<detail::eulerAxis(ORDER, 0)>(q, sa, ca);
+		return Quaternion<T>(q[0], q[1], q[2], q[3]);
+	}
+
+	// Rodrigues' formula, axis has to be normalized.
+	template <typename T>
+	constexpr Matrix<3, 3, T> rotateAxisAngle(const Vector<3, T> &axis, T angle)
+	{
+		T s{}, c{};
+		detail::sincos(angle, s, c);
+		const T t = 1 - c;
+		const T x = axis[0], y = axis[1], z = axis[2];
+
+		// clang-format off
+		return Matrix<3, 3, T>
+		(
+			t * x * x + c,     t * x * y - s * z, t * x * z + s * y,
+			t * x * y + s * z, t * y * y + c,     t * y * z - s * x,
+			t * x * z - s * y, t * y * z + s * x, t * z * z + c
+		);
+		// clang-format on
+	}
+
+	// ==================== Batch builders ====================
+	// Angle triples in, one rotation per triple out. Each element is independent and branch free.
+
+	template <EulerOrder ORDER, typename T>
+	void rotateEuler(const Vector<3, T> *angles, Matrix<3, 3, T> *out, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			out[i] = rotateEuler<ORDER>(angles[i][0], angles[i][1], angles[i][2]);
+	}
+
+	template <EulerOrder ORDER, typename T>
+	void eulerQuaternion(const Vector<3, T> *angles, Quaternion<T> *out, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i)
+			out[i] = eulerQuaternion<ORDER>(angles[i][0], angles[i][1], angles[i][2]);
+	}
+
+	// Right handed view matrix looking from eye towards center, the camera looks down its -z axis.
+	template <typename T>
+	constexpr Matrix<4, 4, T> lookAt(const Vector<3, T> &eye, const Vector<3, T> &center, const Vector<3, T> &up)
+	{
+		const auto f = normalize(center - eye);
+		const auto s = normalize(cross(f, up));
+		const auto u = cross(s, f);
+
+		// clang-format off
+		return Matrix<4, 4, T>
+		(
+			 s[0],  s[1],  s[2], -dot(s, eye),
+			 u[0],  u[1],  u[2], -dot(u, eye),
+			-f[0], -f[1], -f[2],  dot(f, eye),
+			 0,     0,     0,     1
+		);
+		// clang-format on
 	}
-	// clang-format on
 }
 
 #endif
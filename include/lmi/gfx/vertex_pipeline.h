@@ -0,0 +1,160 @@
+#ifndef LMI_VERTEX_PIPELINE_H
+#define LMI_VERTEX_PIPELINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../detail/matrix.h"
+#include "../detail/parallel.h"
+#include "../detail/vector.h"
+#include "projection.h"
+
+namespace lmi
+{
+	// Bits of a clip outcode, set for every clip plane the vertex lies outside of.
+	enum ClipOutcode : uint8_t
+	{
+		OutsideLeft = 1 << 0,
+		OutsideRight = 1 << 1,
+		OutsideBottom = 1 << 2,
+		OutsideTop = 1 << 3,
+		OutsideNear = 1 << 4,
+		OutsideFar = 1 << 5
+	};
+
+	// Maps NDC to window coordinates with y up as in OpenGL. For y down windows use y = top edge and a negative
+	// height.
+	template <typename T = float>
+	struct Viewport
+	{
+		T x, y, width, height;
+		T minDepth = T{0}, maxDepth = T{1};
+	};
+
+	// Destinations of VertexPipeline::process, one entry per vertex. Null streams are skipped.
+	template <typename T = float>
+	struct VertexStreams
+	{
+		Vector<4, T> *clip = nullptr;
+		uint8_t *outcodes = nullptr;
+		Vector<3, T> *ndc = nullptr;
+		Vector<3, T> *screen = nullptr;	// Window x and y, depth mapped to [minDepth, maxDepth].
+	};
+
+	// Model, view, projection and viewport transform fused into one pass over a position stream. Vertices are
+	// processed in blocks: the block is transformed, classified, divided and mapped in structure of arrays form on
+	// the stack, and only then written to the requested streams, so each vertex is read once and every output
+	// written once. NDC and screen coordinates are only meaningful for vertices with w > 0, i.e. in front of the
+	// camera for a perspective projection.
+	template <typename T = float>
+	class VertexPipeline
+	{
+		public:
+		VertexPipeline(const Matrix<4, 4, T> &model,
+					   const Matrix<4, 4, T> &view,
+					   const Matrix<4, 4, T> &projection,
+					   const Viewport<T> &viewport,
+					   DepthRange depth = DepthRange::NegativeOneToOne)
+			: mvp(projection * view * model), viewport(viewport), depth(depth)
+		{
+		}
+
+		const Matrix<4, 4, T> &matrix() const
+		{
+			return mvp;
+		}
+
+		// Returns the AND of all outcodes: if it is non zero, every vertex is outside the same plane and whatever
+		// they form can be rejected as a whole. An empty batch returns 0, as there is nothing to reject.
+		uint8_t process(const Vector<3, T> *positions,
+						size_t count,
+						const VertexStreams<T> &out,
+						size_t threads = 1) const
+		{
+			if(count == 0)
+				return 0;
+			threads = detail::resolveThreadCount(threads);
+			std::vector<uint8_t> partial(std::max(detail::chunkCount(count, threads), size_t{1}), uint8_t(0x3f));
+			detail::parallelChunks(count, threads, [&](size_t chunk, size_t begin, size_t end) {
+				uint8_t all = 0x3f;
+				for(size_t b = begin; b < end; b += blockSize)
+					all &= processBlock(positions, b, std::min(b + blockSize, end), out);
+				partial[chunk] = all;
+			});
+			uint8_t all = 0x3f;
+			for(uint8_t p : partial)
+				all &= p;
+			return all;
+		}
+
+		private:
+		static constexpr size_t blockSize = 256;
+
+		uint8_t processBlock(const Vector<3, T> *positions, size_t begin, size_t end, const VertexStreams<T> &out) const
+		{
+			const size_t n = end - begin;
+			T cx[blockSize], cy[blockSize], cz[blockSize], cw[blockSize];
+			T nx[blockSize], ny[blockSize], nz[blockSize], sx[blockSize], sy[blockSize], sz[blockSize];
+			uint8_t codes[blockSize];
+
+			const T m00 = mvp[0][0], m01 = mvp[0][1], m02 = mvp[0][2], m03 = mvp[0][3];
+			const T m10 = mvp[1][0], m11 = mvp[1][1], m12 = mvp[1][2], m13 = mvp[1][3];
+			const T m20 = mvp[2][0], m21 = mvp[2][1], m22 = mvp[2][2], m23 = mvp[2][3];
+			const T m30 = mvp[3][0], m31 = mvp[3][1], m32 = mvp[3][2], m33 = mvp[3][3];
+
+			// NDC z in [-1, 1] or [0, 1] to [minDepth, maxDepth] as one multiply add.
+			const T depthScale = (viewport.maxDepth - viewport.minDepth) /
+								 (depth == DepthRange::NegativeOneToOne ? T{2} : T{1});
+			const T depthOffset = viewport.minDepth + (depth == DepthRange::NegativeOneToOne ? depthScale : T{0});
+			const T nearScale = depth == DepthRange::NegativeOneToOne ? T{-1} : T{0};
+			const T halfWidth = viewport.width / 2, halfHeight = viewport.height / 2;
+			const T centerX = viewport.x + halfWidth, centerY = viewport.y + halfHeight;
+
+			uint8_t all = 0x3f;
+			for(size_t i = 0; i < n; ++i)
+			{
+				const Vector<3, T> &p = positions[begin + i];
+				const T x = m00 * p[0] + m10 * p[1] + m20 * p[2] + m30;
+				const T y = m01 * p[0] + m11 * p[1] + m21 * p[2] + m31;
+				const T z = m02 * p[0] + m12 * p[1] + m22 * p[2] + m32;
+				const T w = m03 * p[0] + m13 * p[1] + m23 * p[2] + m33;
+				cx[i] = x, cy[i] = y, cz[i] = z, cw[i] = w;
+
+				const unsigned code = unsigned(x < -w) * OutsideLeft | unsigned(x > w) * OutsideRight |
+									  unsigned(y < -w) * OutsideBottom | unsigned(y > w) * OutsideTop |
+									  unsigned(z < nearScale * w) * OutsideNear | unsigned(z > w) * OutsideFar;
+				codes[i] = uint8_t(code);
+				all &= uint8_t(code);
+
+				const T invW = T{1} / w;
+				nx[i] = x * invW, ny[i] = y * invW, nz[i] = z * invW;
+				sx[i] = centerX + nx[i] * halfWidth;
+				sy[i] = centerY + ny[i] * halfHeight;
+				sz[i] = depthOffset + nz[i] * depthScale;
+			}
+
+			if(out.clip)
+				for(size_t i = 0; i < n; ++i)
+					out.clip[begin + i] = Vector<4, T>(cx[i], cy[i], cz[i], cw[i]);
+			if(out.outcodes)
+				std::copy(codes, codes + n, out.outcodes + begin);
+			if(out.ndc)
+				for(size_t i = 0; i < n; ++i)
+					out.ndc[begin + i] = Vector<3, T>(nx[i], ny[i], nz[i]);
+			if(out.screen)
+				for(size_t i = 0; i < n; ++i)
+					out.screen[begin + i] = Vector<3, T>(sx[i], sy[i], sz[i]);
+			return all;
+		}
+
+		Matrix<4, 4, T> mvp;
+		Viewport<T> viewport;
+		DepthRange depth;
+	};
+
+	template <typename T>
+	constexpr size_t VertexPipeline<T>::blockSize;
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <cmath>
 
+#include "detail/dual.h"
+#include "detail/math.h"
 #include "detail/matrix.h"
 #include "detail/quaternion.h"
 #include "detail/vector.h"
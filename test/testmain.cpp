@@ -1,5 +1,25 @@
 #include <gtest/gtest.h>
+#include <lmi/algorithm/differentiation.h>
+#include <lmi/algorithm/integration.h>
+#include <lmi/algorithm/least_squares.h>
+#include <lmi/algorithm/monte_carlo.h>
+#include <lmi/algorithm/particles.h>
 #include <lmi/iostream_support.h>
+#include <lmi/gfx/animation.h>
+#include <lmi/gfx/bounds.h>
+#include <lmi/gfx/bvh.h>
+#include <lmi/gfx/compression.h>
+#include <lmi/gfx/conversion.h>
+#include <lmi/gfx/curve.h>
+#include <lmi/gfx/frustum.h>
+#include <lmi/gfx/hash_grid.h>
+#include <lmi/gfx/hierarchy.h>
+#include <lmi/gfx/kdtree.h>
+#include <lmi/gfx/mesh.h>
+#include <lmi/gfx/occlusion.h>
+#include <lmi/gfx/skinning.h>
+#include <lmi/gfx/spatial_order.h>
+#include <lmi/gfx/vertex_pipeline.h>
 #include <lmi/lmi.h>
 
 TEST(EmptyTest, nothing)
@@ -33,3 +53,1692 @@ static_assert(CompiletimeValue<
 		)
 		>::value == 42, "");
 // clang-format on
+
+TEST(Skinning, matchesMatrixBlend)
+{
+	lmi::mat4 palette[3] = {lmi::translate(1.0f, 2.0f, 3.0f),
+							lmi::mat4(2.0f),
+							lmi::translate(-1.0f, 0.0f, 0.5f) * lmi::mat4(0.5f)};
+	palette[1][3][3] = 1;
+	palette[2][3][3] = 1;
+
+	const unsigned indices[] = {0, 1, 1, 2, 2, 0};
+	const float weights[] = {0.25f, 0.75f, 0.5f, 0.5f, 1.0f, 0.0f};
+	const lmi::vec3 positions[] = {{1, 2, 3}, {-4, 5, 0.5f}, {0, 0, 1}};
+	const lmi::vec3 normals[] = {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}};
+	lmi::vec3 skinnedPositions[3], skinnedNormals[3];
+
+	lmi::skin<2>(palette, indices, weights, positions, normals, skinnedPositions, skinnedNormals, 3, 2);
+
+	for(size_t v = 0; v < 3; ++v)
+	{
+		lmi::mat4 blend(0.0f);
+		for(size_t k = 0; k < 2; ++k)
+			blend += palette[indices[v * 2 + k]] * weights[v * 2 + k];
+
+		for(size_t r = 0; r < 3; ++r)
+		{
+			const auto &p = positions[v];
+			const auto &n = normals[v];
+			EXPECT_FLOAT_EQ(skinnedPositions[v][r], blend[0][r] * p[0] + blend[1][r] * p[1] + blend[2][r] * p[2] + blend[3][r]);
+			EXPECT_FLOAT_EQ(skinnedNormals[v][r], blend[0][r] * n[0] + blend[1][r] * n[1] + blend[2][r] * n[2]);
+		}
+	}
+}
+
+TEST(Quaternion, matrixRoundTrip)
+{
+	const lmi::vec3 axes[] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, lmi::normalize(lmi::vec3(1, -2, 3))};
+	const float angles[] = {0.0f, 0.5f, 3.1f, -2.0f};
+
+	lmi::Quat quaternions[16];
+	for(size_t i = 0; i < 16; ++i)
+		quaternions[i] = lmi::createRotationQuaternion(axes[i % 4], angles[i / 4]);
+
+	lmi::mat3 matrices[16];
+	lmi::Quat converted[16];
+	lmi::convert(quaternions, matrices, 16, 2);
+	lmi::convert(matrices, converted, 16, 2);
+
+	const lmi::vec3 v(0.3f, -1.0f, 2.0f);
+	for(size_t i = 0; i < 16; ++i)
+	{
+		const auto expected = lmi::rotate(quaternions[i], v);
+		const auto fromMatrix = matrices[i] * v;
+		const auto fromAffine = static_cast<lmi::mat4x3>(quaternions[i])[2];
+		for(size_t r = 0; r < 3; ++r)
+		{
+			EXPECT_NEAR(fromMatrix[r], expected[r], 1e-5f);
+			EXPECT_FLOAT_EQ(fromAffine[r], matrices[i][2][r]);
+		}
+
+		// q and -q describe the same rotation
+		const float sign = lmi::realPart(converted[i]) * lmi::realPart(quaternions[i]) < 0 ? -1.0f : 1.0f;
+		for(int c = 0; c < 4; ++c)
+			EXPECT_NEAR(sign * converted[i][c], quaternions[i][c], 1e-5f);
+		EXPECT_NEAR(lmi::Quat(static_cast<lmi::mat4>(quaternions[i]))[1], converted[i][1], 1e-6f);
+	}
+}
+
+TEST(Compression, quaternionRoundTrip)
+{
+	lmi::CompressedQuat32 small[8];
+	lmi::CompressedQuat48 large[8];
+	lmi::Quat original[8], decoded32[8], decoded48[8];
+	for(size_t i = 0; i < 8; ++i)
+	{
+		// every component takes a turn at being the largest one, with both signs
+		original[i] = lmi::normalize(lmi::Quat(i % 4 == 0 ? 4.0f : 0.5f, i % 4 == 1 ? -4.0f : -0.3f, i % 4 == 2 ? 4.0f : 0.2f, i % 4 == 3 ? -4.0f : 0.1f) * (i < 4 ? 1.0f : -1.0f));
+		small[i] = lmi::compress32(original[i]);
+		large[i] = lmi::compress48(original[i]);
+	}
+	lmi::decompress(small, decoded32, 8);
+	lmi::decompress(large, decoded48, 8);
+
+	for(size_t i = 0; i < 8; ++i)
+	{
+		const float d32 = std::abs(lmi::realPart(decoded32[i] * lmi::conjugate(original[i])));
+		const float d48 = std::abs(lmi::realPart(decoded48[i] * lmi::conjugate(original[i])));
+		EXPECT_NEAR(d32, 1.0f, 1e-5f);
+		EXPECT_NEAR(d48, 1.0f, 1e-6f);
+		EXPECT_NEAR(lmi::norm(decoded32[i]), 1.0f, 1e-6f);
+	}
+}
+
+TEST(Compression, vectorRoundTrip)
+{
+	const lmi::vec3 min(-10, 0, 5), max(10, 1, 5);
+	lmi::QuantizedVec3 q[2] = {lmi::quantize(lmi::vec3(3.3f, 0.25f, 5.0f), min, max),
+							   lmi::quantize(lmi::vec3(-20.0f, 2.0f, 5.0f), min, max)};
+	lmi::vec3 v[2];
+	lmi::dequantize(q, v, 2, min, max);
+
+	EXPECT_NEAR(v[0][0], 3.3f, 20.0f / 65535);
+	EXPECT_NEAR(v[0][1], 0.25f, 1.0f / 65535);
+	EXPECT_FLOAT_EQ(v[0][2], 5.0f);
+	EXPECT_FLOAT_EQ(v[1][0], -10.0f);
+	EXPECT_FLOAT_EQ(v[1][1], 1.0f);
+}
+
+TEST(Animation, cursorMatchesSearch)
+{
+	const float times[] = {0.0f, 0.5f, 1.0f, 2.0f, 4.0f};
+	const lmi::vec3 positions[] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {0, 0, 0}};
+	const lmi::Quat rotations[] = {lmi::createRotationQuaternion(lmi::vec3(0, 0, 1), 0.0f),
+								   lmi::createRotationQuaternion(lmi::vec3(0, 0, 1), 1.0f),
+								   lmi::createRotationQuaternion(lmi::vec3(0, 1, 0), 1.0f),
+								   lmi::createRotationQuaternion(lmi::vec3(1, 0, 0), -2.0f),
+								   lmi::createRotationQuaternion(lmi::vec3(1, 0, 0), 3.0f)};
+	const lmi::Track<lmi::vec3> positionTrack{times, positions, 5};
+	const lmi::Track<lmi::Quat> rotationTrack{times, rotations, 5};
+
+	EXPECT_EQ(lmi::sample(positionTrack, 0.75f), lmi::vec3(1, 0.5f, 0));
+	EXPECT_EQ(lmi::sample(positionTrack, -1.0f), positions[0]);
+	EXPECT_EQ(lmi::sample(positionTrack, 5.0f), positions[4]);
+
+	lmi::TrackCursor positionCursor, rotationCursor;
+	const float playback[] = {0.1f, 0.2f, 0.6f, 1.5f, 3.9f, 4.5f, 0.3f, 2.5f, 1.9f};
+	for(float t : playback)
+	{
+		EXPECT_EQ(lmi::sample(positionTrack, t, positionCursor), lmi::sample(positionTrack, t));
+		EXPECT_EQ(lmi::sample(rotationTrack, t, rotationCursor), lmi::sample(rotationTrack, t));
+	}
+
+	const lmi::Track<lmi::Quat> tracks[] = {rotationTrack, {times + 1, rotations + 1, 4}, {times, rotations, 1}};
+	lmi::TrackCursor cursors[3];
+	float w[3], x[3], y[3], z[3];
+	float *components[] = {w, x, y, z};
+	lmi::sample(tracks, cursors, 3, 1.25f, components);
+	for(size_t i = 0; i < 3; ++i)
+	{
+		const auto expected = lmi::sample(tracks[i], 1.25f);
+		EXPECT_EQ(lmi::Quat(w[i], x[i], y[i], z[i]), expected);
+	}
+	EXPECT_NEAR(lmi::norm(lmi::Quat(w[0], x[0], y[0], z[0])), 1.0f, 1e-6f);
+}
+
+TEST(Frustum, batchCullingMatchesScalar)
+{
+	const lmi::Frustum<float> frustum(lmi::perspective(1.2f, 1.5f, 0.1f, 100.0f));
+	EXPECT_TRUE(frustum.contains(lmi::vec3(0, 0, -10)));
+	EXPECT_FALSE(frustum.contains(lmi::vec3(0, 0, 10)));
+	EXPECT_FALSE(frustum.contains(lmi::vec3(0, 0, -200)));
+	EXPECT_TRUE(frustum.intersects(lmi::vec3(0, 0, 1), 2.0f));
+
+	const size_t count = 1000;
+	float x[count], y[count], z[count], radius[count], maxX[count], maxY[count], maxZ[count];
+	unsigned seed = 1;
+	auto random = [&seed](float min, float max) {
+		seed = seed * 1664525u + 1013904223u;
+		return min + (max - min) * float(seed >> 8) / float(1u << 24);
+	};
+	for(size_t i = 0; i < count; ++i)
+	{
+		x[i] = random(-60, 60);
+		y[i] = random(-60, 60);
+		z[i] = random(-120, 20);
+		radius[i] = random(0, 5);
+		maxX[i] = x[i] + radius[i];
+		maxY[i] = y[i] + random(0, 5);
+		maxZ[i] = z[i] + random(0, 5);
+	}
+
+	const lmi::BoundingSpheres<float> spheres{x, y, z, radius};
+	const lmi::BoundingBoxes<float> boxes{x, y, z, maxX, maxY, maxZ};
+	uint8_t sphereMask[count], boxMask[count];
+	uint32_t sphereIndices[count], boxIndices[count];
+	frustum.cull(spheres, count, sphereMask, 3);
+	frustum.cull(boxes, count, boxMask);
+	const size_t visibleSpheres = frustum.cull(spheres, count, sphereIndices, 3);
+	const size_t visibleBoxes = frustum.cull(boxes, count, boxIndices, 4);
+
+	size_t s = 0, b = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		const lmi::vec3 center(x[i], y[i], z[i]), max(maxX[i], maxY[i], maxZ[i]);
+		ASSERT_EQ(sphereMask[i] != 0, frustum.intersects(center, radius[i]));
+		ASSERT_EQ(boxMask[i] != 0, frustum.intersects(center, max));
+		if(sphereMask[i])
+		{
+			EXPECT_EQ(sphereIndices[s++], i);
+		}
+		if(boxMask[i])
+		{
+			EXPECT_EQ(boxIndices[b++], i);
+		}
+	}
+	EXPECT_EQ(s, visibleSpheres);
+	EXPECT_EQ(b, visibleBoxes);
+	EXPECT_GT(s, 0u);
+	EXPECT_LT(s, count);
+}
+
+TEST(Projection, analyticInverse)
+{
+	const lmi::Projection<float> projections[] = {lmi::Projection<float>::perspective(1.0f, 1.5f, 0.1f),
+												  lmi::Projection<float>::perspective(1.0f, 1.5f, 0.1f, 50.0f),
+												  lmi::Projection<float>::perspectiveReverseZ(1.0f, 1.5f, 0.1f),
+												  lmi::Projection<float>::perspectiveReverseZ(1.0f, 1.5f, 0.1f, 50.0f),
+												  lmi::Projection<float>::frustum(-0.2f, 0.1f, -0.05f, 0.1f, 0.1f, 50.0f),
+												  lmi::Projection<float>::orthographic(-4.0f, 2.0f, -1.0f, 3.0f, 0.5f, 20.0f)};
+
+	const lmi::vec3 view(0.3f, -0.4f, -2.0f);
+	for(const auto &p : projections)
+	{
+		const auto identity = p.inverse() * p.matrix();
+		for(size_t c = 0; c < 4; ++c)
+			for(size_t r = 0; r < 4; ++r)
+				EXPECT_NEAR(identity[c][r], c == r ? 1.0f : 0.0f, 1e-5f);
+
+		const auto clip = p.matrix() * lmi::vec4(view[0], view[1], view[2], 1.0f);
+		const auto back = p.unproject(lmi::vec3(clip[0], clip[1], clip[2]) / clip[3]);
+		for(size_t i = 0; i < 3; ++i)
+			EXPECT_NEAR(back[i], view[i], 1e-4f);
+
+		// the ray through the projected point passes through the point
+		const auto ray = p.ray(lmi::vec2(clip[0], clip[1]) / clip[3]);
+		EXPECT_NEAR(lmi::length(lmi::cross(view - ray.origin, ray.direction)), 0.0f, 1e-5f);
+		EXPECT_LT(ray.direction[2], 0.0f);
+	}
+
+	const auto reverse = lmi::perspectiveReverseZ(1.0f, 1.0f, 0.1f, 50.0f) * lmi::vec4(0, 0, -0.1f, 1);
+	EXPECT_FLOAT_EQ(reverse[2] / reverse[3], 1.0f);
+	const auto infinite = lmi::perspective(1.0f, 1.0f, 0.1f) * lmi::vec4(0, 0, -0.1f, 1);
+	EXPECT_FLOAT_EQ(infinite[2] / infinite[3], -1.0f);
+
+	const auto view2 = lmi::lookAt(lmi::vec3(1, 2, 3), lmi::vec3(1, 2, -7), lmi::vec3(0, 1, 0));
+	const auto eye = view2 * lmi::vec4(1, 2, 3, 1);
+	const auto target = view2 * lmi::vec4(1, 2, -7, 1);
+	EXPECT_EQ(eye, lmi::vec4(0, 0, 0, 1));
+	EXPECT_EQ(target, lmi::vec4(0, 0, -10, 1));
+
+	const lmi::Frustum<float> frustum(lmi::perspectiveReverseZ(1.0f, 1.0f, 0.1f, 50.0f), lmi::DepthRange::ZeroToOne);
+	EXPECT_TRUE(frustum.contains(lmi::vec3(0, 0, -10)));
+	EXPECT_FALSE(frustum.contains(lmi::vec3(0, 0, -60)));
+	EXPECT_FALSE(frustum.contains(lmi::vec3(0, 0, -0.05f)));
+}
+
+TEST(TransformHierarchy, propagatesDirtySubtrees)
+{
+	lmi::TransformHierarchy<float> scene;
+	const auto root = scene.add(scene.none, lmi::vec3(1, 0, 0));
+	const auto arm = scene.add(root, lmi::vec3(0, 2, 0), lmi::createRotationQuaternion(lmi::vec3(0, 0, 1), 1.0f));
+	const auto hand = scene.add(arm, lmi::vec3(0, 1, 0), lmi::Quat(1.0f), lmi::vec3(2, 2, 2));
+	const auto other = scene.add(scene.none, lmi::vec3(0, 0, 5));	// shallower than the last node, forces a sort
+	const auto otherChild = scene.add(other, lmi::vec3(0, 0, 1));
+	scene.update(2);
+
+	auto local = [&](lmi::TransformHierarchy<float>::Node n) {
+		const auto &t = scene.translation(n);
+		const auto &s = scene.scale(n);
+		return lmi::translate(t[0], t[1], t[2]) * static_cast<lmi::mat4>(scene.rotation(n)) *
+			   lmi::mat4(s[0], 0, 0, 0, 0, s[1], 0, 0, 0, 0, s[2], 0, 0, 0, 0, 1);
+	};
+	auto expectWorld = [&](lmi::TransformHierarchy<float>::Node n) {
+		lmi::mat4 expected = local(n);
+		for(auto p = scene.parent(n); p != scene.none; p = scene.parent(p))
+			expected = local(p) * expected;
+		for(size_t c = 0; c < 4; ++c)
+			for(size_t r = 0; r < 4; ++r)
+				EXPECT_NEAR(scene.world(n)[c][r], expected[c][r], 1e-5f);
+	};
+
+	for(auto n : {root, arm, hand, other, otherChild})
+		expectWorld(n);
+	EXPECT_EQ(scene.parent(hand), arm);
+
+	const lmi::mat4 untouched = scene.world(otherChild);
+	scene.setRotation(arm, lmi::createRotationQuaternion(lmi::vec3(1, 0, 0), -0.5f));
+	scene.setTranslation(root, lmi::vec3(-3, 0, 1));
+	scene.update();
+	for(auto n : {root, arm, hand, other, otherChild})
+		expectWorld(n);
+	EXPECT_EQ(scene.world(otherChild)[3], untouched[3]);
+}
+
+TEST(TransformHierarchy, doubleStorageIsAligned)
+{
+	// Vector<3, double> and Matrix<4, 4, double> are over aligned with SIMD enabled, which std::allocator does not
+	// honour before C++17.
+	lmi::TransformHierarchy<double> chain;
+	auto node = chain.none;
+	for(int i = 0; i < 50; ++i)
+		node = chain.add(node, lmi::Vector<3, double>(1.0, 0.0, 0.0));
+	chain.update(2);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(&chain.world(node)) % alignof(lmi::Matrix<4, 4, double>), 0u);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(&chain.translation(node)) % alignof(lmi::Vector<3, double>), 0u);
+	EXPECT_DOUBLE_EQ(chain.world(node)[3][0], 50.0);
+
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> vectors;
+	for(size_t n = 1; n < 64; ++n)
+	{
+		vectors.resize(n);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(vectors.data()) % alignof(lmi::Vector<3, double>), 0u);
+	}
+}
+
+TEST(Transform, fusedEulerBuilders)
+{
+	const float a = 0.7f, b = -1.2f, c = 2.5f;
+	const lmi::mat3 elementary[3][3] = {{lmi::rotateX(a), lmi::rotateY(a), lmi::rotateZ(a)},
+										{lmi::rotateX(b), lmi::rotateY(b), lmi::rotateZ(b)},
+										{lmi::rotateX(c), lmi::rotateY(c), lmi::rotateZ(c)}};
+	const lmi::mat3 fused[] = {lmi::rotateEuler<lmi::EulerOrder::XYZ>(a, b, c),
+							   lmi::rotateEuler<lmi::EulerOrder::XZY>(a, b, c),
+							   lmi::rotateEuler<lmi::EulerOrder::YXZ>(a, b, c),
+							   lmi::rotateEuler<lmi::EulerOrder::YZX>(a, b, c),
+							   lmi::rotateEuler<lmi::EulerOrder::ZXY>(a, b, c),
+							   lmi::rotateEuler<lmi::EulerOrder::ZYX>(a, b, c)};
+	const lmi::Quat quaternions[] = {lmi::eulerQuaternion<lmi::EulerOrder::XYZ>(a, b, c),
+									 lmi::eulerQuaternion<lmi::EulerOrder::XZY>(a, b, c),
+									 lmi::eulerQuaternion<lmi::EulerOrder::YXZ>(a, b, c),
+									 lmi::eulerQuaternion<lmi::EulerOrder::YZX>(a, b, c),
+									 lmi::eulerQuaternion<lmi::EulerOrder::ZXY>(a, b, c),
+									 lmi::eulerQuaternion<lmi::EulerOrder::ZYX>(a, b, c)};
+	const size_t axes[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+
+	for(size_t o = 0; o < 6; ++o)
+	{
+		const lmi::mat3 expected = elementary[0][axes[o][0]] * elementary[1][axes[o][1]] * elementary[2][axes[o][2]];
+		const lmi::mat3 fromQuaternion = static_cast<lmi::mat3>(quaternions[o]);
+		for(size_t col = 0; col < 3; ++col)
+			for(size_t r = 0; r < 3; ++r)
+			{
+				EXPECT_NEAR(fused[o][col][r], expected[col][r], 1e-6f);
+				EXPECT_NEAR(fromQuaternion[col][r], expected[col][r], 1e-6f);
+			}
+	}
+
+	const lmi::vec3 axis = lmi::normalize(lmi::vec3(1, 2, -1));
+	const lmi::mat3 axisAngle = lmi::rotateAxisAngle(axis, a);
+	const lmi::mat3 reference = static_cast<lmi::mat3>(lmi::createRotationQuaternion(axis, a));
+	for(size_t col = 0; col < 3; ++col)
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_NEAR(axisAngle[col][r], reference[col][r], 1e-6f);
+
+	const lmi::vec3 angles[2] = {{a, b, c}, {c, a, b}};
+	lmi::mat3 batch[2];
+	lmi::rotateEuler<lmi::EulerOrder::ZYX>(angles, batch, 2);
+	const lmi::mat3 single = lmi::rotateAngles(a, b, c);
+	for(size_t r = 0; r < 3; ++r)
+		EXPECT_FLOAT_EQ(batch[0][1][r], single[1][r]);
+}
+
+TEST(Math, matchesLibm)
+{
+	for(int i = -200; i <= 200; ++i)
+	{
+		const float x = float(i) * 0.173f;
+		const lmi::Vector<8, float> v(x);
+		EXPECT_FLOAT_EQ(lmi::sin(v)[7], std::sin(x));
+		EXPECT_FLOAT_EQ(lmi::cos(v)[7], std::cos(x));
+		EXPECT_NEAR(lmi::sin<lmi::Precision::Fast>(v)[7], std::sin(x), 2e-7f);
+		EXPECT_FLOAT_EQ(lmi::exp(v * 0.25f)[7], std::exp(x * 0.25f));
+		EXPECT_FLOAT_EQ(lmi::log(lmi::abs(v))[0], std::log(std::abs(x)));
+		EXPECT_FLOAT_EQ(lmi::atan2(v, lmi::Vector<8, float>(-1.5f))[3], std::atan2(x, -1.5f));
+		EXPECT_FLOAT_EQ(lmi::acos(v / 34.6f)[0], std::acos(x / 34.6f));
+
+		const lmi::vec4d d(double(i) * 0.173);
+		EXPECT_DOUBLE_EQ(lmi::sin(d)[1], std::sin(d[1]));
+		EXPECT_DOUBLE_EQ(lmi::exp(d * 0.25)[2], std::exp(d[2] * 0.25));
+		EXPECT_NEAR(lmi::pow(lmi::abs(d), 1.5)[3], std::pow(std::abs(d[3]), 1.5), 1e-12);
+	}
+
+	// Arguments close to multiples of pi/2 and beyond the reduction range.
+	const long double halfPi = 1.5707963267948966192313216916397514L;
+	const lmi::vec4d nearMultiples(double(halfPi), double(2 * halfPi), double(1000 * halfPi), double(500000 * halfPi));
+	const lmi::vec4d large(1e6, -3e9, 1e300, std::numeric_limits<double>::infinity());
+	const lmi::vec4 largeF(1e6f, -3e9f, 1e30f, 2e4f);
+	for(size_t i = 0; i < 4; ++i)
+	{
+		EXPECT_DOUBLE_EQ(lmi::sin(nearMultiples)[i], std::sin(nearMultiples[i]));
+		EXPECT_DOUBLE_EQ(lmi::cos(nearMultiples)[i], std::cos(nearMultiples[i]));
+		EXPECT_FLOAT_EQ(lmi::sin<lmi::Precision::Fast>(largeF)[i], std::sin(largeF[i]));
+	}
+	EXPECT_EQ(lmi::sin(large)[0], std::sin(1e6));
+	EXPECT_EQ(lmi::cos(large)[1], std::cos(-3e9));
+	EXPECT_EQ(lmi::sin(large)[2], std::sin(1e300));
+	EXPECT_TRUE(std::isnan(lmi::cos(large)[3]));
+
+	// Odd integers keep the sign of a negative base right up to the largest odd float and double.
+	const lmi::vec4 exponents(4194305.0f, 8388609.0f, 16777215.0f, 16777216.0f);
+	const lmi::vec4 negativeOne(-1.0f);
+	for(size_t i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(lmi::pow(negativeOne, exponents)[i], i < 3 ? -1.0f : 1.0f);
+		EXPECT_EQ(lmi::pow<lmi::Precision::Fast>(negativeOne, exponents)[i], i < 3 ? -1.0f : 1.0f);
+	}
+	const lmi::vec4d largeExponents(4503599627370497.0, 9007199254740991.0, 9007199254740992.0, 5.5);
+	EXPECT_EQ(lmi::pow(lmi::vec4d(-1.0), largeExponents)[1], -1.0);
+	EXPECT_TRUE(std::isnan(lmi::pow(lmi::vec4d(-1.0), largeExponents)[3]));
+	EXPECT_EQ(lmi::pow(lmi::vec4d(-1.0), 4503599627370497.0)[0], -1.0);
+	EXPECT_EQ(lmi::pow(lmi::vec4d(-1.0), 9007199254740992.0)[0], 1.0);
+	EXPECT_EQ(lmi::pow(lmi::vec4(-2.0f), 3.0f)[0], -8.0f);
+	EXPECT_TRUE(std::isnan(lmi::pow(lmi::vec4(-2.0f), 0.5f)[0]));
+
+	// A zero or infinite negative base has a sign for odd integer exponents only.
+	const double inf = std::numeric_limits<double>::infinity();
+	const lmi::vec4d zeroBase = lmi::pow(lmi::vec4d(-0.0), lmi::vec4d(-1.0, 3.0, -2.0, 0.5));
+	EXPECT_EQ(zeroBase[0], -inf);
+	EXPECT_TRUE(zeroBase[1] == 0.0 && std::signbit(zeroBase[1]));
+	EXPECT_EQ(zeroBase[2], inf);
+	EXPECT_TRUE(zeroBase[3] == 0.0 && !std::signbit(zeroBase[3]));
+	const lmi::vec4d infBase = lmi::pow(lmi::vec4d(-inf), lmi::vec4d(3.0, -3.0, 0.5, -2.0));
+	EXPECT_EQ(infBase[0], -inf);
+	EXPECT_TRUE(infBase[1] == 0.0 && std::signbit(infBase[1]));
+	EXPECT_EQ(infBase[2], inf);
+	EXPECT_TRUE(infBase[3] == 0.0 && !std::signbit(infBase[3]));
+	EXPECT_EQ(lmi::pow<lmi::Precision::Fast>(lmi::vec4(-0.0f), -1.0f)[0], -std::numeric_limits<float>::infinity());
+	EXPECT_EQ(lmi::log(lmi::vec4(0.0f))[0], -std::numeric_limits<float>::infinity());
+	EXPECT_EQ(lmi::exp(lmi::vec4d(1000.0))[0], std::numeric_limits<double>::infinity());
+}
+
+TEST(Math, withinOneUlp)
+{
+	// The double kernels against long double libm, which is only a reference where it has more precision.
+	if(std::numeric_limits<long double>::digits < 64)
+		return;
+	const auto ulps = [](double v, long double ref) {
+		const double r = std::abs(double(ref));
+		return double(std::abs(v - ref) / (std::nextafter(r, std::numeric_limits<double>::infinity()) - r));
+	};
+
+	double sinErr = 0, cosErr = 0, tanErr = 0, atan2Err = 0, acosErr = 0, powErr = 0;
+	for(int i = 0; i < 20000; ++i)
+	{
+		const double u = std::fmod(i * 0.6180339887498949, 1.0), w = std::fmod(i * 0.7548776662466927, 1.0);
+		const lmi::vec4d x(u * 200 - 100, (u - 0.5) * 1e5, w * 2 - 1, std::exp(u * 10 - 5));
+		const lmi::vec4d y(w * 4 - 2, u * 120 - 60, u * 2 - 1, std::exp(w * 6 - 3));
+		const lmi::vec4d s = lmi::sin(x), c = lmi::cos(x), t = lmi::tan(x), a = lmi::atan2(y, x);
+		const lmi::vec4d ac = lmi::acos(lmi::vec4d(x[2])), p = lmi::pow(lmi::vec4d(x[3]), y);
+		for(size_t k = 0; k < 4; ++k)
+		{
+			sinErr = std::max(sinErr, ulps(s[k], std::sin(static_cast<long double>(x[k]))));
+			cosErr = std::max(cosErr, ulps(c[k], std::cos(static_cast<long double>(x[k]))));
+			tanErr = std::max(tanErr, ulps(t[k], std::tan(static_cast<long double>(x[k]))));
+			atan2Err = std::max(atan2Err, ulps(a[k], std::atan2(static_cast<long double>(y[k]), x[k])));
+			powErr = std::max(powErr, ulps(p[k], std::pow(static_cast<long double>(x[3]), y[k])));
+		}
+		acosErr = std::max(acosErr, ulps(ac[0], std::acos(static_cast<long double>(x[2]))));
+	}
+	EXPECT_LT(sinErr, 1.0);
+	EXPECT_LT(cosErr, 1.0);
+	EXPECT_LT(tanErr, 1.0);
+	EXPECT_LT(atan2Err, 1.0);
+	EXPECT_LT(acosErr, 1.0);
+	EXPECT_LT(powErr, 1.0);
+
+	const double base = 3.0517405988302513, exponent = -29.836030967571883;
+	EXPECT_LT(ulps(lmi::pow(lmi::vec4d(base), exponent)[0], std::pow(static_cast<long double>(base), exponent)), 1.0);
+}
+
+struct CompiletimeTable
+{
+	double x[32], sin[32], cos[32], tan[32], atan[32], acos[32], sqrt[32];
+};
+
+constexpr CompiletimeTable makeCompiletimeTable()
+{
+	CompiletimeTable t{};
+	for(int i = 0; i < 32; ++i)
+	{
+		t.x[i] = (i - 16) * 0.4375 + 0.1;
+		t.sin[i] = lmi::sin(t.x[i]);
+		t.cos[i] = lmi::cos(t.x[i]);
+		t.tan[i] = lmi::tan(t.x[i]);
+		t.atan[i] = lmi::atan(t.x[i] * 3);
+		t.acos[i] = lmi::acos(t.x[i] / 7.5);
+		t.sqrt[i] = lmi::sqrt(t.x[i] * t.x[i] * 3);
+	}
+	return t;
+}
+
+static_assert(lmi::sqrt(2.0) == 1.4142135623730951, "");
+static_assert(lmi::sqrt(16) == 4.0, "");
+
+TEST(ConstexprMath, correctlyRounded)
+{
+	constexpr CompiletimeTable table = makeCompiletimeTable();
+	for(int i = 0; i < 32; ++i)
+	{
+		// Reference values in long double, rounded once to double.
+		const double x = table.x[i];
+		const long double atanArg = x * 3, acosArg = x / 7.5, sqrtArg = x * x * 3;
+		EXPECT_EQ(table.sin[i], double(std::sin((long double)x)));
+		EXPECT_EQ(table.cos[i], double(std::cos((long double)x)));
+		EXPECT_EQ(table.tan[i], double(std::tan((long double)x)));
+		EXPECT_EQ(table.atan[i], double(std::atan(atanArg)));
+		EXPECT_EQ(table.acos[i], double(std::acos(acosArg)));
+		EXPECT_EQ(table.sqrt[i], double(std::sqrt(sqrtArg)));
+	}
+
+	constexpr lmi::mat3 rotation = lmi::rotateAngles(0.25f, -1.0f, 2.0f);
+	constexpr lmi::Quaternion<float> quaternion = lmi::createRotationQuaternion(lmi::vec3(0, 0, 1), 0.75f);
+	constexpr lmi::Projection<float> projection = lmi::Projection<float>::perspective(1.0f, 1.5f, 0.1f, 100.0f);
+	const lmi::mat3 runtimeRotation = lmi::rotateAngles(0.25f, -1.0f, 2.0f);
+	for(size_t col = 0; col < 3; ++col)
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_FLOAT_EQ(rotation[col][r], runtimeRotation[col][r]);
+	EXPECT_EQ(quaternion[0], float(std::cos(0.375)));
+	EXPECT_EQ(quaternion[3], float(std::sin(0.375)));
+	EXPECT_FLOAT_EQ(projection.matrix()[1][1], 1 / std::tan(0.5f));
+	EXPECT_FLOAT_EQ(projection.inverse()[1][1], std::tan(0.5f));
+}
+
+template <size_t WIDTH>
+void checkBvh(const std::vector<lmi::vec3> &vertices, const std::vector<uint32_t> &indices, size_t threads)
+{
+	const size_t triangles = indices.size() / 3;
+	const lmi::TriangleBvh<float, WIDTH> bvh(vertices.data(), indices.data(), triangles, threads);
+
+	std::vector<lmi::Ray<float>> rays;
+	for(int i = 0; i < 61; ++i)
+	{
+		const float a = float(i) * 0.37f, b = float(i % 7) * 0.2f - 0.6f;
+		rays.push_back({lmi::vec3(0, 0, 0), lmi::vec3(std::cos(a), b, std::sin(a))});
+	}
+	std::vector<lmi::RayHit<float>> hits(rays.size()), packetHits(rays.size());
+	bvh.intersect(rays.data(), hits.data(), rays.size(), threads);
+	bvh.intersectPackets(rays.data(), packetHits.data(), rays.size(), threads);
+
+	size_t hitCount = 0;
+	for(size_t r = 0; r < rays.size(); ++r)
+	{
+		// Brute force Möller-Trumbore over every triangle.
+		const auto &ray = rays[r];
+		float closest = std::numeric_limits<float>::infinity();
+		uint32_t primitive = lmi::RayHit<float>::none;
+		for(size_t i = 0; i < triangles; ++i)
+		{
+			const lmi::vec3 &a = vertices[indices[3 * i]];
+			const lmi::vec3 e1 = vertices[indices[3 * i + 1]] - a, e2 = vertices[indices[3 * i + 2]] - a;
+			const lmi::vec3 p = lmi::cross(ray.direction, e2), s = ray.origin - a, q = lmi::cross(s, e1);
+			const float invDet = 1 / lmi::dot(e1, p);
+			const float u = lmi::dot(s, p) * invDet, v = lmi::dot(ray.direction, q) * invDet;
+			const float t = lmi::dot(e2, q) * invDet;
+			if(u >= 0 && v >= 0 && u + v <= 1 && t > 0 && t < closest)
+			{
+				closest = t;
+				primitive = uint32_t(i);
+			}
+		}
+
+		EXPECT_EQ(hits[r].primitive, primitive);
+		EXPECT_EQ(packetHits[r].primitive, primitive);
+		EXPECT_EQ(bvh.occluded(ray), primitive != lmi::RayHit<float>::none);
+		if(primitive != lmi::RayHit<float>::none)
+		{
+			++hitCount;
+			EXPECT_NEAR(hits[r].t, closest, 1e-5f * closest);
+			EXPECT_NEAR(packetHits[r].t, closest, 1e-5f * closest);
+			EXPECT_FALSE(bvh.occluded(ray, 0.0f, closest * 0.99f));
+		}
+	}
+	EXPECT_GT(hitCount, 0u);
+	EXPECT_LT(hitCount, rays.size());
+
+	// Leaves cover every triangle exactly once.
+	std::vector<int> seen(triangles);
+	for(uint32_t p : bvh.bvh().primitives())
+		++seen[p];
+	EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), std::ptrdiff_t(triangles));
+}
+
+TEST(Bvh, matchesBruteForce)
+{
+	// Small triangles scattered on a partial shell around the origin, enough for the parallel top level build.
+	std::vector<lmi::vec3> vertices;
+	std::vector<uint32_t> indices;
+	unsigned seed = 7;
+	auto random = [&seed](float min, float max) {
+		seed = seed * 1664525u + 1013904223u;
+		return min + (max - min) * float(seed >> 8) / float(1u << 24);
+	};
+	for(uint32_t i = 0; i < 40000; ++i)
+	{
+		const float a = random(0, 5), b = random(-0.5f, 0.5f), radius = random(5, 50);
+		const lmi::vec3 center(radius * std::cos(a), radius * b, radius * std::sin(a));
+		for(uint32_t k = 0; k < 3; ++k)
+		{
+			vertices.push_back(center + lmi::vec3(random(-1, 1), random(-1, 1), random(-1, 1)));
+			indices.push_back(3 * i + k);
+		}
+	}
+
+	checkBvh<4>(vertices, indices, 1);
+	checkBvh<8>(vertices, indices, 4);
+
+	std::vector<lmi::vec3> boxMin = {lmi::vec3(0, 0, 0), lmi::vec3(2, 0, 0)};
+	std::vector<lmi::vec3> boxMax = {lmi::vec3(1, 1, 1), lmi::vec3(3, 1, 1)};
+	const lmi::Bvh<float, 4> boxes(boxMin.data(), boxMax.data(), 2);
+	std::vector<uint32_t> overlapping;
+	boxes.overlap(lmi::vec3(2.5f, 0.5f, 0.5f), lmi::vec3(4, 4, 4), [&](uint32_t p) { overlapping.push_back(p); });
+	EXPECT_EQ(overlapping, std::vector<uint32_t>{1});
+
+	// Double precision, whose over aligned Vectors the build keeps in its own containers.
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> verticesD(vertices.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
+		verticesD[i] = lmi::Vector<3, double>(vertices[i][0], vertices[i][1], vertices[i][2]);
+	const lmi::TriangleBvh<double, 4> bvhD(verticesD.data(), indices.data(), indices.size() / 3, 4);
+	for(size_t i = 0; i < indices.size(); i += 3 * 997)
+	{
+		const lmi::Vector<3, double> centroid = (verticesD[i] + verticesD[i + 1] + verticesD[i + 2]) / 3.0;
+		const lmi::RayHit<double> hit = bvhD.intersect(lmi::Ray<double>{lmi::Vector<3, double>(), centroid});
+		EXPECT_NE(hit.primitive, lmi::RayHit<double>::none);
+		EXPECT_LE(hit.t, 1.0 + 1e-12);
+	}
+}
+
+TEST(Bvh, axisAlignedRaysOnSlabPlanes)
+{
+	// A flat 8x8 grid at y = 0, hit by vertical rays along the grid lines, where the origins lie on the bounds of
+	// many nodes and their zero direction components turn the slab distances into 0 * inf.
+	std::vector<lmi::vec3> vertices;
+	std::vector<uint32_t> indices;
+	for(uint32_t z = 0; z <= 8; ++z)
+		for(uint32_t x = 0; x <= 8; ++x)
+			vertices.push_back(lmi::vec3(float(x), 0, float(z)));
+	for(uint32_t z = 0; z < 8; ++z)
+		for(uint32_t x = 0; x < 8; ++x)
+		{
+			const uint32_t i = z * 9 + x;
+			indices.insert(indices.end(), {i, i + 9, i + 1, i + 1, i + 9, i + 10});
+		}
+	const lmi::TriangleBvh<float, 4> bvh(vertices.data(), indices.data(), indices.size() / 3);
+
+	std::vector<lmi::Ray<float>> rays;
+	for(int z = 0; z <= 16; ++z)
+		for(int x = 0; x <= 16; ++x)
+		{
+			const float zero = (x + z) % 2 ? -0.0f : 0.0f;
+			rays.push_back({lmi::vec3(float(x) * 0.5f, 10, float(z) * 0.5f), lmi::vec3(zero, -1, zero)});
+		}
+	std::vector<lmi::RayHit<float>> hits(rays.size()), packetHits(rays.size());
+	bvh.intersect(rays.data(), hits.data(), rays.size());
+	bvh.intersectPackets(rays.data(), packetHits.data(), rays.size());
+	for(size_t r = 0; r < rays.size(); ++r)
+	{
+		EXPECT_NE(hits[r].primitive, lmi::RayHit<float>::none);
+		EXPECT_FLOAT_EQ(hits[r].t, 10.0f);
+		EXPECT_NE(packetHits[r].primitive, lmi::RayHit<float>::none);
+		EXPECT_FLOAT_EQ(packetHits[r].t, 10.0f);
+		EXPECT_TRUE(bvh.occluded(rays[r]));
+	}
+}
+
+static_assert(lmi::mortonEncode(lmi::vec3ui(1, 2, 4)) == 0b100010001, "");
+static_assert(lmi::mortonDecode2(lmi::mortonEncode(lmi::vec2ui(0xffffffffu, 12345))) == lmi::vec2ui(0xffffffffu, 12345),
+			  "");
+
+template <size_t DIM>
+void checkHilbertAdjacency()
+{
+	// The first 4^DIM keys fill the cells [0, 4)^DIM, one step apart each.
+	std::vector<std::pair<uint64_t, lmi::Vector<DIM, unsigned>>> cells;
+	for(unsigned i = 0; i < (1u << (2 * DIM)); ++i)
+	{
+		lmi::Vector<DIM, unsigned> cell;
+		for(size_t a = 0; a < DIM; ++a)
+			cell[a] = (i >> (2 * a)) & 3;
+		cells.push_back({lmi::hilbertEncode(cell), cell});
+	}
+	std::sort(cells.begin(), cells.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	for(size_t i = 0; i < cells.size(); ++i)
+	{
+		EXPECT_EQ(cells[i].first, i);
+		if(i == 0)
+			continue;
+		unsigned distance = 0;
+		for(size_t a = 0; a < DIM; ++a)
+			distance += unsigned(std::abs(int(cells[i].second[a]) - int(cells[i - 1].second[a])));
+		EXPECT_EQ(distance, 1u);
+	}
+}
+
+TEST(SpatialOrder, curvesAndRadixSort)
+{
+	for(unsigned i = 0; i < 1000; ++i)
+	{
+		const lmi::vec3ui cell(i * 2654435761u & 0x1fffff, i * 40503u & 0x1fffff, (i << 11) & 0x1fffff);
+		EXPECT_EQ(lmi::mortonDecode3(lmi::mortonEncode(cell)), cell);
+	}
+	checkHilbertAdjacency<2>();
+	checkHilbertAdjacency<3>();
+	EXPECT_EQ(lmi::mortonEncode(lmi::vec2(1, 1), lmi::vec2(0, 0), lmi::vec2(1, 1)), ~uint64_t{0});
+	EXPECT_EQ(lmi::hilbertEncode(lmi::vec3(-1, 0, 0), lmi::vec3(0, 0, 0), lmi::vec3(1, 1, 1)), 0u);
+
+	const size_t count = 100000;
+	std::vector<uint64_t> keys(count);
+	uint64_t seed = 3;
+	for(auto &k : keys)
+	{
+		seed = seed * 6364136223846793005u + 1442695040888963407u;
+		k = (seed >> 20) & 0xffff0000ffffu;
+	}
+	std::vector<uint32_t> expected(count), order(count);
+	for(size_t i = 0; i < count; ++i)
+		expected[i] = uint32_t(i);
+	std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+	auto sorted = keys;
+	lmi::radixSort(sorted.data(), order.data(), count, 4, 48);
+	EXPECT_EQ(order, expected);
+	for(size_t i = 0; i < count; ++i)
+		ASSERT_EQ(sorted[i], keys[order[i]]);
+
+	std::vector<lmi::vec3> points(count);
+	std::vector<uint32_t> payload(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		points[i] = lmi::vec3(float(i % 97), float(i % 89), float(i % 83));
+		payload[i] = uint32_t(i);
+	}
+	const auto original = points;
+	const auto spatial = lmi::spatialSort(lmi::SpaceFillingCurve::Hilbert, points.data(), count, 3, payload.data());
+	EXPECT_EQ(spatial, payload);
+	for(size_t i = 0; i < count; ++i)
+		ASSERT_EQ(points[i], original[spatial[i]]);
+
+	// Neighbours in the sorted array are mostly close in space.
+	float total = 0;
+	for(size_t i = 1; i < count; ++i)
+		total += lmi::length(points[i] - points[i - 1]);
+	EXPECT_LT(total / count, 5.0f);
+
+	// Double precision points go through the over aligned scratch copies as well.
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> pointsD(1000);
+	for(size_t i = 0; i < pointsD.size(); ++i)
+		pointsD[i] = lmi::Vector<3, double>(double(i % 7), double(i % 11), double(i % 13));
+	const auto originalD = pointsD;
+	const auto orderD = lmi::spatialSort(lmi::SpaceFillingCurve::Morton, pointsD.data(), pointsD.size(), 4);
+	for(size_t i = 0; i < pointsD.size(); ++i)
+		ASSERT_EQ(pointsD[i], originalD[orderD[i]]);
+}
+
+template <size_t DIM>
+void checkKdTree(size_t count, size_t threads)
+{
+	std::vector<lmi::Vector<DIM, float>> points(count), queries(50);
+	unsigned seed = 11;
+	auto random = [&seed] {
+		seed = seed * 1664525u + 1013904223u;
+		return float(seed >> 8) / float(1u << 24);
+	};
+	for(auto &p : points)
+		for(size_t a = 0; a < DIM; ++a)
+			p[a] = random() * (a == 0 ? 10.0f : 1.0f);
+	for(auto &q : queries)
+		for(size_t a = 0; a < DIM; ++a)
+			q[a] = random() * 10.0f - 2.0f;
+
+	const lmi::KdTree<DIM, float> tree(points.data(), count, threads);
+	const size_t k = 8;
+	std::vector<uint32_t> indices(queries.size() * k);
+	std::vector<float> distances(queries.size() * k);
+	tree.nearest(queries.data(), queries.size(), k, indices.data(), distances.data(), threads);
+
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		std::vector<std::pair<float, uint32_t>> expected;
+		for(size_t i = 0; i < count; ++i)
+		{
+			const auto d = points[i] - queries[q];
+			expected.push_back({lmi::dot(d, d), uint32_t(i)});
+		}
+		std::sort(expected.begin(), expected.end());
+		for(size_t j = 0; j < std::min(k, count); ++j)
+		{
+			EXPECT_EQ(distances[q * k + j], expected[j].first);
+			EXPECT_EQ(lmi::dot(points[indices[q * k + j]] - queries[q], points[indices[q * k + j]] - queries[q]),
+					  expected[j].first);
+		}
+		for(size_t j = count; j < k; ++j)
+			EXPECT_EQ(indices[q * k + j], (lmi::KdTree<DIM, float>::none));
+
+		const float radius = 0.5f;
+		size_t inside = 0;
+		tree.radius(queries[q], radius, [&](uint32_t i, float d) {
+			EXPECT_LT(d, radius * radius);
+			EXPECT_EQ(d, lmi::dot(points[i] - queries[q], points[i] - queries[q]));
+			++inside;
+		});
+		EXPECT_EQ(inside, size_t(std::count_if(expected.begin(), expected.end(), [&](const auto &e) {
+					  return e.first < radius * radius;
+				  })));
+	}
+}
+
+TEST(KdTree, matchesBruteForce)
+{
+	checkKdTree<3>(20000, 1);
+	checkKdTree<3>(20000, 4);
+	checkKdTree<2>(5000, 3);
+	checkKdTree<3>(5, 1);
+
+	// Double precision, whose points are over aligned inside the build's items.
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> points(100);
+	for(size_t i = 0; i < points.size(); ++i)
+		points[i] = lmi::Vector<3, double>(double(i % 17), double(i % 19) * 0.5, double(i % 23) * 0.25);
+	const lmi::KdTree<3, double> tree(points.data(), points.size(), 4);
+	const lmi::Vector<3, double> query(3.2, 4.1, 2.6);
+	uint32_t index;
+	double distance;
+	tree.nearest(&query, 1, 1, &index, &distance);
+	double closest = std::numeric_limits<double>::infinity();
+	for(const auto &p : points)
+		closest = std::min(closest, lmi::dot(p - query, p - query));
+	EXPECT_EQ(distance, closest);
+}
+
+TEST(HashGrid, neighboursAndWelding)
+{
+	// A 20^3 lattice with spacing 1, every vertex repeated three times with a jitter below 0.01.
+	std::vector<lmi::vec3> vertices;
+	unsigned seed = 5;
+	auto jitter = [&seed] {
+		seed = seed * 1664525u + 1013904223u;
+		return (float(seed >> 8) / float(1u << 24) - 0.5f) * 0.01f;
+	};
+	for(int copy = 0; copy < 3; ++copy)
+		for(int i = 0; i < 8000; ++i)
+			vertices.push_back(lmi::vec3(float(i % 20) + jitter(), float(i / 20 % 20) - 10 + jitter(), float(i / 400)));
+
+	std::vector<uint32_t> remap(vertices.size());
+	std::vector<lmi::vec3> unique(vertices.size());
+	const size_t kept = lmi::weldVertices(vertices.data(), vertices.size(), 0.02f, remap.data(), unique.data(), 2);
+	EXPECT_EQ(kept, 8000u);
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		ASSERT_EQ(remap[i], i % 8000);
+		EXPECT_LE(lmi::length(unique[remap[i]] - vertices[i]), 0.02f);
+	}
+	EXPECT_EQ(lmi::weldVertices(vertices.data(), vertices.size(), 0.0f, remap.data()), vertices.size());
+
+	lmi::HashGrid<float> grid(1.5f);
+	grid.build(vertices.data(), vertices.size(), 3);
+	EXPECT_EQ(grid.size(), vertices.size());
+	for(const lmi::vec3 p : {lmi::vec3(0, 0, 0), lmi::vec3(5.5f, -3.2f, 7.9f), lmi::vec3(-40, 0, 0)})
+	{
+		size_t found = 0;
+		grid.forEachNeighbour(p, 1.7f, [&](uint32_t i, float d2) {
+			EXPECT_LE(d2, 1.7f * 1.7f);
+			EXPECT_EQ(d2, lmi::dot(vertices[i] - p, vertices[i] - p));
+			++found;
+		});
+		size_t expected = 0;
+		for(const auto &v : vertices)
+			expected += lmi::dot(v - p, v - p) <= 1.7f * 1.7f;
+		EXPECT_EQ(found, expected);
+	}
+
+	// Double precision, whose sorted copies of the points are over aligned.
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> verticesD(90);
+	for(size_t i = 0; i < verticesD.size(); ++i)
+		verticesD[i] = lmi::Vector<3, double>(double(i % 30), 0.001 * double(i / 30), 1.0);
+	std::vector<uint32_t> remapD(verticesD.size());
+	EXPECT_EQ(lmi::weldVertices(verticesD.data(), verticesD.size(), 0.01, remapD.data(), verticesD.data(), 2), 30u);
+	EXPECT_EQ(remapD[89], 29u);
+}
+
+TEST(Bounds, fitsContainPoints)
+{
+	// An elongated, rotated box of points away from the origin, plus points on a sphere.
+	const lmi::mat3 rotation = lmi::rotateAngles(0.4f, -0.3f, 1.1f);
+	const lmi::vec3 offset(100, -50, 20);
+	std::vector<lmi::vec3> points;
+	unsigned seed = 9;
+	auto random = [&seed](float min, float max) {
+		seed = seed * 1664525u + 1013904223u;
+		return min + (max - min) * float(seed >> 8) / float(1u << 24);
+	};
+	for(int i = 0; i < 10000; ++i)
+		points.push_back(rotation * lmi::vec3(random(-8, 8), random(-2, 2), random(-0.5f, 0.5f)) + offset);
+
+	const lmi::Aabb<float> box = lmi::fitAabb(points.data(), points.size(), 3);
+	lmi::Aabb<float> streamed = lmi::fitAabb(points.data(), 4000);
+	streamed.merge(lmi::fitAabb(points.data() + 4000, points.size() - 4000));
+	lmi::Aabb<float> expected;
+	for(const auto &p : points)
+		expected.merge(p);
+	EXPECT_EQ(box.min, expected.min);
+	EXPECT_EQ(box.max, expected.max);
+	EXPECT_EQ(streamed.min, expected.min);
+	EXPECT_EQ(streamed.max, expected.max);
+
+	const lmi::Obb<float> obb = lmi::fitObb(points.data(), points.size(), 4);
+	EXPECT_NEAR(std::abs(lmi::dot(obb.axes[0], rotation[0])), 1.0f, 1e-3f);
+	EXPECT_NEAR(lmi::dot(obb.axes[2], lmi::cross(obb.axes[0], obb.axes[1])), 1.0f, 1e-5f);
+	EXPECT_NEAR(obb.halfExtents[0], 8.0f, 0.05f);
+	EXPECT_NEAR(obb.halfExtents[2], 0.5f, 0.05f);
+	for(const auto &p : points)
+		for(size_t a = 0; a < 3; ++a)
+			ASSERT_LE(std::abs(lmi::dot(obb.axes[a], p - obb.center)), obb.halfExtents[a] + 1e-3f);
+
+	const lmi::Covariance<float> whole = lmi::fitCovariance(points.data(), points.size());
+	lmi::Covariance<float> parts = lmi::fitCovariance(points.data(), 3000, 2);
+	parts.merge(lmi::fitCovariance(points.data() + 3000, points.size() - 3000, 3));
+	EXPECT_EQ(parts.count, whole.count);
+	for(size_t c = 0; c < 3; ++c)
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_NEAR(parts.matrix()[c][r], whole.matrix()[c][r], 1e-3f);
+
+	const lmi::vec3 center(1, 2, 3);
+	std::vector<lmi::vec3> sphere;
+	for(int i = 0; i < 2000; ++i)
+	{
+		const float z = random(-1, 1), a = random(0, 6.2831853f), r = std::sqrt(1 - z * z);
+		sphere.push_back(center + lmi::vec3(r * std::cos(a), r * std::sin(a), z) * 3.0f * random(0.9f, 1.0f));
+	}
+	const lmi::Sphere<float> fitted = lmi::fitSphere(sphere.data(), sphere.size(), 4);
+	const lmi::Sphere<float> minimal = lmi::minimalSphere(sphere.data(), sphere.size());
+	EXPECT_LE(minimal.radius, fitted.radius * 1.0001f);
+	EXPECT_LT(fitted.radius, 3.0f * 1.1f);
+	EXPECT_NEAR(minimal.radius, 3.0f, 0.05f);
+	EXPECT_LT(lmi::length(minimal.center - center), 0.1f);
+	for(const auto &p : sphere)
+	{
+		ASSERT_LE(lmi::length(p - fitted.center), fitted.radius * 1.0001f);
+		ASSERT_LE(lmi::length(p - minimal.center), minimal.radius * 1.0001f);
+	}
+
+	// Double precision, through the over aligned per chunk results and the shuffled copy.
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> sphereD(sphere.size());
+	for(size_t i = 0; i < sphere.size(); ++i)
+		sphereD[i] = lmi::Vector<3, double>(sphere[i][0], sphere[i][1], sphere[i][2]);
+	EXPECT_NEAR(lmi::minimalSphere(sphereD.data(), sphereD.size()).radius, minimal.radius, 1e-4);
+	EXPECT_NEAR(lmi::fitSphere(sphereD.data(), sphereD.size(), 4).radius, fitted.radius, 1e-4);
+	EXPECT_EQ(lmi::fitAabb(sphereD.data(), sphereD.size(), 4).max[0],
+			  lmi::fitAabb(sphere.data(), sphere.size()).max[0]);
+	EXPECT_NEAR(lmi::fitCovariance(sphereD.data(), sphereD.size(), 4).matrix()[0][0],
+				lmi::fitCovariance(sphere.data(), sphere.size()).matrix()[0][0], 1e-3);
+}
+
+TEST(Mesh, normalsAndTangentFrames)
+{
+	// Latitude/longitude sphere band without the degenerate pole triangles, 22 x 48 quads.
+	const uint32_t rings = 24, segments = 48;
+	std::vector<lmi::vec3> positions;
+	std::vector<uint32_t> indices;
+	for(uint32_t r = 1; r < rings; ++r)
+		for(uint32_t s = 0; s < segments; ++s)
+		{
+			const float theta = 3.14159265f * float(r) / float(rings), phi = 6.2831853f * float(s) / float(segments);
+			positions.push_back(lmi::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+										  std::cos(theta)) * 2.0f);
+		}
+	for(uint32_t r = 0; r < rings - 2; ++r)
+		for(uint32_t s = 0; s < segments; ++s)
+		{
+			const uint32_t a = r * segments + s, b = r * segments + (s + 1) % segments;
+			for(uint32_t i : {a, a + segments, b, b, a + segments, b + segments})
+				indices.push_back(i);
+		}
+
+	const lmi::VertexAdjacency adjacency(indices.data(), indices.size() / 3, positions.size());
+	std::vector<lmi::vec3> area(positions.size()), angle(positions.size()), serial(positions.size());
+	lmi::computeNormals(positions.data(), indices.data(), adjacency, area.data(), lmi::NormalWeighting::Area, 4);
+	lmi::computeNormals(positions.data(), indices.data(), adjacency, angle.data(), lmi::NormalWeighting::Angle, 3);
+	lmi::computeNormals(positions.data(), positions.size(), indices.data(), indices.size() / 3, serial.data());
+	for(size_t v = 0; v < positions.size(); ++v)
+	{
+		EXPECT_EQ(area[v], serial[v]);
+		if(v < segments || v >= positions.size() - segments)
+			continue;
+		EXPECT_GT(lmi::dot(area[v], lmi::normalize(positions[v])), 0.995f);
+		EXPECT_GT(lmi::dot(angle[v], lmi::normalize(positions[v])), 0.995f);
+	}
+
+	// Planar grid in the xy plane, once with uv = (x, y) and once mirrored and rotated to uv = (y, x).
+	std::vector<lmi::vec3> grid, normals;
+	std::vector<lmi::vec2> uvs, mirrored;
+	std::vector<uint32_t> quads;
+	for(uint32_t y = 0; y < 4; ++y)
+		for(uint32_t x = 0; x < 4; ++x)
+		{
+			grid.push_back(lmi::vec3(float(x), float(y), 0));
+			uvs.push_back(lmi::vec2(float(x) / 3, float(y) / 3));
+			mirrored.push_back(lmi::vec2(float(y) / 3, float(x) / 3));
+		}
+	for(uint32_t y = 0; y < 3; ++y)
+		for(uint32_t x = 0; x < 3; ++x)
+			for(uint32_t i : {0u, 1u, 5u, 0u, 5u, 4u})
+				quads.push_back(y * 4 + x + i);
+	const lmi::VertexAdjacency gridAdjacency(quads.data(), quads.size() / 3, grid.size());
+	normals.resize(grid.size());
+	lmi::computeNormals(grid.data(), quads.data(), gridAdjacency, normals.data());
+	std::vector<lmi::vec4> tangents(grid.size()), mirroredTangents(grid.size());
+	lmi::computeTangents(grid.data(), normals.data(), uvs.data(), quads.data(), gridAdjacency, tangents.data(), 2);
+	lmi::computeTangents(grid.data(), normals.data(), mirrored.data(), quads.data(), gridAdjacency,
+						 mirroredTangents.data());
+	for(size_t v = 0; v < grid.size(); ++v)
+	{
+		EXPECT_EQ(normals[v], lmi::vec3(0, 0, 1));
+		EXPECT_NEAR(tangents[v][0], 1.0f, 1e-6f);
+		EXPECT_EQ(tangents[v][3], 1.0f);
+		EXPECT_NEAR(mirroredTangents[v][1], 1.0f, 1e-6f);
+		EXPECT_EQ(mirroredTangents[v][3], -1.0f);
+
+		for(const lmi::vec4 &t : {tangents[v], mirroredTangents[v]})
+		{
+			lmi::vec4 decoded;
+			const lmi::vec3 n = lmi::decodeTangentFrame(lmi::encodeTangentFrame(normals[v], t), decoded);
+			EXPECT_LT(lmi::length(n - normals[v]), 1e-5f);
+			EXPECT_LT(lmi::length(decoded - t), 1e-5f);
+		}
+	}
+
+	// A frame whose quaternion has w = 0 keeps its handedness through the bias.
+	const lmi::vec4 flipped(-1, 0, 0, -1);
+	lmi::vec4 decoded;
+	const lmi::Quaternion<float> q = lmi::encodeTangentFrame(lmi::vec3(0, 0, -1), flipped);
+	EXPECT_LT(q[0], 0.0f);
+	EXPECT_LT(lmi::length(lmi::decodeTangentFrame(q, decoded) - lmi::vec3(0, 0, -1)), 1e-4f);
+	EXPECT_LT(lmi::length(decoded - flipped), 1e-4f);
+}
+
+TEST(VertexPipeline, matchesSeparateTransforms)
+{
+	const lmi::mat4 model = lmi::translate(1.0f, -2.0f, 0.5f);
+	const lmi::mat4 view = lmi::lookAt(lmi::vec3(0, 3, 10), lmi::vec3(0, 0, 0), lmi::vec3(0, 1, 0));
+	const lmi::mat4 projection = lmi::perspective(1.0f, 1.5f, 0.5f, 50.0f);
+	const lmi::Viewport<float> viewport{10, 20, 640, 480, 0.25f, 0.75f};
+
+	std::vector<lmi::vec3> positions;
+	for(int i = 0; i < 1000; ++i)
+		positions.push_back(lmi::vec3(float(i % 17) - 8, float(i % 13) - 6, float(i % 29) - 14) * 1.5f);
+
+	std::vector<lmi::vec4> clip(positions.size());
+	std::vector<uint8_t> outcodes(positions.size());
+	std::vector<lmi::vec3> ndc(positions.size()), screen(positions.size());
+	const lmi::VertexPipeline<float> pipeline(model, view, projection, viewport);
+	pipeline.process(positions.data(), positions.size(), {clip.data(), outcodes.data(), ndc.data(), screen.data()}, 3);
+
+	size_t inside = 0;
+	for(size_t i = 0; i < positions.size(); ++i)
+	{
+		const lmi::vec4 p(positions[i][0], positions[i][1], positions[i][2], 1.0f);
+		const lmi::vec4 c = projection * (view * (model * p));
+		for(size_t k = 0; k < 4; ++k)
+			EXPECT_NEAR(clip[i][k], c[k], 1e-4f * (1 + std::abs(c[k])));
+
+		const unsigned expected = (c[0] < -c[3]) * 1u | (c[0] > c[3]) * 2u | (c[1] < -c[3]) * 4u | (c[1] > c[3]) * 8u |
+								  (c[2] < -c[3]) * 16u | (c[2] > c[3]) * 32u;
+		const float margin = 1e-4f * (1 + std::abs(c[3]));
+		if(std::abs(std::abs(c[0]) - c[3]) > margin && std::abs(std::abs(c[1]) - c[3]) > margin &&
+		   std::abs(std::abs(c[2]) - c[3]) > margin)
+		{
+			EXPECT_EQ(outcodes[i], expected);
+		}
+		if(outcodes[i] != 0)
+			continue;
+
+		++inside;
+		EXPECT_NEAR(ndc[i][0], c[0] / c[3], 1e-5f);
+		EXPECT_NEAR(screen[i][0], 10 + (c[0] / c[3] + 1) * 320, 1e-3f);
+		EXPECT_NEAR(screen[i][1], 20 + (c[1] / c[3] + 1) * 240, 1e-3f);
+		EXPECT_NEAR(screen[i][2], 0.25f + (c[2] / c[3] + 1) / 4, 1e-5f);
+	}
+	EXPECT_GT(inside, 0u);
+	EXPECT_LT(inside, positions.size());
+
+	// Only screen positions, y down, and a batch entirely behind the camera.
+	const lmi::VertexPipeline<float> flipped(model, view, projection, {0, 480, 640, -480});
+	lmi::VertexStreams<float> streams;
+	streams.screen = screen.data();
+	EXPECT_EQ(flipped.process(positions.data(), positions.size(), streams), 0u);
+	for(size_t i = 0; i < positions.size(); ++i)
+	{
+		if(outcodes[i] == 0)
+		{
+			EXPECT_NEAR(screen[i][1], 480 - (ndc[i][1] + 1) * 240, 1e-3f);
+		}
+	}
+	const lmi::vec3 behind[] = {lmi::vec3(0, 0, 20), lmi::vec3(1, 0, 30)};
+	EXPECT_NE(pipeline.process(behind, 2, streams) & lmi::OutsideNear, 0);
+	EXPECT_EQ(pipeline.process(behind, 0, streams), 0u);
+}
+
+TEST(Occlusion, hidesBoxesBehindOccluders)
+{
+	// A wall of 8 x 8 quads at z = -5 in front of a camera at the origin, seen through normal and reverse-Z depth.
+	std::vector<lmi::vec3> vertices;
+	std::vector<uint32_t> indices;
+	for(int y = 0; y <= 8; ++y)
+		for(int x = 0; x <= 8; ++x)
+			vertices.push_back(lmi::vec3(float(x) / 2 - 2, float(y) / 2 - 2, -5));
+	for(uint32_t y = 0; y < 8; ++y)
+		for(uint32_t x = 0; x < 8; ++x)
+		{
+			const uint32_t i = y * 9 + x;
+			for(uint32_t v : {i, i + 1, i + 10, i, i + 10, i + 9})
+				indices.push_back(v);
+		}
+
+	auto box = [](lmi::vec3 min, lmi::vec3 max) {
+		lmi::Aabb<float> b;
+		b.merge(min);
+		b.merge(max);
+		return b;
+	};
+	const lmi::Aabb<float> boxes[] = {
+		box(lmi::vec3(-1, -1, -12), lmi::vec3(1, 1, -10)),	  // Behind the wall.
+		box(lmi::vec3(6, -1, -12), lmi::vec3(7, 1, -10)),	  // Beside it.
+		box(lmi::vec3(-1, -1, -4), lmi::vec3(1, 1, -3)),	  // In front of it.
+		box(lmi::vec3(1.5f, -1, -12), lmi::vec3(6, 1, -10)),  // Partially behind it.
+		box(lmi::vec3(-1, -1, 3), lmi::vec3(1, 1, 4)),		  // Behind the camera.
+		box(lmi::vec3(-1, -1, -6), lmi::vec3(1, 1, 1)),		  // Crossing the near plane.
+	};
+	const bool expected[] = {false, true, true, true, false, true};
+
+	for(bool reverse : {false, true})
+	{
+		const lmi::mat4 projection =
+			reverse ? lmi::perspectiveReverseZ(1.2f, 1.6f, 0.5f, 100.0f) : lmi::perspective(1.2f, 1.6f, 0.5f, 100.0f);
+		const lmi::DepthRange range = reverse ? lmi::DepthRange::ZeroToOne : lmi::DepthRange::NegativeOneToOne;
+		lmi::OcclusionBuffer<float> serial(200, 125, range, reverse), threaded(200, 125, range, reverse);
+		serial.render(vertices.data(), vertices.size(), indices.data(), indices.size() / 3, projection);
+		threaded.render(vertices.data(), vertices.size(), indices.data(), indices.size() / 3, projection, 4);
+		EXPECT_TRUE(std::equal(serial.depth(), serial.depth() + 200 * 125, threaded.depth()));
+
+		// No pixel center strictly inside the wall may be left uncovered at a shared edge.
+		const float center = serial.depth()[62 * 200 + 100];
+		EXPECT_LT(center, 1.0f);
+		for(size_t y = 50; y < 75; ++y)
+			for(size_t x = 80; x < 120; ++x)
+				EXPECT_FLOAT_EQ(serial.depth()[y * 200 + x], center);
+
+		uint8_t batch[6];
+		serial.visible(boxes, 6, projection, batch, 2);
+		for(size_t i = 0; i < 6; ++i)
+		{
+			EXPECT_EQ(serial.visible(boxes[i], projection), expected[i]) << i << (reverse ? " reverse" : "");
+			EXPECT_EQ(bool(batch[i]), expected[i]);
+		}
+
+		serial.clear();
+		EXPECT_TRUE(serial.visible(boxes[0], projection));
+	}
+
+	// The double buffer keeps its projected vertices in 32 byte aligned Vectors.
+	auto toDouble = [](lmi::vec3 v) { return lmi::Vector<3, double>(v[0], v[1], v[2]); };
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> verticesD(vertices.size());
+	std::transform(vertices.begin(), vertices.end(), verticesD.begin(), toDouble);
+	const lmi::Matrix<4, 4, double> projectionD = lmi::perspective(1.2, 1.6, 0.5, 100.0);
+	lmi::OcclusionBuffer<double> buffer(200, 125);
+	buffer.render(verticesD.data(), verticesD.size(), indices.data(), indices.size() / 3, projectionD, 2);
+	for(size_t i = 0; i < 6; ++i)
+	{
+		lmi::Aabb<double> b;
+		b.merge(toDouble(boxes[i].min));
+		b.merge(toDouble(boxes[i].max));
+		EXPECT_EQ(buffer.visible(b, projectionD), expected[i]) << i << " double";
+	}
+}
+
+TEST(Curve, batchAndForwardDifferencesMatchReference)
+{
+	// Unit circle from four Bezier quarter arcs.
+	const float k = 0.5522847f;
+	const lmi::vec2 arcs[] = {{1, 0},  {1, k},  {k, 1},	 {0, 1},  {-k, 1}, {-1, k}, {-1, 0},
+							  {-1, -k}, {-k, -1}, {0, -1}, {k, -1}, {1, -k}, {1, 0}};
+	const lmi::CubicCurve<2> circle(lmi::CurveBasis::Bezier, arcs, 13);
+	ASSERT_EQ(circle.segments(), 4u);
+
+	std::vector<float> u;
+	for(int i = 0; i <= 400; ++i)
+		u.push_back(float(i) / 100);
+	std::vector<lmi::vec2> positions(u.size()), derivatives(u.size());
+	circle.evaluate(u.data(), u.size(), positions.data(), derivatives.data(), 3);
+	for(size_t i = 0; i < u.size(); ++i)
+	{
+		// de Casteljau on the segment's control points.
+		const size_t s = std::min(size_t(u[i]), size_t(3));
+		const float t = u[i] - float(s);
+		lmi::vec2 p[4] = {arcs[3 * s], arcs[3 * s + 1], arcs[3 * s + 2], arcs[3 * s + 3]};
+		for(size_t level = 3; level > 0; --level)
+			for(size_t j = 0; j < level; ++j)
+				p[j] = p[j] + (p[j + 1] - p[j]) * t;
+		EXPECT_NEAR(positions[i][0], p[0][0], 1e-5f);
+		EXPECT_NEAR(positions[i][1], p[0][1], 1e-5f);
+		EXPECT_NEAR(lmi::length(positions[i]), 1.0f, 3e-4f);
+		EXPECT_NEAR(derivatives[i][0], circle.derivative(u[i])[0], 1e-5f);
+
+		const float h = 2e-3f, v = std::min(std::max(u[i], h), 4 - h);
+		const lmi::vec2 central = (circle.evaluate(v + h) - circle.evaluate(v - h)) / (2 * h);
+		EXPECT_NEAR(circle.derivative(v)[1], central[1], 2e-3f);
+	}
+
+	std::vector<lmi::vec2> tessellated(4 * 32 + 1), tangents(4 * 32 + 1);
+	circle.tessellate(32, tessellated.data(), tangents.data(), 2);
+	for(size_t i = 0; i < tessellated.size(); ++i)
+	{
+		const float t = float(i) / 32;
+		EXPECT_NEAR(tessellated[i][0], circle.evaluate(t)[0], 1e-5f);
+		EXPECT_NEAR(tessellated[i][1], circle.evaluate(t)[1], 1e-5f);
+		EXPECT_NEAR(tangents[i][0], circle.derivative(t)[0], 1e-4f);
+	}
+
+	const lmi::ArcLengthTable<2> table(circle, 8);
+	EXPECT_NEAR(table.length(), 2 * 3.14159265f, 1e-3f);
+	EXPECT_NEAR(table.parameter(3.14159265f), 2.0f, 1e-3f);
+	std::vector<lmi::vec2> even(33);
+	table.sampleEvenly(even.size(), even.data(), nullptr, 2);
+	for(size_t i = 1; i < even.size(); ++i)
+		EXPECT_NEAR(lmi::length(even[i] - even[i - 1]), lmi::length(even[1] - even[0]), 1e-4f);
+
+	// Catmull-Rom interpolates its inner control points, the B-spline of collinear evenly spaced points is a line.
+	const lmi::vec3 points[] = {{0, 0, 0}, {1, 2, 0}, {3, 1, 1}, {4, 4, 2}, {6, 3, 0}, {7, 0, 1}};
+	const lmi::CubicCurve<3> spline(lmi::CurveBasis::CatmullRom, points, 6);
+	ASSERT_EQ(spline.segments(), 3u);
+	for(size_t i = 0; i <= 3; ++i)
+		for(size_t d = 0; d < 3; ++d)
+			EXPECT_NEAR(spline.evaluate(float(i))[d], points[i + 1][d], 1e-5f);
+	const lmi::vec3 line[] = {{0, 0, 0}, {1, 1, 1}, {2, 2, 2}, {3, 3, 3}, {4, 4, 4}};
+	const lmi::CubicCurve<3> bspline(lmi::CurveBasis::BSpline, line, 5);
+	EXPECT_NEAR(bspline.evaluate(0.5f)[1], 1.5f, 1e-5f);
+
+	// Fewer than four points make no segment, and the empty curve evaluates to zero.
+	const lmi::CubicCurve<3> empty(lmi::CurveBasis::Bezier, points, 3);
+	ASSERT_EQ(empty.segments(), 0u);
+	EXPECT_EQ(lmi::length(empty.evaluate(0.5f)) + lmi::length(empty.derivative(0.5f)), 0.0f);
+	EXPECT_EQ(lmi::length(empty.secondDerivative(0.5f)), 0.0f);
+	lmi::vec3 emptyPositions[2] = {points[1], points[2]}, emptyDerivatives[2] = {points[1], points[2]};
+	const lmi::ArcLengthTable<3> emptyTable(empty);
+	EXPECT_EQ(emptyTable.length(), 0.0f);
+	emptyTable.sampleEvenly(2, emptyPositions, emptyDerivatives);
+	for(size_t i = 0; i < 2; ++i)
+		EXPECT_EQ(lmi::length(emptyPositions[i]) + lmi::length(emptyDerivatives[i]), 0.0f);
+
+	// Double curves keep their 32 byte aligned coefficients in aligned storage; tables only bind to lvalue curves.
+	static_assert(!std::is_constructible<lmi::ArcLengthTable<3>, lmi::CubicCurve<3>>::value, "no temporaries");
+	lmi::Vector<3, double> pointsD[16];
+	for(size_t i = 0; i < 16; ++i)
+		pointsD[i] = lmi::Vector<3, double>(points[i % 6][0], points[i % 6][1], points[i % 6][2] + double(i / 6));
+	std::vector<lmi::CubicCurve<3, double>> prefixes;
+	for(size_t n = 4; n <= 16; ++n)
+	{
+		prefixes.emplace_back(lmi::CurveBasis::CatmullRom, pointsD, n);
+		EXPECT_EQ(uintptr_t(prefixes.back().segment(0)) % alignof(lmi::Vector<3, double>), 0u);
+		EXPECT_NEAR(prefixes.back().evaluate(1.0)[2], points[2][2], 1e-12);
+	}
+	const lmi::CubicCurve<3, double> splineD(lmi::CurveBasis::CatmullRom, pointsD, 6);
+	const lmi::ArcLengthTable<3, double> tableD(splineD, 8, 2);
+	EXPECT_NEAR(tableD.length(), lmi::ArcLengthTable<3>(spline, 8).length(), 1e-4);
+	for(size_t i = 0; i <= 3; ++i)
+		EXPECT_NEAR(splineD.evaluate(double(i))[2], points[i + 1][2], 1e-12);
+	EXPECT_NEAR(bspline.secondDerivative(1.25f)[2], 0.0f, 1e-5f);
+}
+
+TEST(Curve, patchTessellationMatchesEvaluation)
+{
+	// 2 x 1 Bezier patches over a 7 x 4 grid with a bump in the middle.
+	std::vector<lmi::vec3> grid;
+	for(int y = 0; y < 4; ++y)
+		for(int x = 0; x < 7; ++x)
+			grid.push_back(lmi::vec3(float(x), float(y), float((x % 3) * (y % 3))));
+	const lmi::CubicPatch<3> patch(lmi::CurveBasis::Bezier, grid.data(), 7, 4);
+	ASSERT_EQ(patch.patchesU(), 2u);
+	ASSERT_EQ(patch.patchesV(), 1u);
+	EXPECT_NEAR(patch.evaluate(1, 0)[0], 3.0f, 1e-5f);
+	EXPECT_NEAR(patch.evaluate(0.5f, 0.5f)[1], 1.5f, 1e-5f);
+
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> gridD(grid.size());
+	for(size_t i = 0; i < grid.size(); ++i)
+		gridD[i] = lmi::Vector<3, double>(grid[i][0], grid[i][1], grid[i][2]);
+	const lmi::CubicPatch<3, double> patchD(lmi::CurveBasis::Bezier, gridD.data(), 7, 4);
+	EXPECT_NEAR(patchD.evaluate(0.5, 0.5)[2], double(patch.evaluate(0.5f, 0.5f)[2]), 1e-5);
+
+	const size_t width = 2 * 10 + 1, height = 1 * 6 + 1;
+	std::vector<lmi::vec3> positions(width * height), du(width * height), dv(width * height);
+	patch.tessellate(10, 6, positions.data(), du.data(), dv.data(), 3);
+	for(size_t y = 0; y < height; ++y)
+		for(size_t x = 0; x < width; ++x)
+		{
+			lmi::vec3 pu, pv;
+			const lmi::vec3 p = patch.evaluate(float(x) / 10, float(y) / 6, &pu, &pv);
+			for(size_t d = 0; d < 3; ++d)
+			{
+				EXPECT_NEAR(positions[y * width + x][d], p[d], 1e-4f);
+				EXPECT_NEAR(du[y * width + x][d], pu[d], 1e-3f);
+				EXPECT_NEAR(dv[y * width + x][d], pv[d], 1e-3f);
+			}
+			EXPECT_NEAR(pu[0], 3.0f, 1e-4f);
+			EXPECT_NEAR(pv[1], 3.0f, 1e-4f);
+		}
+}
+
+TEST(Integration, rulesConvergeWithErrorEstimates)
+{
+	// Compile time Gauss-Legendre tables.
+	constexpr auto rule = lmi::gaussLegendreRule<double, 5>;
+	static_assert(rule.nodes[2] == 0.0, "odd rules have a node at 0");
+	static_assert(rule.nodes[4] > 0.906179 && rule.nodes[4] < 0.906180, "5 point node");
+	double weights = 0;
+	for(double w : lmi::gaussLegendreRule<double, 20>.weights)
+		weights += w;
+	EXPECT_NEAR(weights, 2.0, 1e-14);
+
+	const double pi = 3.14159265358979323846;
+	auto f = [](double x) { return std::exp(-x * x) * std::cos(3 * x); };
+	const double exact = 0.0934255318001207;	// int_0^3 exp(-x^2) cos(3x) dx
+	EXPECT_NEAR(lmi::compositeTrapezoidIntegrate(0.0, 3.0, 2000, f), exact, 1e-6);
+	EXPECT_NEAR(lmi::compositeSimpsonIntegrate(0.0, 3.0, 199, f, 3), exact, 1e-8);
+	EXPECT_NEAR(lmi::gaussLegendreIntegrate<8>(0.0, 3.0, f, 8), exact, 1e-12);
+	EXPECT_NEAR(lmi::gaussLegendreIntegrate<3>(-1.0, 2.0, [](double x) { return x * x * x * x * x; }), 10.5, 1e-12);
+
+	const auto simpson = lmi::adaptiveSimpsonIntegrate(0.0, 3.0, f, 1e-10);
+	EXPECT_NEAR(simpson.value, exact, 1e-9);
+	EXPECT_LT(simpson.error, 1e-9);
+
+	// A kink and a peak that fixed subdivisions resolve badly.
+	auto hard = [](double x) { return std::abs(x - 0.3) + 1e-2 / (1e-4 + (x - 0.7) * (x - 0.7)); };
+	const double hardExact = 0.29 + std::atan(30.0) + std::atan(70.0);
+	const auto serial = lmi::gaussKronrodIntegrate(0.0, 1.0, hard, 1e-9);
+	EXPECT_NEAR(serial.value, hardExact, 1e-8);
+	EXPECT_LE(std::abs(serial.value - hardExact), serial.error + 1e-12);
+	EXPECT_LT(serial.evaluations, 3000u);
+
+	// A batch integrand takes few calls and gives bit identical results, serially and over threads. Only the serial
+	// one counts its calls.
+	const auto hardBatch = [](const double *x, size_t count, double *y) {
+		for(size_t i = 0; i < count; ++i)
+			y[i] = std::abs(x[i] - 0.3) + 1e-2 / (1e-4 + (x[i] - 0.7) * (x[i] - 0.7));
+	};
+	size_t calls = 0;
+	auto counted = lmi::batchIntegrand([&](const double *x, size_t count, double *y) {
+		hardBatch(x, count, y);
+		++calls;
+	});
+	const auto batched = lmi::gaussKronrodIntegrate(0.0, 1.0, counted, 1e-9);
+	EXPECT_EQ(batched.value, serial.value);
+	EXPECT_LT(calls, 40u);
+	EXPECT_EQ(lmi::gaussKronrodIntegrate(0.0, 1.0, hard, 1e-9, 1024, 4).value, serial.value);
+	EXPECT_EQ(lmi::gaussLegendreIntegrate<4>(0.0, pi, lmi::batchIntegrand(hardBatch), 1000, 4),
+			  lmi::gaussLegendreIntegrate<4>(0.0, pi, hard, 1000));
+}
+
+TEST(MonteCarlo, estimatesAndVariance)
+{
+	// Philox4x32-10 known answer from the Random123 test vectors.
+	const lmi::Philox4x32::Block zero = lmi::Philox4x32(0)(0, 0, 0, 0);
+	EXPECT_EQ(zero.word[0], 0x6627e8d5u);
+	EXPECT_EQ(zero.word[1], 0xe169c58du);
+	EXPECT_EQ(zero.word[3], 0x9b00dbd8u);
+
+	const lmi::BoxDomain<3, double> box{lmi::Vector<3, double>(0, 0, 0), lmi::Vector<3, double>(1, 2, 1)};
+	auto polynomial = [](const lmi::Vector<3, double> &p) { return p[0] * p[1] * p[1] + p[2]; };
+	const double exact = 4.0 / 3.0 + 1.0;
+
+	for(lmi::SampleSequence sequence :
+		{lmi::SampleSequence::Random, lmi::SampleSequence::Sobol, lmi::SampleSequence::Halton})
+	{
+		lmi::MonteCarloOptions options;
+		options.sequence = sequence;
+		options.seed = 7;
+		const auto serial = lmi::monteCarloIntegrate<double>(box, polynomial, 1 << 14, options);
+		options.threads = 4;
+		const auto threaded = lmi::monteCarloIntegrate<double>(box, polynomial, 1 << 14, options);
+		EXPECT_EQ(serial.value, threaded.value);
+		EXPECT_EQ(serial.variance, threaded.variance);
+		EXPECT_EQ(serial.samples, size_t{1} << 14);
+		EXPECT_GT(serial.variance, 0.0);
+		EXPECT_LT(std::abs(serial.value - exact), 5 * std::sqrt(serial.variance));
+		if(sequence == lmi::SampleSequence::Random)
+		{
+			EXPECT_LT(std::sqrt(serial.variance), 2e-2);
+		}
+		else
+		{
+			EXPECT_LT(std::sqrt(serial.variance), 2e-3);
+		}
+	}
+
+	// Dimensions beyond the Sobol and Halton tables are padded with random numbers.
+	lmi::Vector<20, double> cubeMax;
+	for(size_t d = 0; d < 20; ++d)
+		cubeMax[d] = 1;
+	const lmi::BoxDomain<20, double> cube{lmi::Vector<20, double>(), cubeMax};
+	auto sum = [](const lmi::Vector<20, double> &p) {
+		double s = 0;
+		for(size_t d = 0; d < 20; ++d)
+			s += p[d];
+		return s;
+	};
+	for(lmi::SampleSequence sequence : {lmi::SampleSequence::Sobol, lmi::SampleSequence::Halton})
+	{
+		lmi::MonteCarloOptions options;
+		options.sequence = sequence;
+		const auto padded = lmi::monteCarloIntegrate<double>(cube, sum, 1 << 12, options);
+		options.threads = 3;
+		EXPECT_EQ(lmi::monteCarloIntegrate<double>(cube, sum, 1 << 12, options).value, padded.value);
+		EXPECT_GT(padded.variance, 0.0);
+		EXPECT_LT(std::abs(padded.value - 10), 5 * std::sqrt(padded.variance));
+	}
+
+	// Surface area, projected solid angle and a ball moment.
+	const auto area = lmi::monteCarloIntegrate<float>(lmi::SphereDomain<float>{lmi::vec3(1, 2, 3), 2}, [](lmi::vec3) {
+		return 1.0f;
+	}, 1000);
+	EXPECT_NEAR(area.value, 16 * 3.14159265f, 1e-3f);
+	EXPECT_LT(area.variance, 1e-6f);
+
+	const lmi::vec3 normal = lmi::normalize(lmi::vec3(1, -2, 0.5f));
+	lmi::HemisphereDomain<float> hemisphere;
+	hemisphere.normal = normal;
+	auto cosine = [&](const lmi::vec3 &w) { return std::max(lmi::dot(w, normal), 0.0f); };
+	lmi::MonteCarloOptions sobol;
+	sobol.sequence = lmi::SampleSequence::Sobol;
+	const auto uniform = lmi::monteCarloIntegrate<float>(hemisphere, cosine, 4096, sobol);
+	EXPECT_NEAR(uniform.value, 3.14159265f, 1e-2f);
+	hemisphere.cosineWeighted = true;
+	const auto importance = lmi::monteCarloIntegrate<float>(hemisphere, cosine, 4096, sobol);
+	EXPECT_NEAR(importance.value, 3.14159265f, 1e-4f);
+
+	auto batch = lmi::batchIntegrand([](const lmi::Vector<3, double> *p, size_t count, double *values) {
+		for(size_t i = 0; i < count; ++i)
+			values[i] = p[i][0] * p[i][0];
+	});
+	lmi::MonteCarloOptions halton;
+	halton.sequence = lmi::SampleSequence::Halton;
+	halton.threads = 3;
+	const auto moment = lmi::monteCarloIntegrate<double>(lmi::BallDomain<double>{{}, 2}, batch, 1 << 16, halton);
+	EXPECT_NEAR(moment.value, 4 * 3.14159265358979 / 15 * 32, 5e-2);
+}
+
+TEST(Dual, derivativesThroughVectorMatrixQuaternion)
+{
+	using D = lmi::Dual<double, 3>;
+
+	// Scalar rules against analytic derivatives.
+	const lmi::Dual<double> x = lmi::Dual<double>::variable(0.7, 0);
+	EXPECT_NEAR((lmi::sin(x) * lmi::exp(x) / (1 + x * x)).tangent[0],
+				(std::cos(0.7) * std::exp(0.7) + std::sin(0.7) * std::exp(0.7)) / 1.49 -
+					std::sin(0.7) * std::exp(0.7) * 1.4 / (1.49 * 1.49),
+				1e-14);
+	EXPECT_NEAR(lmi::pow(x, 3).tangent[0], 3 * 0.49, 1e-14);
+	EXPECT_EQ(lmi::pow(lmi::Dual<double>::variable(0.0, 0), 0.5).value, 0.0);
+	EXPECT_EQ(lmi::pow(lmi::Dual<double>::variable(0.0, 0), 0.0).value, 1.0);
+	EXPECT_NEAR(lmi::atan2(x, lmi::Dual<double>(2.0)).tangent[0], 2 / (4 + 0.49), 1e-14);
+	EXPECT_NEAR((2 / x).tangent[0], -2 / 0.49, 1e-12);
+
+	// Gradient of |p|^2 and Jacobian of normalize.
+	const lmi::vec3d p(1.0, -2.0, 0.5);
+	const lmi::vec3d gradient = lmi::dualGradient([](const lmi::Vector<3, D> &v) { return lmi::dot(v, v); }, p);
+	for(size_t k = 0; k < 3; ++k)
+		EXPECT_NEAR(gradient[k], 2 * p[k], 1e-14);
+	const lmi::Matrix<3, 3, double> dn =
+		lmi::dualJacobian([](const lmi::Vector<3, D> &v) { return lmi::normalize(v); }, p);
+	const double l = lmi::length(p);
+	for(size_t c = 0; c < 3; ++c)
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_NEAR(dn[c][r], ((r == c) - p[r] * p[c] / (l * l)) / l, 1e-14);
+
+	// abs and length of Dual vectors, |abs(p)| having the gradient p / |p|.
+	const lmi::vec3d lengthGradient =
+		lmi::dualGradient([](const lmi::Vector<3, D> &v) { return lmi::length(lmi::abs(v)); }, p);
+	for(size_t k = 0; k < 3; ++k)
+		EXPECT_NEAR(lengthGradient[k], p[k] / l, 1e-14);
+
+	// Rotation by a quaternion built from a matrix of dual numbers, against central differences.
+	auto rotateByAngles = [](const auto &angles) {
+		using T = std::decay_t<decltype(angles[0])>;
+		const lmi::Quaternion<T> qx = lmi::createRotationQuaternion(lmi::Vector<3, T>(1, 0, 0), angles[0]);
+		const lmi::Quaternion<T> qy = lmi::createRotationQuaternion(lmi::Vector<3, T>(0, 1, 0), angles[1]);
+		const lmi::Matrix<3, 3, T> m(lmi::normalize(qx * qy));
+		const lmi::Quaternion<T> q = lmi::slerp(lmi::Quaternion<T>(T{1}), lmi::Quaternion<T>(m), T(0.5));
+		lmi::Matrix<4, 4, T> translation(T{1});
+		translation[3] = lmi::Vector<4, T>(angles[2], T{0}, T{0}, T{1});
+		const lmi::Vector<3, T> r = lmi::rotate(q, lmi::Vector<3, T>(1, 2, 3));
+		const lmi::Vector<4, T> moved = translation * lmi::Vector<4, T>(r[0], r[1], r[2], T{1});
+		return lmi::Vector<3, T>(moved[0], moved[1], moved[2]);
+	};
+	const lmi::vec3d angles(0.3, -0.4, 2.0);
+	const lmi::Matrix<3, 3, double> jacobian = lmi::dualJacobian(rotateByAngles, angles);
+	for(size_t c = 0; c < 3; ++c)
+	{
+		lmi::vec3d plus = angles, minus = angles;
+		plus[c] += 1e-6;
+		minus[c] -= 1e-6;
+		const lmi::vec3d central = (rotateByAngles(plus) - rotateByAngles(minus)) / 2e-6;
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_NEAR(jacobian[c][r], central[r], 1e-7);
+	}
+}
+
+TEST(Differentiation, jacobianAndHessianMatchDual)
+{
+	// A small sensor model: range, bearing and elevation of a target seen from a moving position.
+	auto model = [](const auto &p) {
+		using std::asin;
+		using std::atan2;
+		using T = std::decay_t<decltype(p[0])>;
+		const lmi::Vector<3, T> d(T(4.0) - p[0], T(-1.0) - p[1], T(2.5) - p[2] * p[3]);
+		return lmi::Vector<3, T>(lmi::length(d), atan2(d[1], d[0]), asin(d[2] / lmi::length(d)));
+	};
+	const lmi::Vector<4, double> x(0.5, 0.2, 1.1, 0.9);
+	const lmi::Matrix<4, 3, double> exact = lmi::dualJacobian(model, x);
+	const lmi::Matrix<4, 3, double> serial = lmi::jacobian(model, x);
+	const lmi::Matrix<4, 3, double> threaded = lmi::jacobian(model, x, 4);
+	for(size_t c = 0; c < 4; ++c)
+		for(size_t r = 0; r < 3; ++r)
+		{
+			EXPECT_NEAR(serial[c][r], exact[c][r], 1e-10);
+			EXPECT_EQ(threaded[c][r], serial[c][r]);
+		}
+
+	// Rosenbrock in 3D, whose Hessian is known in closed form.
+	auto rosenbrock = [](const lmi::Vector<3, double> &v) {
+		return 100 * std::pow(v[1] - v[0] * v[0], 2) + std::pow(1 - v[0], 2) + 100 * std::pow(v[2] - v[1] * v[1], 2) +
+			   std::pow(1 - v[1], 2);
+	};
+	const lmi::Vector<3, double> y(-1.2, 1.0, 0.8);
+	const lmi::Matrix<3, 3, double> h = lmi::hessian(rosenbrock, y, 3);
+	const double expected[3][3] = {{1200 * 1.44 - 400 * 1.0 + 2, -400 * -1.2, 0},
+								   {-400 * -1.2, 202 + 1200 * 1.0 - 400 * 0.8, -400 * 1.0},
+								   {0, -400 * 1.0, 200}};
+	for(size_t c = 0; c < 3; ++c)
+		for(size_t r = 0; r < 3; ++r)
+			EXPECT_NEAR(h[c][r], expected[c][r], 1e-5 * (1 + std::abs(expected[c][r])));
+	EXPECT_EQ(lmi::hessian(rosenbrock, y)[0][1], h[1][0]);
+}
+
+TEST(LeastSquares, fitsCurvesAndBatches)
+{
+	const lmi::Matrix<3, 3, double> spd(4.0, 1.0, 0.5, 1.0, 3.0, 0.2, 0.5, 0.2, 2.0);
+	const lmi::Vector<3, double> b(1.0, -2.0, 0.5);
+	lmi::Matrix<3, 3, double> l;
+	ASSERT_TRUE(lmi::algorithm::choleskyDecompose(spd, l));
+	lmi::Vector<3, double> pivoted;
+	ASSERT_TRUE(lmi::algorithm::solveLinear(spd, b, pivoted));
+	const lmi::Vector<3, double> cholesky = lmi::algorithm::choleskySolve(l, b), product = spd * cholesky;
+	for(size_t i = 0; i < 3; ++i)
+	{
+		EXPECT_NEAR(product[i], b[i], 1e-12);
+		EXPECT_NEAR(pivoted[i], cholesky[i], 1e-12);
+	}
+	const lmi::Matrix<3, 3, double> indefinite(1.0, 2.0, 0.0, 2.0, 1.0, 0.0, 0.0, 0.0, 1.0);
+	EXPECT_FALSE(lmi::algorithm::choleskyDecompose(indefinite, l));
+	EXPECT_FALSE(lmi::algorithm::solveLinear(lmi::Matrix<3, 3, double>(), b, pivoted));
+
+	// y = a * exp(-k t) + c sampled without noise, so both methods must recover the parameters.
+	const lmi::Vector<3, double> truth(2.5, 1.3, 0.4);
+	auto decay = [](const lmi::Vector<3, double> &p, double t) { return p[0] * std::exp(-p[1] * t) + p[2]; };
+	auto residual = [&](const lmi::Vector<3, double> &p) {
+		lmi::Vector<8, double> r;
+		for(size_t i = 0; i < 8; ++i)
+			r[i] = decay(p, i * 0.5) - decay(truth, i * 0.5);
+		return r;
+	};
+	auto jacobian = [](const lmi::Vector<3, double> &p) {
+		lmi::Matrix<3, 8, double> j;
+		for(size_t i = 0; i < 8; ++i)
+		{
+			const double t = i * 0.5, e = std::exp(-p[1] * t);
+			j[0][i] = e;
+			j[1][i] = -p[0] * t * e;
+			j[2][i] = 1;
+		}
+		return j;
+	};
+	for(auto method : {lmi::LeastSquaresMethod::GaussNewton, lmi::LeastSquaresMethod::LevenbergMarquardt})
+	{
+		lmi::LeastSquaresOptions<double> options;
+		options.method = method;
+		lmi::Vector<3, double> numeric(1.0, 0.5, 0.0), analytic = numeric;
+		const auto summary = lmi::solveLeastSquares(residual, numeric, options);
+		lmi::solveLeastSquares(residual, jacobian, analytic, options);
+		EXPECT_NE(summary.status, lmi::LeastSquaresStatus::Failed);
+		EXPECT_LT(summary.finalCost, summary.initialCost * 1e-16);
+		for(size_t i = 0; i < 3; ++i)
+		{
+			EXPECT_NEAR(numeric[i], truth[i], 1e-6);
+			EXPECT_NEAR(analytic[i], truth[i], 1e-8);
+		}
+	}
+
+	// Many independent circle fits, each to points on its own circle.
+	constexpr size_t count = 500;
+	auto point = [](size_t i, size_t k) {
+		const lmi::Vector<3, double> c(std::sin(i * 0.1), std::cos(i * 0.07), 1 + (i % 7) * 0.25);
+		const double angle = k * 0.9 + i * 0.01;
+		return lmi::Vector<2, double>(c[0] + c[2] * std::cos(angle), c[1] + c[2] * std::sin(angle));
+	};
+	auto circle = [&](size_t i, const lmi::Vector<3, double> &p) {
+		lmi::Vector<6, double> r;
+		for(size_t k = 0; k < 6; ++k)
+			r[k] = lmi::length(point(i, k) - lmi::Vector<2, double>(p[0], p[1])) - p[2];
+		return r;
+	};
+	auto circleJacobian = [&](size_t i, const lmi::Vector<3, double> &p) {
+		lmi::Matrix<3, 6, double> j;
+		for(size_t k = 0; k < 6; ++k)
+		{
+			const lmi::Vector<2, double> d = point(i, k) - lmi::Vector<2, double>(p[0], p[1]);
+			j[0][k] = -d[0] / lmi::length(d);
+			j[1][k] = -d[1] / lmi::length(d);
+			j[2][k] = -1;
+		}
+		return j;
+	};
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> serial(count, lmi::Vector<3, double>(0.3, -0.2, 1.0));
+	lmi::detail::AlignedVector<lmi::Vector<3, double>> threaded = serial, analytic = serial;
+	std::vector<lmi::LeastSquaresSummary<double>> summaries(count), analyticSummaries(count);
+	const lmi::LeastSquaresOptions<double> options;
+	lmi::solveLeastSquaresBatch(circle, serial.data(), count, summaries.data());
+	lmi::solveLeastSquaresBatch(circle, threaded.data(), count, summaries.data(), options, 4);
+	lmi::solveLeastSquaresBatch(circle, circleJacobian, analytic.data(), count, analyticSummaries.data(), options, 4);
+	for(size_t i = 0; i < count; ++i)
+	{
+		EXPECT_EQ(serial[i], threaded[i]);
+		EXPECT_LT(summaries[i].finalCost, 1e-20);
+		EXPECT_LT(analyticSummaries[i].finalCost, 1e-20);
+		EXPECT_NEAR(serial[i][2], 1 + (i % 7) * 0.25, 1e-8);
+		EXPECT_NEAR(analytic[i][2], 1 + (i % 7) * 0.25, 1e-8);
+	}
+}
+
+TEST(Particles, integratorsFollowOscillatorsAndSpin)
+{
+	// Independent harmonic oscillators x'' = -k x with x(0) = x0, v(0) = 0, so x(t) = x0 cos(sqrt(k) t).
+	constexpr size_t count = 1000;
+	auto spring = [](double, const lmi::Vector<3, double> *x, const lmi::Vector<3, double> *, lmi::Vector<3, double> *a,
+					 size_t first, size_t n) {
+		for(size_t i = 0; i < n; ++i)
+			a[i] = x[i] * -(1.0 + (first + i) % 4);
+	};
+	auto start = [](size_t i) { return lmi::Vector<3, double>(1.0, 0.5 * i / count, -0.25); };
+	const double dt = 0.01, duration = 2.0;
+	const double tolerance[] = {2e-2, 1e-4, 1e-8};
+	const lmi::ParticleMethod methods[] = {lmi::ParticleMethod::SemiImplicitEuler,
+										   lmi::ParticleMethod::VelocityVerlet, lmi::ParticleMethod::RungeKutta4};
+	for(size_t m = 0; m < 3; ++m)
+	{
+		lmi::detail::AlignedVector<lmi::Vector<3, double>> x(count), v(count), xThreaded(count), vThreaded(count);
+		for(size_t i = 0; i < count; ++i)
+			x[i] = xThreaded[i] = start(i);
+		lmi::ParticleState<double> serial, threaded;
+		serial.positions = x.data(), serial.velocities = v.data(), serial.count = count;
+		threaded.positions = xThreaded.data(), threaded.velocities = vThreaded.data(), threaded.count = count;
+
+		// The threaded run keeps Verlet's accelerations between steps, which must not change the result.
+		lmi::detail::AlignedVector<lmi::Vector<3, double>> cached(count);
+		threaded.accelerations = cached.data();
+		spring(0.0, xThreaded.data(), vThreaded.data(), cached.data(), 0, count);
+
+		lmi::FixedTimestep<double> clock(dt, 1000);
+		const size_t steps = clock.advance(duration + dt / 2, [&](double time, double step) {
+			lmi::integrateParticles(serial, methods[m], time, step, spring);
+			lmi::integrateParticles(threaded, methods[m], time, step, spring, 4);
+		});
+		EXPECT_EQ(steps, 200u);
+		EXPECT_NEAR(clock.alpha(), 0.5, 1e-9);
+		EXPECT_NEAR(clock.time(), duration, 1e-12);
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			const double w = std::sqrt(1.0 + i % 4);
+			const lmi::Vector<3, double> exact = start(i) * std::cos(w * duration);
+			EXPECT_LT(lmi::length(x[i] - exact), tolerance[m]);
+			for(size_t c = 0; c < 3; ++c)
+				EXPECT_NEAR(xThreaded[i][c], x[i][c], 1e-12);
+		}
+	}
+
+	// Spinning about a fixed axis accumulates the angle |w| t.
+	std::vector<lmi::Quaternion<float>> orientations(16, lmi::Quaternion<float>(1.0f));
+	std::vector<lmi::Vector<3, float>> positions(16), velocities(16, lmi::Vector<3, float>(1.0f, 0.0f, 0.0f));
+	std::vector<lmi::Vector<3, float>> spins(16, lmi::Vector<3, float>(0.0f, 0.0f, 2.0f));
+	lmi::ParticleState<float> bodies;
+	bodies.positions = positions.data(), bodies.velocities = velocities.data(), bodies.count = 16;
+	bodies.orientations = orientations.data(), bodies.angularVelocities = spins.data();
+	auto still = [](float, const lmi::Vector<3, float> *, const lmi::Vector<3, float> *, lmi::Vector<3, float> *a,
+					size_t, size_t n) { std::fill(a, a + n, lmi::Vector<3, float>()); };
+	lmi::FixedTimestep<float> clock(1.0f / 100, 4);
+	for(int frame = 0; frame < 50; ++frame)
+		clock.advance(1.0f / 50, [&](float time, float step) {
+			lmi::integrateParticles(bodies, lmi::ParticleMethod::SemiImplicitEuler, time, step, still);
+		});
+	EXPECT_EQ(clock.advance(1.0f, [](float, float) {}), 4u);
+	EXPECT_NEAR(positions[3][0], 1.0f, 1e-4f);
+	EXPECT_NEAR(2 * std::atan2(orientations[3][3], orientations[3][0]), 2.0f, 1e-4f);
+	EXPECT_NEAR(orientations[3][0] * orientations[3][0] + orientations[3][3] * orientations[3][3], 1.0f, 1e-6f);
+}